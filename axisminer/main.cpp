@@ -34,6 +34,9 @@
 #if _CPU
 #include <libethash-cpu/CPUMiner.h>
 #endif
+#if _SIM
+#include <libethash-sim/SimMiner.h>
+#endif
 #include <libpoolprotocols/PoolManager.h>
 
 #if _API
@@ -247,6 +250,14 @@ public:
 
         app.add_option("--noncesegmentwidth", m_FarmSettings.nonceSegmentWidth, "", true)->check(CLI::Range(10, 50));
 
+        app.add_option("--compile-threads", m_FarmSettings.compileThreads, "", true)->check(CLI::Range(1, 16));
+
+        app.add_option("--compile-ahead", m_FarmSettings.compileLookahead, "", true)->check(CLI::Range(0, 16));
+
+        app.add_option("--hr-windows", m_FarmSettings.hrWindows, "")->check(CLI::Range(1, 86400));
+
+        app.add_option("--hr-ema", m_FarmSettings.hrEmaSeconds, "", true)->check(CLI::Range(1, 3600));
+
         bool version = false;
 
         app.add_flag("-V,--version", version, "Show program version");
@@ -274,6 +285,10 @@ public:
 
         app.add_option("--failover-timeout", m_PoolSettings.poolFailoverTimeout, "", true)->check(CLI::Range(0, 999));
 
+        app.add_option("--pool-standby", m_PoolSettings.standbyConnections, "", true)->check(CLI::Range(0, 8));
+
+        app.add_option("--failover-policy", m_PoolSettings.failoverPolicy, "", true)->check(CLI::Range(1));
+
         app.add_flag("--nocolor", g_logNoColor, "");
 
         app.add_flag("--syslog", g_logSyslog, "");
@@ -338,10 +353,14 @@ public:
 
         app.add_option("--cpu-devices,--cp-devices", m_CPSettings.devices, "");
 
+        app.add_option("--cpu-group,--cp-group", m_CPSettings.grouping, "", true)->check(CLI::Range(0, 2));
+
 #endif
 
         app.add_flag("--noeval", m_FarmSettings.noEval, "");
 
+        app.add_option("--stale-policy", m_FarmSettings.stalePolicy, "", true)->check(CLI::Range(2));
+
         app.add_option("-L,--dag-load-mode", m_FarmSettings.dagLoadMode, "", true)->check(CLI::Range(1));
 
         bool cl_miner = false;
@@ -357,9 +376,21 @@ public:
 
 
         auto sim_opt = app.add_option("-Z,--simulation,-M,--benchmark", m_PoolSettings.benchmarkBlock, "", true);
-        app.add_option("--diff", m_PoolSettings.benchmarkDiff, "", true)->check(CLI::Range(0.00001, 100.0));
+        app.add_option("--diff", m_PoolSettings.benchmarkDiff, "", true)->check(CLI::Range(0.0, 100.0));
         app.add_flag("--vardiff", m_PoolSettings.benchmarkVarDiff);
 
+#if _SIM
+
+        app.add_option("--sim-devices", m_SMSettings.devices, "", true)->check(CLI::Range(1, 4096));
+
+        app.add_option("--sim-hashrate", m_SMSettings.hashrate, "", true)->check(CLI::Range(1.0, 1.0e12));
+
+        app.add_option("--sim-solrate", m_SMSettings.solutionRate, "", true)->check(CLI::Range(0.0, 1000.0));
+
+        app.add_option("--sim-invalid", m_SMSettings.invalidPercent, "", true)->check(CLI::Range(0, 100));
+
+#endif
+
         app.add_option("--min-diff", m_PoolSettings.minDiff, "", true)->check(CLI::Range(0.00001, 100.0));
 
         app.add_option("--tstop", m_FarmSettings.tempStop, "", true)->check(CLI::Range(30, 100));
@@ -389,7 +420,9 @@ public:
         // dev::toNearestPowerOf2(m_CLSettings.globalWorkSizeMultiplier);
         dev::toNearestPowerOf2(m_CLSettings.localWorkSize);
 
-        if (cl_miner)
+        if (m_SMSettings.devices)
+            m_minerType = MinerType::SIM;
+        else if (cl_miner)
             m_minerType = MinerType::CL;
         else if (cuda_miner)
             m_minerType = MinerType::CUDA;
@@ -414,6 +447,10 @@ public:
             m_mode = OperationMode::Mining;
         }
 
+        // Synthetic devices submit made up solutions : never to a pool
+        if (m_minerType == MinerType::SIM && m_mode != OperationMode::Simulation)
+            throw std::invalid_argument("Synthetic devices require simulation mode. See -Z argument.");
+
         if (!m_shouldListDevices && !m_shouldListClPlatforms && m_mode != OperationMode::Simulation)
         {
             if (!pools.size())
@@ -493,7 +530,11 @@ public:
 #endif
 #if _CPU
         if (m_minerType == MinerType::CPU)
-            CPUMiner::enumDevices(m_DevicesCollection);
+            CPUMiner::enumDevices(m_DevicesCollection, m_CPSettings.grouping);
+#endif
+#if _SIM
+        if (m_minerType == MinerType::SIM)
+            SimMiner::enumDevices(m_DevicesCollection, m_SMSettings.devices);
 #endif
 
         // Can't proceed without any GPU
@@ -697,6 +738,15 @@ public:
                 it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cpu;
             }
         }
+#endif
+#if _SIM
+        if (m_minerType == MinerType::SIM)
+        {
+            for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
+            {
+                it->second.subscriptionType = DeviceSubscriptionTypeEnum::Sim;
+            }
+        }
 #endif
         // Count of subscribed devices
         int subscribedDevices = 0;
@@ -721,7 +771,7 @@ public:
         signal(SIGTERM, MinerCLI::signalHandler);
 
         // Initialize Farm
-        new Farm(m_DevicesCollection, m_FarmSettings, m_CUSettings, m_CLSettings, m_CPSettings);
+        new Farm(m_DevicesCollection, m_FarmSettings, m_CUSettings, m_CLSettings, m_CPSettings, m_SMSettings);
 
         // Run Miner
         doMiner();
@@ -815,16 +865,38 @@ public:
                  << "                        Mining test. Used to test hashing speed." << endl
                  << "                        Specify the block number to test on." << endl
                  << endl
-                 << "    --diff              DOUBLE [0.00001 .. 100] Default 1.0" << endl
+                 << "    --diff              DOUBLE [0 .. 100] Default 1.0" << endl
                  << "                        Difficulty index to apply on tests." << endl
                  << "                        The default value of 1.0 corresponds to" << endl
                  << "                        a hashing difficulty of 4.29 Mh/s" << endl
+                 << "                        With 0 any hash is a solution" << endl
                  << endl
                  << "    --vardiff           FLAG" << endl
                  << "                        Set this flag if you whish the simulation" << endl
                  << "                        to increase block numbers (thus changing DAG)" << endl
                  << "                        and randomize difficulty." << endl
                  << endl;
+#if _SIM
+            cout << "    Synthetic devices (scale tests) :" << endl
+                 << endl
+                 << "    They do not hash but report a hashrate and find solutions" << endl
+                 << "    at a given rate so farm, API and submit paths can be measured" << endl
+                 << "    with many devices. Only with -Z. Use --diff 0 to have valid" << endl
+                 << "    solutions accepted. See 'latency', 'api' and 'submit' in the" << endl
+                 << "    output of API method miner_getstatdetail" << endl
+                 << endl
+                 << "    --sim-devices       UINT [1 .. 4096] Default not set" << endl
+                 << "                        Number of synthetic devices to mine with" << endl
+                 << "                        instead of detected ones" << endl
+                 << "    --sim-hashrate      DOUBLE Default = " << m_SMSettings.hashrate << endl
+                 << "                        Hashrate reported by each device (h/s)" << endl
+                 << "    --sim-solrate       DOUBLE [0 .. 1000] Default = " << m_SMSettings.solutionRate << endl
+                 << "                        Solutions found by each device per second" << endl
+                 << "    --sim-invalid       UINT [0 .. 100] Default = " << m_SMSettings.invalidPercent << endl
+                 << "                        Percentage of solutions carrying a wrong mix" << endl
+                 << "                        hash (failed locally or rejected with --noeval)" << endl
+                 << endl;
+#endif
         }
 
         // Help text for API interfaces options
@@ -911,6 +983,13 @@ public:
                  << "                        Space separated list of device indexes to use" << endl
                  << "                        eg --cp-devices 0 2 3" << endl
                  << "                        If not set all available CPUs will be used" << endl
+                 << "    --cp-group          UINT {0,1,2} Default = 0" << endl
+                 << "                        How logical processors are grouped into devices" << endl
+                 << "                        0 one device per logical processor" << endl
+                 << "                        1 one device per NUMA node" << endl
+                 << "                        2 one device per L3 cache domain" << endl
+                 << "                        A grouped device drives one hashing thread per" << endl
+                 << "                        processor sharing the same job and nonce counter" << endl
                  << endl;
         }
 #endif
@@ -940,6 +1019,7 @@ public:
                  << endl
                  << "                        Value expressed in milliseconds" << endl
                  << "                        It has no meaning in stratum mode" << endl
+                 << "                        Not used with nodes offering long polling" << endl
                  << endl
                  << "    --farm-retries      INT[1 .. 99999] Default = 3" << endl
                  << "                        Set number of reconnection retries to same pool" << endl
@@ -948,6 +1028,23 @@ public:
                  << "                        connected to a fail-over pool before trying to" << endl
                  << "                        reconnect to the primary (the first) connection." << endl
                  << "                        before switching to a fail-over connection" << endl
+                 << "    --pool-standby      INT[0 .. 8] Default = 0" << endl
+                 << "                        Number of fail-over connections kept connected," << endl
+                 << "                        authorized and receiving jobs while mining on" << endl
+                 << "                        the active one. On disconnection mining switches" << endl
+                 << "                        to the first of them holding a job without" << endl
+                 << "                        pausing, and the lost connection is retried in" << endl
+                 << "                        the background. Standby connections are kept to" << endl
+                 << "                        the first connections in -P order" << endl
+                 << "    --failover-policy   INT[0 .. 1] Default = 0" << endl
+                 << "                        Which connection to switch to when the active" << endl
+                 << "                        one fails (or which standby connection)" << endl
+                 << "                        0 The next one in -P order" << endl
+                 << "                        1 The one with the lowest median submit round" << endl
+                 << "                          trip plus 100 ms per percent of stale and" << endl
+                 << "                          rejected shares. Connections never used come" << endl
+                 << "                          last in -P order. '-P exit' only bounds the" << endl
+                 << "                          connections taken into account" << endl
                  << "    --work-timeout      INT[180 .. 99999] Default = 180" << endl
                  << "                        If no new work received from pool after this" << endl
                  << "                        amount of time the connection is dropped" << endl
@@ -971,6 +1068,22 @@ public:
                  << "                        This is only useful if you benchmark!" << endl
                  << "    --noncesegmentwidth INT [10 .. 50] Default = 32" << endl
                  << endl
+                 << "    --compile-threads   INT [1 .. 16] Default = 2" << endl
+                 << "                        Number of background threads compiling ProgPoW" << endl
+                 << "                        period kernels (shared among all devices)" << endl
+                 << "    --compile-ahead     INT [0 .. 16] Default = 2" << endl
+                 << "                        Number of ProgPoW periods compiled ahead of the" << endl
+                 << "                        current one so period switches never wait for" << endl
+                 << "                        a compilation" << endl
+                 << endl
+                 << "    --hr-windows        UINT {} Default = 10 60 900" << endl
+                 << "                        Space separated list of windows (seconds) over" << endl
+                 << "                        which hashrate averages are reported by the API" << endl
+                 << "    --hr-ema            INT [1 .. 3600] Default = 30" << endl
+                 << "                        Time constant (seconds) of the smoothed hashrate" << endl
+                 << "                        shown on console, reported to the pool and to the" << endl
+                 << "                        API" << endl
+                 << endl
                  << "    --nocolor           FLAG Monochrome display log lines" << endl
                  << "    --syslog            FLAG Use syslog appropriate output (drop timestamp and" << endl
                  << "                        channel prefix)" << endl
@@ -978,6 +1091,12 @@ public:
                  << "    --noeval            FLAG By-pass host software re-evaluation of GPUs" << endl
                  << "                        found nonces. Trims some ms. from submission" << endl
                  << "                        time but it may increase rejected solution rate." << endl
+                 << "    --stale-policy      INT[0 .. 2] Default = 0" << endl
+                 << "                        How to handle solutions found on jobs the pool" << endl
+                 << "                        has superseded with clean jobs (or new block)" << endl
+                 << "                        0 Verify and submit them anyway" << endl
+                 << "                        1 Drop them (accounted as stale dropped)" << endl
+                 << "                        2 Submit them without verification" << endl
                  << "    --list-devices      FLAG Lists the detected OpenCL/CUDA devices and exits" << endl
                  << "                        Must be combined with -G or -U or -X flags" << endl
                  << "    -L,--dag-load-mode  INT[0 .. 1] Default = 0" << endl
@@ -1182,6 +1301,7 @@ private:
     CLSettings m_CLSettings = CLSettings();        // Operating settings for CL Miners
     CUSettings m_CUSettings = CUSettings();        // Operating settings for CUDA Miners
     CPSettings m_CPSettings = CPSettings();        // Operating settings for CPU Miners
+    SMSettings m_SMSettings = SMSettings();        // Operating settings for synthetic Miners
 
     //// -- Pool manager related params
 
@@ -3,6 +3,7 @@
 #include <axisminer/buildinfo.h>
 
 #include <libethcore/Farm.h>
+#include <libethcore/KernelCompiler.h>
 
 #ifndef HOST_NAME_MAX
 #define HOST_NAME_MAX 255
@@ -211,6 +212,65 @@ static bool parseRequestId(Json::Value& jRequest, Json::Value& jResponse)
     return false;
 }
 
+// Renders a series of hashrates as hex strings
+static Json::Value hashratesToJson(std::vector<float> const& _hashrates)
+{
+    Json::Value jRes = Json::Value(Json::arrayValue);
+    for (float hr : _hashrates)
+        jRes.append(toHex((uint32_t)hr, HexPrefix::Add));
+    return jRes;
+}
+
+// Renders the hashrate proven by shares
+static Json::Value effectiveToJson(EffectiveHashRateType const& _e)
+{
+    Json::Value jRes;
+    Json::Value difficulties = Json::Value(Json::arrayValue);
+    difficulties.append(_e.accepted);
+    difficulties.append(_e.rejected);
+    difficulties.append(_e.stale);
+    jRes["difficulties"] = difficulties;
+
+    Json::Value interval = Json::Value(Json::arrayValue);
+    interval.append(toHex((uint64_t)_e.low, HexPrefix::Add));
+    interval.append(toHex((uint64_t)_e.high, HexPrefix::Add));
+    jRes["hashrate"] = toHex((uint64_t)_e.hashrate, HexPrefix::Add);
+    jRes["interval"] = interval;
+    jRes["reported"] = toHex((uint64_t)_e.reported, HexPrefix::Add);
+    jRes["deviation"] = _e.deviation;
+    return jRes;
+}
+
+// Renders a latency histogram. Values are in microseconds
+static Json::Value histogramToJson(HistogramSnapshot const& _h)
+{
+    Json::Value jRes;
+    jRes["count"] = Json::UInt64(_h.count);
+    jRes["min"] = Json::UInt64(_h.min);
+    jRes["mean"] = Json::UInt64(_h.mean());
+    jRes["max"] = Json::UInt64(_h.max);
+
+    Json::Value percentiles = Json::Value(Json::arrayValue);
+    percentiles.append(Json::UInt64(_h.percentile(50)));
+    percentiles.append(Json::UInt64(_h.percentile(90)));
+    percentiles.append(Json::UInt64(_h.percentile(99)));
+    jRes["percentiles"] = percentiles;
+
+    Json::Value buckets = Json::Value(Json::arrayValue);
+    for (auto const& b : _h.buckets)
+    {
+        Json::Value bucket = Json::Value(Json::arrayValue);
+        bucket.append(Json::UInt64(b.first));
+        bucket.append(Json::UInt64(b.second));
+        buckets.append(bucket);
+    }
+    jRes["buckets"] = buckets;
+    return jRes;
+}
+
+LatencyHistogram ApiConnection::s_requestTimes;
+LatencyHistogram ApiConnection::s_responseSizes;
+
 ApiServer::ApiServer(string address, int portnum, string password)
   : m_password(std::move(password)), m_address(address), m_acceptor(g_io_service), m_io_strand(g_io_service)
 {
@@ -445,8 +505,20 @@ void ApiConnection::processRequest(Json::Value& jRequest, Json::Value& jResponse
         // to prevent locking
         if (!checkApiWriteAccess(m_readonly, jResponse))
             return;
+
+        // Hot restart unless told otherwise
+        bool hot = true;
+        if (jRequest.isMember("params"))
+        {
+            Json::Value jRequestParams;
+            if (!getRequestValue("params", jRequestParams, jRequest, false, jResponse))
+                return;
+            if (!getRequestValue("hot", hot, jRequestParams, true, jResponse))
+                return;
+        }
+
         jResponse["result"] = true;
-        Farm::f().restart_async();
+        Farm::f().restart_async(hot);
     }
 
     else if (_method == "miner_reboot")
@@ -679,6 +751,139 @@ void ApiConnection::processRequest(Json::Value& jRequest, Json::Value& jResponse
         }
     }
 
+    else if (_method == "miner_adddevice")
+    {
+        if (!checkApiWriteAccess(m_readonly, jResponse))
+            return;
+
+        Json::Value jRequestParams;
+        if (!getRequestValue("params", jRequestParams, jRequest, false, jResponse))
+            return;
+
+        std::string id;
+        if (!getRequestValue("id", id, jRequestParams, false, jResponse))
+            return;
+
+        std::string type;
+        if (!getRequestValue("type", type, jRequestParams, true, jResponse))
+            return;
+
+        DeviceSubscriptionTypeEnum subscription = DeviceSubscriptionTypeEnum::None;
+        if (type == "cu")
+            subscription = DeviceSubscriptionTypeEnum::Cuda;
+        else if (type == "cl")
+            subscription = DeviceSubscriptionTypeEnum::OpenCL;
+        else if (type == "cp")
+            subscription = DeviceSubscriptionTypeEnum::Cpu;
+        else if (type == "sm")
+            subscription = DeviceSubscriptionTypeEnum::Sim;
+        else if (!type.empty())
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = "Invalid type";
+            return;
+        }
+
+        try
+        {
+            jResponse["result"] = Farm::f().addMiner(id, subscription);
+        }
+        catch (const std::exception& _ex)
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = std::string(_ex.what());
+        }
+    }
+
+    else if (_method == "miner_removedevice")
+    {
+        if (!checkApiWriteAccess(m_readonly, jResponse))
+            return;
+
+        Json::Value jRequestParams;
+        if (!getRequestValue("params", jRequestParams, jRequest, false, jResponse))
+            return;
+
+        unsigned index;
+        if (!getRequestValue("index", index, jRequestParams, false, jResponse))
+            return;
+
+        try
+        {
+            Farm::f().removeMiner(index);
+            jResponse["result"] = true;
+        }
+        catch (const std::exception& _ex)
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = std::string(_ex.what());
+        }
+    }
+
+    else if (_method == "miner_setclsettings")
+    {
+        if (!checkApiWriteAccess(m_readonly, jResponse))
+            return;
+
+        Json::Value jRequestParams;
+        if (!getRequestValue("params", jRequestParams, jRequest, false, jResponse))
+            return;
+
+        // Omitted values are left unchanged
+        CLSettings settings = Farm::f().getCLSettings();
+        if (!getRequestValue("global_work", settings.globalWorkSizeMultiplier, jRequestParams, true, jResponse) ||
+            !getRequestValue("local_work", settings.localWorkSize, jRequestParams, true, jResponse))
+            return;
+
+        if (settings.globalWorkSizeMultiplier < 32 || settings.globalWorkSizeMultiplier > 65536)
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = "Invalid global_work [32 .. 65536]";
+            return;
+        }
+        if (settings.localWorkSize != 64 && settings.localWorkSize != 128 && settings.localWorkSize != 256)
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = "Invalid local_work {64,128,256}";
+            return;
+        }
+
+        Farm::f().setCLSettings(settings);
+        jResponse["result"] = true;
+    }
+
+    else if (_method == "miner_setcpsettings")
+    {
+        if (!checkApiWriteAccess(m_readonly, jResponse))
+            return;
+
+        Json::Value jRequestParams;
+        if (!getRequestValue("params", jRequestParams, jRequest, false, jResponse))
+            return;
+
+        // Omitted values are left unchanged
+        CPSettings settings = Farm::f().getCPSettings();
+        if (!getRequestValue("batch", settings.batchSize, jRequestParams, true, jResponse) ||
+            !getRequestValue("group", settings.grouping, jRequestParams, true, jResponse))
+            return;
+
+        if (!settings.batchSize)
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = "Invalid batch";
+            return;
+        }
+        if (settings.grouping > 2)
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = "Invalid group [0 .. 2]";
+            return;
+        }
+
+        Farm::f().setCPSettings(settings);
+        jResponse["result"] = true;
+    }
+
     else if (_method == "miner_setverbosity")
     {
         if (!checkApiWriteAccess(m_readonly, jResponse))
@@ -844,6 +1049,8 @@ void ApiConnection::onRecvSocketDataCompleted(const boost::system::error_code& e
 
                     if (!line.empty())
                     {
+                        auto requestStart = steady_clock::now();
+
                         // Test validity of chunk and process
                         Json::Value jMsg;
                         Json::Value jRes;
@@ -877,7 +1084,11 @@ void ApiConnection::onRecvSocketDataCompleted(const boost::system::error_code& e
                         }
 
                         // Send response to client
-                        sendSocketData(jRes);
+                        std::string response = Json::writeString(m_jSwBuilder, jRes);
+                        s_requestTimes.record(
+                            uint64_t(duration_cast<microseconds>(steady_clock::now() - requestStart).count()));
+                        s_responseSizes.record(response.size());
+                        sendSocketData(response + "\n");
                     }
                 }
 
@@ -897,15 +1108,6 @@ void ApiConnection::onRecvSocketDataCompleted(const boost::system::error_code& e
     }
 }
 
-void ApiConnection::sendSocketData(Json::Value const& jReq, bool _disconnect)
-{
-    if (!m_socket.is_open())
-        return;
-    std::stringstream line;
-    line << Json::writeString(m_jSwBuilder, jReq) << std::endl;
-    sendSocketData(line.str(), _disconnect);
-}
-
 void ApiConnection::sendSocketData(std::string const& _s, bool _disconnect)
 {
     if (!m_socket.is_open())
@@ -946,19 +1148,25 @@ Json::Value ApiConnection::getMinerStat1()
     poolAddresses << connection->Host() << ':' << connection->Port();
     invalidStats << ";0;0";  // DualMining not supported
 
+    // Skip indexes of removed miners
+    std::vector<TelemetryAccountType const*> gpus;
+    for (auto const& miner : t.miners)
+        if (!miner.prefix.empty())
+            gpus.push_back(&miner);
+
     int gpuIndex;
-    int numGpus = t.miners.size();
+    int numGpus = gpus.size();
 
     for (gpuIndex = 0; gpuIndex < numGpus; gpuIndex++)
     {
-        detailedMhEth << std::fixed << std::setprecision(0) << t.miners.at(gpuIndex).hashrate / 1000.0f
+        detailedMhEth << std::fixed << std::setprecision(0) << gpus.at(gpuIndex)->hashrate / 1000.0f
                       << (((numGpus - 1) > gpuIndex) ? ";" : "");
         detailedMhDcr << "off" << (((numGpus - 1) > gpuIndex) ? ";" : "");  // DualMining not supported
     }
 
     for (gpuIndex = 0; gpuIndex < numGpus; gpuIndex++)
     {
-        tempAndFans << t.miners.at(gpuIndex).sensors.tempC << ";" << t.miners.at(gpuIndex).sensors.fanP
+        tempAndFans << gpus.at(gpuIndex)->sensors.tempC << ";" << gpus.at(gpuIndex)->sensors.fanP
                     << (((numGpus - 1) > gpuIndex) ? ";" : "");  // Fetching Temp and Fans
     }
 
@@ -1028,18 +1236,34 @@ Json::Value ApiConnection::getMinerStatDetailPerMiner(const TelemetryType& _t, s
                                                              // share
 
     mininginfo["shares"] = jshares;
+    mininginfo["stale_dropped"] = _t.miners.at(_index).solutions.staleDropped;
+    mininginfo["duplicates"] = _t.miners.at(_index).solutions.duplicates;
     mininginfo["paused"] = _miner->paused();
     mininginfo["pause_reason"] = _miner->paused() ? _miner->pausedString() : Json::Value::null;
 
     /* Nonce infos */
-    auto segment_width = Farm::f().get_segment_width();
-    uint64_t gpustartnonce = Farm::f().get_nonce_scrambler() + ((uint64_t)_index << segment_width);
-    jsegment.append(toHex(uint64_t(gpustartnonce), HexPrefix::Add));
-    jsegment.append(toHex(uint64_t(gpustartnonce + (1LL << segment_width)), HexPrefix::Add));
+    NonceSegment segment = Farm::f().get_nonce_segment(_index);
+    jsegment.append(toHex(segment.start, HexPrefix::Add));
+    jsegment.append(toHex(uint64_t(segment.start + segment.length), HexPrefix::Add));
     mininginfo["segment"] = jsegment;
 
     /* Hash & Share infos */
     mininginfo["hashrate"] = toHex((uint32_t)_t.miners.at(_index).hashrate, HexPrefix::Add);
+    mininginfo["hashrate_raw"] = toHex((uint32_t)_t.miners.at(_index).hashrateRaw, HexPrefix::Add);
+    mininginfo["hashrate_windows"] = hashratesToJson(_t.miners.at(_index).hashrateWindows);
+    mininginfo["effective"] = effectiveToJson(_t.miners.at(_index).effective);
+    mininginfo["switchtime"] = _t.miners.at(_index).switchTime;
+    mininginfo["restarttime"] = Json::UInt64(_t.miners.at(_index).restartTime);
+    mininginfo["kernels_ahead"] = _miner->kernelsAhead();
+
+    /* Per thread hashrate of grouped devices */
+    if (!_t.miners.at(_index).threadHashrates.empty())
+    {
+        Json::Value jthreads = Json::Value(Json::arrayValue);
+        for (float hr : _t.miners.at(_index).threadHashrates)
+            jthreads.append(toHex((uint32_t)hr, HexPrefix::Add));
+        mininginfo["threads"] = jthreads;
+    }
 
     jRes["hardware"] = hwinfo;
     jRes["mining"] = mininginfo;
@@ -1193,6 +1417,9 @@ Json::Value ApiConnection::getMinerStatDetail()
     Json::Value sharesinfo = Json::Value(Json::arrayValue);
 
     mininginfo["hashrate"] = toHex(uint32_t(t.farm.hashrate), HexPrefix::Add);
+    mininginfo["hashrate_raw"] = toHex(uint32_t(t.farm.hashrateRaw), HexPrefix::Add);
+    mininginfo["hashrate_windows"] = hashratesToJson(t.farm.hashrateWindows);
+    mininginfo["effective"] = effectiveToJson(t.farm.effective);
     mininginfo["epoch"] = PoolManager::p().getCurrentEpoch();
     mininginfo["epoch_changes"] = PoolManager::p().getEpochChanges();
     mininginfo["difficulty"] = PoolManager::p().getCurrentDifficulty();
@@ -1205,6 +1432,8 @@ Json::Value ApiConnection::getMinerStatDetail()
     sharesinfo.append(uint64_t(solution_lastupdated.count()));  // interval in seconds from last
                                                                 // found share
     mininginfo["shares"] = sharesinfo;
+    mininginfo["stale_dropped"] = t.farm.solutions.staleDropped;
+    mininginfo["duplicates"] = t.farm.solutions.duplicates;
 
     /* Monitors Info */
     Json::Value monitorinfo;
@@ -1217,16 +1446,70 @@ Json::Value ApiConnection::getMinerStatDetail()
         monitorinfo["temperatures"] = tempsinfo;
     }
 
+    /* ProgPoW kernel compiler info */
+    Json::Value compilerinfo;
+    KernelCompilerStats cs = KernelCompiler::get().stats();
+    Json::Value compiletimes = Json::Value(Json::arrayValue);
+    compiletimes.append(cs.lastMs);
+    compiletimes.append(cs.avgMs);
+    compiletimes.append(cs.maxMs);
+    compilerinfo["compiled"] = cs.compiled;
+    compilerinfo["failed"] = cs.failed;
+    compilerinfo["merged"] = cs.merged;
+    compilerinfo["pending"] = cs.pending;
+    compilerinfo["lookahead"] = cs.lookahead;
+    compilerinfo["times"] = compiletimes;
+
+    /* Solutions queue info */
+    Json::Value submitinfo;
+    SolutionQueueStats qs = Farm::f().getSolutionQueueStats();
+    Json::Value submitlatency = Json::Value(Json::arrayValue);
+    submitlatency.append(qs.lastLatencyUs);
+    submitlatency.append(qs.avgLatencyUs);
+    submitlatency.append(qs.maxLatencyUs);
+    submitinfo["queued"] = qs.queued;
+    submitinfo["dropped"] = qs.dropped;
+    submitinfo["depth"] = qs.depth;
+    submitinfo["max_depth"] = qs.maxDepth;
+    submitinfo["latency"] = submitlatency;
+    submitinfo["submitted"] = Json::UInt64(qs.submitted);
+    submitinfo["rate"] = t.submitRate;
+
+    /* Latency histograms */
+    Json::Value latencyinfo;
+    latencyinfo["response"] = histogramToJson(t.responseTimes);
+    latencyinfo["verify"] = histogramToJson(t.verifyTimes);
+    latencyinfo["submit"] = histogramToJson(t.submitTimes);
+    latencyinfo["switch"] = histogramToJson(t.switchTimes);
+    latencyinfo["dispatch"] = histogramToJson(t.dispatchTimes);
+    latencyinfo["collect"] = histogramToJson(t.collectTimes);
+
+    /* Api info */
+    Json::Value apiinfo;
+    apiinfo["latency"] = histogramToJson(s_requestTimes.snapshot());
+    apiinfo["size"] = histogramToJson(s_responseSizes.snapshot());
+
+    /* Restarts */
+    Json::Value restartinfo;
+    restartinfo["count"] = Json::UInt64(t.restarts);
+    restartinfo["hot"] = Json::UInt64(t.hotRestarts);
+    restartinfo["time"] = Json::UInt64(t.farm.restartTime);
+
     /* Devices related info */
     for (shared_ptr<Miner> miner : Farm::f().getMiners())
         devices.append(getMinerStatDetailPerMiner(t, miner));
 
     jRes["devices"] = devices;
 
+    jRes["api"] = apiinfo;
     jRes["monitors"] = monitorinfo;
+    jRes["compiler"] = compilerinfo;
     jRes["connection"] = connectioninfo;
     jRes["host"] = hostinfo;
+    jRes["latency"] = latencyinfo;
     jRes["mining"] = mininginfo;
+    jRes["restart"] = restartinfo;
+    jRes["submit"] = submitinfo;
 
     return jRes;
 }
@@ -36,12 +36,15 @@ public:
 
     tcp::socket& socket() { return m_socket; }
 
+    // Shared by all connections
+    static LatencyHistogram s_requestTimes;   // From receipt of a request to its response ready (us)
+    static LatencyHistogram s_responseSizes;  // Of each response (bytes)
+
 private:
     void disconnect();
     void processRequest(Json::Value& jRequest, Json::Value& jResponse);
     void recvSocketData();
     void onRecvSocketDataCompleted(const boost::system::error_code& ec, std::size_t bytes_transferred);
-    void sendSocketData(Json::Value const& jReq, bool _disconnect = false);
     void sendSocketData(std::string const& _s, bool _disconnect = false);
     void onSendSocketDataCompleted(const boost::system::error_code& ec, bool _disconnect = false);
 
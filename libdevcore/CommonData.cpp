@@ -17,12 +17,115 @@
 
 #include <cstdlib>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DEV_HEX_SSE2 1
+#endif
+
 #include "CommonData.h"
 #include "Exceptions.h"
+#include "Target.h"
 
 using namespace std;
 using namespace dev;
 
+namespace
+{
+// Digit pairs of every byte value
+struct HexPairs
+{
+    HexPairs()
+    {
+        static const char digits[] = "0123456789abcdef";
+        for (unsigned i = 0; i < 256; i++)
+        {
+            pairs[i * 2] = digits[i >> 4];
+            pairs[i * 2 + 1] = digits[i & 0xf];
+        }
+    }
+    char pairs[512];
+};
+
+const HexPairs c_hexPairs;
+
+#if DEV_HEX_SSE2
+// 16 nibbles (one per byte) to their ascii digits
+inline __m128i nibblesToHex(__m128i _n)
+{
+    __m128i letters = _mm_cmpgt_epi8(_n, _mm_set1_epi8(9));
+    __m128i digits = _mm_add_epi8(_n, _mm_set1_epi8('0'));
+    return _mm_add_epi8(digits, _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+// 16 ascii digits to their nibbles. Sets _valid to false on bad digits
+inline __m128i hexToNibbles(__m128i _c, bool& _valid)
+{
+    __m128i d = _mm_sub_epi8(_c, _mm_set1_epi8('0'));
+    __m128i l = _mm_sub_epi8(_mm_or_si128(_c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)), _mm_cmplt_epi8(d, _mm_set1_epi8(10)));
+    __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8(-1)), _mm_cmplt_epi8(l, _mm_set1_epi8(6)));
+    if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff)
+        _valid = false;
+    return _mm_or_si128(
+        _mm_and_si128(isDigit, d), _mm_and_si128(isLetter, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+// 8 pairs of nibbles (high first) to bytes in the low 8 bytes of 16 bit lanes
+inline __m128i nibblePairs(__m128i _n)
+{
+    __m128i hi = _mm_slli_epi16(_mm_and_si128(_n, _mm_set1_epi16(0x00ff)), 4);
+    return _mm_or_si128(hi, _mm_srli_epi16(_n, 8));
+}
+#endif
+
+}  // namespace
+
+char* dev::hexEncode(byte const* _data, size_t _size, char* _out)
+{
+    size_t i = 0;
+#if DEV_HEX_SSE2
+    // 16 bytes to 32 digits a time
+    for (; i + 16 <= _size; i += 16, _out += 32)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_data + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+        __m128i lo = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(_out), nibblesToHex(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + 16), nibblesToHex(_mm_unpackhi_epi8(hi, lo)));
+    }
+#endif
+    for (; i < _size; i++, _out += 2)
+        std::memcpy(_out, &c_hexPairs.pairs[_data[i] * 2], 2);
+    return _out;
+}
+
+bool dev::hexDecode(char const* _hex, size_t _size, byte* _out)
+{
+    size_t i = 0;
+#if DEV_HEX_SSE2
+    // 32 digits to 16 bytes a time
+    bool valid = true;
+    for (; i + 16 <= _size; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_hex + i * 2));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_hex + i * 2 + 16));
+        __m128i r = _mm_packus_epi16(nibblePairs(hexToNibbles(a, valid)), nibblePairs(hexToNibbles(b, valid)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + i), r);
+    }
+    if (!valid)
+        return false;
+#endif
+    for (; i < _size; i++)
+    {
+        int h = fromHex(_hex[i * 2], WhenError::DontThrow);
+        int l = fromHex(_hex[i * 2 + 1], WhenError::DontThrow);
+        if (h < 0 || l < 0)
+            return false;
+        _out[i] = byte((h << 4) | l);
+    }
+    return true;
+}
+
 int dev::fromHex(char _i, WhenError _throw)
 {
     if (_i >= '0' && _i <= '9')
@@ -53,16 +156,14 @@ bytes dev::fromHex(std::string const& _s, WhenError _throw)
         else
             return bytes();
     }
-    for (unsigned i = s; i < _s.size(); i += 2)
+
+    size_t odd = ret.size();
+    ret.resize(odd + (_s.size() - s) / 2);
+    if (!hexDecode(_s.data() + s, ret.size() - odd, ret.data() + odd))
     {
-        int h = fromHex(_s[i], WhenError::DontThrow);
-        int l = fromHex(_s[i + 1], WhenError::DontThrow);
-        if (h != -1 && l != -1)
-            ret.push_back((byte)(h * 16 + l));
-        else if (_throw == WhenError::Throw)
+        if (_throw == WhenError::Throw)
             BOOST_THROW_EXCEPTION(BadHexCharacter());
-        else
-            return bytes();
+        return bytes();
     }
     return ret;
 }
@@ -79,103 +180,31 @@ bool dev::setenv(const char name[], const char value[], bool override)
 #endif
 }
 
-std::string dev::getTargetFromDiff(double diff, HexPrefix _prefix)
+namespace
 {
-    using namespace boost::multiprecision;
-    using BigInteger = boost::multiprecision::cpp_int;
-
-    static BigInteger base("0x00000000ffff0000000000000000000000000000000000000000000000000000");
-    BigInteger product;
-
-    if (diff == 0)
-    {
-        product = BigInteger("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
-    }
-    else
-    {
-        diff = 1 / diff;
-
-        BigInteger idiff(diff);
-        product = base * idiff;
-
-        std::string sdiff = boost::lexical_cast<std::string>(diff);
-        size_t ldiff = sdiff.length();
-        size_t offset = sdiff.find(".");
-
-        if (offset != std::string::npos)
-        {
-            // Number of decimal places
-            size_t precision = (ldiff - 1) - offset;
-
-            // Effective sequence of decimal places
-            string decimals = sdiff.substr(offset + 1);
-
-            // Strip leading zeroes. If a string begins with
-            // 0 or 0x boost parser considers it hex
-            decimals = decimals.erase(0, decimals.find_first_not_of('0'));
-
-            // Build up the divisor as string - just in case
-            // parser does some implicit conversion with 10^precision
-            string decimalDivisor = "1";
-            decimalDivisor.resize(precision + 1, '0');
-
-            // This is the multiplier for the decimal part
-            BigInteger multiplier(decimals);
-
-            // This is the divisor for the decimal part
-            BigInteger divisor(decimalDivisor);
-
-            BigInteger decimalproduct;
-            decimalproduct = base * multiplier;
-            decimalproduct /= divisor;
-
-            // Add the computed decimal part
-            // to product
-            product += decimalproduct;
-        }
-    }
+h256 parseTarget(std::string const& _target)
+{
+    h256 target;
+    if (!hexToHash(_target.data(), _target.size(), target))
+        BOOST_THROW_EXCEPTION(BadHexCharacter());
+    return target;
+}
 
-    // Normalize to 64 chars hex with "0x" prefix
-    stringstream ss;
-    ss << (_prefix == HexPrefix::Add ? "0x" : "") << setw(64) << setfill('0') << std::hex << product;
+}  // namespace
 
-    string target = ss.str();
-    boost::algorithm::to_lower(target);
-    return target;
+std::string dev::getTargetFromDiff(double diff, HexPrefix _prefix)
+{
+    return diffToTarget(diff).hex(_prefix);
 }
 
 double dev::getDiffFromTarget(std::string _target)
 {
-    using namespace boost::multiprecision;
-    using BigInteger = boost::multiprecision::cpp_int;
-
-    BigInteger dividend("0x00000000ffff0000000000000000000000000000000000000000000000000000");
-    BigInteger divisor(_target);
-    string quotient = boost::lexical_cast<std::string>(dividend / divisor);
-    BigInteger remainder = dividend % divisor;
-    if (!remainder.is_zero())
-    {
-        int precision = 0;
-        quotient.append(".");
-        while (precision < 6 && !remainder.is_zero())
-        {
-            precision++;
-            dividend *= 10;
-            quotient.append(boost::lexical_cast<std::string>(dividend / divisor));
-            remainder = dividend % divisor;
-        }
-    }
-    return std::stod(quotient);
+    return targetToDiff(parseTarget(_target));
 }
 
 double dev::getHashesToTarget(string _target)
 {
-    using namespace boost::multiprecision;
-    using BigInteger = boost::multiprecision::cpp_int;
-
-    static BigInteger dividend("0xffff000000000000000000000000000000000000000000000000000000000000");
-    BigInteger divisor(_target);
-    return double(dividend / divisor);
+    return targetToHashes(parseTarget(_target));
 }
 
 std::string dev::getScaledSize(
@@ -185,6 +185,14 @@ inline std::string toHex(uint32_t _n, HexPrefix _prefix = HexPrefix::DontAdd, sh
     return (_prefix == HexPrefix::Add) ? "0x" + ret.str() : ret.str();
 }
 
+/// Writes the 2 * _size lowercase hex digits of _data to _out without terminator.
+/// Doesn't allocate. Returns the end of written digits.
+char* hexEncode(byte const* _data, size_t _size, char* _out);
+
+/// Decodes 2 * _size hex digits (either case, no prefix) from _hex into _size bytes.
+/// Doesn't allocate. Returns false on any invalid digit (_out is undefined then).
+bool hexDecode(char const* _hex, size_t _size, byte* _out);
+
 inline std::string toCompactHex(uint64_t _n, HexPrefix _prefix = HexPrefix::DontAdd)
 {
     std::ostringstream ret;
@@ -225,6 +233,8 @@ inline unsigned bytesRequired(T _i)
 // Portable wrapper for setenv / _putenv C library functions.
 bool setenv(const char name[], const char value[], bool override = false);
 
+// Hex string versions of the conversions in Target.h
+
 // Gets a target hash from given difficulty
 std::string getTargetFromDiff(double diff, HexPrefix _prefix = HexPrefix::Add);
 
@@ -128,7 +128,13 @@ public:
     explicit FixedHash(byte const* _bs, ConstructFromPointerType /*unused*/) { memcpy(m_data.data(), _bs, N); }
 
     /// Explicitly construct, copying from a  string.
-    explicit FixedHash(std::string const& _s) : FixedHash(fromHex(_s, WhenError::Throw), FailIfDifferent) {}
+    explicit FixedHash(std::string const& _s)
+    {
+        // Full length hex is decoded in place
+        size_t p = (_s.size() >= 2 && _s[0] == '0' && _s[1] == 'x') ? 2 : 0;
+        if (_s.size() - p != N * 2 || !hexDecode(_s.data() + p, N, m_data.data()))
+            *this = FixedHash(fromHex(_s, WhenError::Throw), FailIfDifferent);
+    }
 
     /// Convert to arithmetic type.
     operator Arith() const { return fromBigEndian<Arith>(m_data); }
@@ -206,7 +212,13 @@ public:
     std::string abridged() const { return toHex(ref().cropped(0, 4)) + k_ellipsis; }
 
     /// @returns the hash as a user-readable hex string.
-    std::string hex(HexPrefix _prefix = HexPrefix::DontAdd) const { return toHex(ref(), 2, _prefix); }
+    std::string hex(HexPrefix _prefix = HexPrefix::DontAdd) const
+    {
+        std::string ret(_prefix == HexPrefix::Add ? "0x" : "");
+        ret.resize(ret.size() + N * 2);
+        hexEncode(m_data.data(), N, &ret[ret.size() - N * 2]);
+        return ret;
+    }
 
     /// @returns a mutable byte vector_ref to the object's data.
     bytesRef ref() { return bytesRef(m_data.data(), N); }
@@ -251,6 +263,34 @@ private:
     std::array<byte, N> m_data;  ///< The binary data.
 };
 
+/// Decodes up to 2 * N hex digits (optionally 0x prefixed) into _hash right aligned,
+/// padding with zeroes on the left. Doesn't allocate. Returns false on invalid digits.
+template <unsigned N>
+bool hexToHash(char const* _hex, size_t _size, FixedHash<N>& _hash)
+{
+    if (_size >= 2 && _hex[0] == '0' && (_hex[1] == 'x' || _hex[1] == 'X'))
+    {
+        _hex += 2;
+        _size -= 2;
+    }
+    if (!_size || _size > N * 2)
+        return false;
+
+    size_t count = (_size + 1) / 2;
+    byte* out = _hash.data();
+    std::memset(out, 0, N - count);
+    out += N - count;
+    if (_size % 2)
+    {
+        int l = fromHex(*_hex++, WhenError::DontThrow);
+        if (l < 0)
+            return false;
+        *out++ = byte(l);
+        count--;
+    }
+    return hexDecode(_hex, count, out);
+}
+
 /// Fast equality operator for h256.
 template <>
 inline bool FixedHash<32>::operator==(FixedHash<32> const& _other) const
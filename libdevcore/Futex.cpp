@@ -0,0 +1,84 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Futex.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <climits>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace dev;
+
+#if defined(__linux__)
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Futex word must be 32 bits wide");
+
+static long sys_futex(std::atomic<uint32_t>* _word, int _op, uint32_t _val, const struct timespec* _timeout)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(_word), _op, _val, _timeout, nullptr, 0);
+}
+
+void Futex::wait(uint32_t _expected)
+{
+    // The kernel re-checks the word against _expected once the waiter
+    // has been accounted for, so a concurrent notify either sees the
+    // waiter or the waiter sees the changed word
+    m_waiters.fetch_add(1);
+    sys_futex(&m_word, FUTEX_WAIT_PRIVATE, _expected, nullptr);
+    m_waiters.fetch_sub(1);
+}
+
+void Futex::notify_one()
+{
+    if (m_waiters.load())
+        sys_futex(&m_word, FUTEX_WAKE_PRIVATE, 1, nullptr);
+}
+
+void Futex::notify_all()
+{
+    if (m_waiters.load())
+        sys_futex(&m_word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+}
+
+#else
+
+void Futex::wait(uint32_t _expected)
+{
+    unique_lock<mutex> l(x_wait);
+    if (m_word.load() == _expected)
+        m_cv.wait(l);
+}
+
+void Futex::notify_one()
+{
+    // Taking the lock orders the notification after a waiter
+    // which has already checked the word
+    lock_guard<mutex> l(x_wait);
+    m_cv.notify_one();
+}
+
+void Futex::notify_all()
+{
+    lock_guard<mutex> l(x_wait);
+    m_cv.notify_all();
+}
+
+#endif
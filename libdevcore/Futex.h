@@ -0,0 +1,70 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Futex.h
+ * A 32 bit atomic word threads can sleep on.
+ *
+ * Wakers change the word and then notify, sleepers pass the value they
+ * last observed to wait() which returns at once if the word has changed
+ * meanwhile, so no wakeup can be lost. On Linux this maps onto the futex
+ * syscall and a notify with no sleeping thread costs no syscall at all.
+ * Other platforms fall back to a mutex and a condition variable.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#if !defined(__linux__)
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace dev
+{
+class Futex
+{
+public:
+    Futex(uint32_t _value = 0) : m_word(_value) {}
+
+    Futex(Futex const&) = delete;
+    Futex& operator=(Futex const&) = delete;
+
+    uint32_t load() const { return m_word.load(); }
+    void store(uint32_t _value) { m_word.store(_value); }
+    uint32_t fetch_add(uint32_t _value) { return m_word.fetch_add(_value); }
+
+    // Sleeps while the word holds _expected. Returns when notified, when the
+    // word has changed or spuriously: callers must re-check their condition.
+    void wait(uint32_t _expected);
+
+    // Wakes one or all the threads sleeping on this word
+    void notify_one();
+    void notify_all();
+
+private:
+    std::atomic<uint32_t> m_word;
+
+#if defined(__linux__)
+    std::atomic<uint32_t> m_waiters = {0};  // Number of threads (about to be) sleeping
+#else
+    std::mutex x_wait;
+    std::condition_variable m_cv;
+#endif
+};
+
+}  // namespace dev
@@ -0,0 +1,138 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Histogram.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+using namespace dev;
+
+uint64_t HistogramSnapshot::percentile(double _p) const
+{
+    if (!count)
+        return 0;
+
+    uint64_t rank = uint64_t(count * std::min(std::max(_p, 0.0), 100.0) / 100.0 + 0.5);
+    rank = std::max(rank, uint64_t(1));
+    uint64_t seen = 0;
+    for (auto const& b : buckets)
+    {
+        seen += b.second;
+        if (seen >= rank)
+            return std::min(b.first, max);
+    }
+    return max;
+}
+
+void HistogramSnapshot::merge(HistogramSnapshot const& _other)
+{
+    if (!_other.count)
+        return;
+
+    min = count ? std::min(min, _other.min) : _other.min;
+    max = std::max(max, _other.max);
+    count += _other.count;
+    sum += _other.sum;
+
+    vector<pair<uint64_t, uint64_t>> merged;
+    merged.reserve(buckets.size() + _other.buckets.size());
+    auto a = buckets.begin();
+    auto b = _other.buckets.begin();
+    while (a != buckets.end() || b != _other.buckets.end())
+    {
+        if (b == _other.buckets.end() || (a != buckets.end() && a->first < b->first))
+            merged.push_back(*a++);
+        else if (a == buckets.end() || b->first < a->first)
+            merged.push_back(*b++);
+        else
+        {
+            merged.push_back(make_pair(a->first, a->second + b->second));
+            ++a;
+            ++b;
+        }
+    }
+    buckets.swap(merged);
+}
+
+unsigned LatencyHistogram::bucketIndex(uint64_t _value)
+{
+    if (_value < (1U << c_subBits))
+        return unsigned(_value);
+
+    unsigned msb = 63;
+    while (!(_value >> msb))
+        msb--;
+    unsigned shift = msb - c_subBits;
+    unsigned sub = unsigned(_value >> shift) & ((1U << c_subBits) - 1);
+    return ((shift + 1) << c_subBits) + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(unsigned _index)
+{
+    if (_index < (1U << c_subBits))
+        return _index;
+
+    unsigned shift = (_index >> c_subBits) - 1;
+    uint64_t lower = uint64_t((1U << c_subBits) + (_index & ((1U << c_subBits) - 1))) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t _value)
+{
+    m_counts[bucketIndex(_value)].fetch_add(1, memory_order_relaxed);
+    m_sum.fetch_add(_value, memory_order_relaxed);
+
+    uint64_t v = m_min.load(memory_order_relaxed);
+    while (_value < v && !m_min.compare_exchange_weak(v, _value, memory_order_relaxed))
+    {
+    }
+    v = m_max.load(memory_order_relaxed);
+    while (_value > v && !m_max.compare_exchange_weak(v, _value, memory_order_relaxed))
+    {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot ret;
+    for (unsigned i = 0; i < c_buckets; i++)
+    {
+        uint64_t c = m_counts[i].load(memory_order_relaxed);
+        if (!c)
+            continue;
+        ret.buckets.push_back(make_pair(bucketUpperBound(i), c));
+        ret.count += c;
+    }
+    if (ret.count)
+    {
+        ret.sum = m_sum.load(memory_order_relaxed);
+        ret.min = m_min.load(memory_order_relaxed);
+        ret.max = m_max.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& c : m_counts)
+        c.store(0, memory_order_relaxed);
+    m_sum.store(0, memory_order_relaxed);
+    m_min.store(numeric_limits<uint64_t>::max(), memory_order_relaxed);
+    m_max.store(0, memory_order_relaxed);
+}
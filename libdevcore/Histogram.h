@@ -0,0 +1,81 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Histogram.h
+ * Lock-free histogram of latencies.
+ *
+ * Buckets are log-linear as in HDR histograms: values below 8 get a bucket
+ * each, above that every power of 2 is split in 8 linear sub-buckets so the
+ * relative error never exceeds 12.5% over the whole 64 bit range. Recording
+ * is a couple of relaxed atomic increments and can be done from any thread.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dev
+{
+// Point in time copy of a histogram
+struct HistogramSnapshot
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> buckets;  // Upper bound and count of non empty buckets
+
+    uint64_t mean() const { return count ? sum / count : 0; }
+
+    // Upper bound of the bucket holding the _p (0 .. 100) percentile
+    uint64_t percentile(double _p) const;
+
+    // Adds the samples of another snapshot
+    void merge(HistogramSnapshot const& _other);
+};
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { reset(); }
+
+    LatencyHistogram(LatencyHistogram const&) = delete;
+    LatencyHistogram& operator=(LatencyHistogram const&) = delete;
+
+    void record(uint64_t _value);
+
+    HistogramSnapshot snapshot() const;
+
+    // Not atomic with respect to concurrent record()
+    void reset();
+
+    static unsigned bucketIndex(uint64_t _value);
+    static uint64_t bucketUpperBound(unsigned _index);
+
+private:
+    static const unsigned c_subBits = 3;
+    static const unsigned c_buckets = (64 - c_subBits + 1) << c_subBits;
+
+    std::atomic<uint64_t> m_counts[c_buckets];
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+};
+
+}  // namespace dev
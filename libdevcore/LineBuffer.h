@@ -0,0 +1,110 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file LineBuffer.h
+ * Fixed size receive buffer splitting newline delimited messages in place.
+ *
+ * Data is read straight into the free tail of the buffer and complete
+ * lines are handed out as references into it. Each byte is scanned for
+ * the delimiter once and only the trailing incomplete line, if any, is
+ * moved back to the front when the complete ones have been consumed, so
+ * a burst of messages costs linear time. Not threadsafe.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <memory>
+
+#include "vector_ref.h"
+
+namespace dev
+{
+class LineBuffer
+{
+public:
+    explicit LineBuffer(size_t _capacity) : m_buffer(new char[_capacity]), m_capacity(_capacity) {}
+
+    LineBuffer(LineBuffer const&) = delete;
+    LineBuffer& operator=(LineBuffer const&) = delete;
+
+    // Where to read next bytes into and how many fit
+    char* tail() { return m_buffer.get() + m_end; }
+    size_t space() const { return m_capacity - m_end; }
+
+    // Accounts _size bytes read into tail()
+    void commit(size_t _size) { m_end += _size; }
+
+    // Gets the next complete line stripped of the delimiter and of
+    // surrounding white space. Blank lines are skipped. The reference
+    // is valid till next call to compact() or clear()
+    bool nextLine(vector_ref<char const>& _line)
+    {
+        while (m_scan < m_end)
+        {
+            char const* base = m_buffer.get();
+            char const* nl = static_cast<char const*>(std::memchr(base + m_scan, '\n', m_end - m_scan));
+            if (!nl)
+            {
+                m_scan = m_end;
+                return false;
+            }
+
+            char const* first = base + m_begin;
+            char const* last = nl;
+            m_begin = m_scan = size_t(nl - base) + 1;
+
+            while (first < last && isBlank(*first))
+                first++;
+            while (last > first && isBlank(*(last - 1)))
+                last--;
+            if (first < last)
+            {
+                _line = vector_ref<char const>(first, size_t(last - first));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves the incomplete line, if any, to the front making room
+    // for next read
+    void compact()
+    {
+        if (!m_begin)
+            return;
+        std::memmove(m_buffer.get(), m_buffer.get() + m_begin, m_end - m_begin);
+        m_end -= m_begin;
+        m_scan -= m_begin;
+        m_begin = 0;
+    }
+
+    void clear() { m_begin = m_scan = m_end = 0; }
+
+    // Bytes of the incomplete line
+    size_t pending() const { return m_end - m_begin; }
+
+private:
+    static bool isBlank(char _c) { return _c == ' ' || _c == '\r' || _c == '\t'; }
+
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_capacity;
+    size_t m_begin = 0;  // Start of the first line not consumed yet
+    size_t m_scan = 0;   // Bytes before this were searched for a delimiter
+    size_t m_end = 0;    // End of received data
+};
+
+}  // namespace dev
@@ -0,0 +1,124 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file MpscRing.h
+ * A bounded lock-free queue for many producers and a single consumer.
+ *
+ * Each cell carries a sequence number telling whether it is free for the
+ * producer claiming that position or filled for the consumer, so producers
+ * only contend on the head index and never wait for each other. When the
+ * ring is full push() fails rather than blocking.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dev
+{
+template <class T>
+class MpscRing
+{
+public:
+    // Capacity is rounded up to the next power of 2
+    explicit MpscRing(size_t _capacity)
+    {
+        size_t size = 2;
+        while (size < _capacity)
+            size <<= 1;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(MpscRing const&) = delete;
+    MpscRing& operator=(MpscRing const&) = delete;
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Number of queued items. Only a hint while producers are active
+    size_t size() const
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        return head >= tail ? head - tail : 0;
+    }
+
+    // Any thread. Returns false if the ring is full
+    bool push(T const& _item)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = _item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only. Returns false if the ring is empty
+    bool pop(T& _item)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell& cell = m_cells[pos & m_mask];
+        if (intptr_t(cell.seq.load(std::memory_order_acquire)) - intptr_t(pos + 1) < 0)
+            return false;
+        _item = cell.data;
+        cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+        m_tail.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    // Keep producers' and consumer's indexes on different cache lines
+    char m_pad0[64];
+    std::atomic<size_t> m_head = {0};
+    char m_pad1[64];
+    std::atomic<size_t> m_tail = {0};
+    char m_pad2[64];
+
+    size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+};
+
+}  // namespace dev
@@ -0,0 +1,109 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file NonceSet.h
+ * A compact set of 64 bit nonces.
+ *
+ * Open addressing with linear probing over a power of 2 table which
+ * doubles when half full. Zero marks free slots so the nonce 0 is kept
+ * aside. Not threadsafe.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace dev
+{
+class NonceSet
+{
+public:
+    explicit NonceSet(size_t _capacity = 64) : m_slots(roundUp(_capacity), 0) {}
+
+    size_t size() const { return m_count + (m_hasZero ? 1 : 0); }
+
+    // Removes all nonces keeping the allocated table
+    void clear()
+    {
+        if (m_count)
+            std::fill(m_slots.begin(), m_slots.end(), 0);
+        m_count = 0;
+        m_hasZero = false;
+    }
+
+    // Returns false if _nonce was already in the set
+    bool insert(uint64_t _nonce)
+    {
+        if (!_nonce)
+        {
+            bool inserted = !m_hasZero;
+            m_hasZero = true;
+            return inserted;
+        }
+
+        if ((m_count + 1) * 2 > m_slots.size())
+            grow();
+
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = hash(_nonce) & mask;; i = (i + 1) & mask)
+        {
+            if (m_slots[i] == _nonce)
+                return false;
+            if (!m_slots[i])
+            {
+                m_slots[i] = _nonce;
+                m_count++;
+                return true;
+            }
+        }
+    }
+
+private:
+    static size_t roundUp(size_t _capacity)
+    {
+        size_t size = 8;
+        while (size < _capacity)
+            size <<= 1;
+        return size;
+    }
+
+    // Fibonacci hashing spreads the contiguous nonces of a segment
+    static size_t hash(uint64_t _nonce) { return size_t((_nonce * 0x9E3779B97F4A7C15ULL) >> 32); }
+
+    void grow()
+    {
+        std::vector<uint64_t> old(m_slots.size() * 2, 0);
+        old.swap(m_slots);
+        size_t mask = m_slots.size() - 1;
+        for (uint64_t n : old)
+        {
+            if (!n)
+                continue;
+            size_t i = hash(n) & mask;
+            while (m_slots[i])
+                i = (i + 1) & mask;
+            m_slots[i] = n;
+        }
+    }
+
+    std::vector<uint64_t> m_slots;
+    size_t m_count = 0;  // Nonces in m_slots
+    bool m_hasZero = false;
+};
+
+}  // namespace dev
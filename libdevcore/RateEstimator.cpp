@@ -0,0 +1,89 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RateEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+using namespace dev;
+
+RateEstimator::RateEstimator(vector<unsigned> _windows, unsigned _emaSeconds)
+  : m_windows(std::move(_windows)), m_emaSeconds(std::max(_emaSeconds, 1U))
+{
+}
+
+void RateEstimator::sample(uint64_t _total, steady_clock::time_point _when)
+{
+    if (!m_samples.empty())
+    {
+        auto const& last = m_samples.back();
+        double elapsed = duration_cast<microseconds>(_when - last.first).count() / 1.0e6;
+        if (elapsed <= 0.0)
+            return;
+
+        // A counter going backwards has been reset : restart from here
+        if (_total < last.second)
+        {
+            m_samples.clear();
+            m_samples.emplace_back(_when, _total);
+            return;
+        }
+
+        m_raw = (_total - last.second) / elapsed;
+        if (!m_emaValid)
+        {
+            // Start from the first measure instead of ramping up from 0
+            m_ema = m_raw;
+            m_emaValid = true;
+        }
+        else
+        {
+            m_ema += (1.0 - exp(-elapsed / m_emaSeconds)) * (m_raw - m_ema);
+        }
+    }
+    m_samples.emplace_back(_when, _total);
+
+    // Keep one sample older than the longest window
+    unsigned longest = m_windows.empty() ? 0 : *std::max_element(m_windows.begin(), m_windows.end());
+    while (m_samples.size() > 2 && m_samples[1].first <= _when - seconds(longest))
+        m_samples.pop_front();
+}
+
+vector<double> RateEstimator::windows() const
+{
+    vector<double> ret(m_windows.size(), 0.0);
+    if (m_samples.size() < 2)
+        return ret;
+
+    auto const& last = m_samples.back();
+    for (size_t i = 0; i < m_windows.size(); i++)
+    {
+        // Newest sample at least a window old, or the oldest one
+        auto from = last.first - seconds(m_windows[i]);
+        size_t j = m_samples.size() - 2;
+        while (j > 0 && m_samples[j].first > from)
+            j--;
+
+        double span = duration_cast<microseconds>(last.first - m_samples[j].first).count() / 1.0e6;
+        if (span > 0.0)
+            ret[i] = (last.second - m_samples[j].second) / span;
+    }
+    return ret;
+}
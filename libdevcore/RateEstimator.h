@@ -0,0 +1,65 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file RateEstimator.h
+ * Rate of a monotonic counter over sliding windows plus an exponential
+ * moving average.
+ *
+ * The counter is sampled at (roughly) regular intervals. Rates come from
+ * differences of samples so a source which stops updating for a while
+ * (eg. during a job switch) is averaged in rather than reported as 0.
+ * Not threadsafe.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace dev
+{
+class RateEstimator
+{
+public:
+    // _windows are in seconds. _emaSeconds is the time constant of the EMA
+    RateEstimator(std::vector<unsigned> _windows, unsigned _emaSeconds);
+
+    // Feeds the current value of the counter
+    void sample(uint64_t _total, std::chrono::steady_clock::time_point _when = std::chrono::steady_clock::now());
+
+    // Rate between the last two samples
+    double raw() const { return m_raw; }
+
+    // Exponentially smoothed rate
+    double ema() const { return m_ema; }
+
+    // Average rate over each window. Windows longer than the available
+    // history report the average since the first sample
+    std::vector<double> windows() const;
+
+private:
+    std::vector<unsigned> m_windows;
+    double m_emaSeconds;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>> m_samples;
+    double m_raw = 0.0;
+    double m_ema = 0.0;
+    bool m_emaValid = false;
+};
+
+}  // namespace dev
@@ -0,0 +1,218 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+
+#include "Target.h"
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+// 256 bit unsigned integer. w[0] is the least significant word
+struct U256
+{
+    uint64_t w[4];
+};
+
+const U256 c_diff1 = {{0, 0, 0, 0x00000000ffff0000ULL}};   // Target of difficulty 1
+const U256 c_hashes1 = {{0, 0, 0, 0xffff000000000000ULL}};  // Hashes to find a nonce at target 1
+
+U256 fromHash(h256 const& _h)
+{
+    U256 r;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        uint64_t v = 0;
+        for (unsigned j = 0; j < 8; j++)
+            v = (v << 8) | _h[i * 8 + j];
+        r.w[3 - i] = v;
+    }
+    return r;
+}
+
+h256 toHash(U256 const& _u)
+{
+    h256 h;
+    for (unsigned i = 0; i < 4; i++)
+        for (unsigned j = 0; j < 8; j++)
+            h[i * 8 + j] = byte(_u.w[3 - i] >> (56 - j * 8));
+    return h;
+}
+
+unsigned bitLength(U256 const& _u)
+{
+    for (unsigned i = 4; i > 0; i--)
+    {
+        uint64_t v = _u.w[i - 1];
+        if (!v)
+            continue;
+        unsigned n = 0;
+        while (v)
+        {
+            v >>= 1;
+            n++;
+        }
+        return (i - 1) * 64 + n;
+    }
+    return 0;
+}
+
+bool less(U256 const& _a, U256 const& _b)
+{
+    for (unsigned i = 4; i > 0; i--)
+        if (_a.w[i - 1] != _b.w[i - 1])
+            return _a.w[i - 1] < _b.w[i - 1];
+    return false;
+}
+
+// _a -= _b modulo 2^256
+void sub(U256& _a, U256 const& _b)
+{
+    uint64_t borrow = 0;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        uint64_t b = _b.w[i] + borrow;
+        borrow = (b < borrow || _a.w[i] < b) ? 1 : 0;
+        _a.w[i] -= b;
+    }
+}
+
+// Shifts left by one. Returns the bit shifted out
+bool shl1(U256& _u)
+{
+    bool carry = (_u.w[3] >> 63) != 0;
+    for (unsigned i = 3; i > 0; i--)
+        _u.w[i] = (_u.w[i] << 1) | (_u.w[i - 1] >> 63);
+    _u.w[0] <<= 1;
+    return carry;
+}
+
+// Shifts left by _n < 256 bits
+void shl(U256& _u, unsigned _n)
+{
+    unsigned words = _n / 64, bits = _n % 64;
+    for (unsigned i = 4; i > 0; i--)
+    {
+        unsigned d = i - 1;
+        uint64_t v = d >= words ? _u.w[d - words] << bits : 0;
+        if (bits && d > words)
+            v |= _u.w[d - words - 1] >> (64 - bits);
+        _u.w[d] = v;
+    }
+}
+
+bool isZero(U256 const& _u)
+{
+    return !(_u.w[0] | _u.w[1] | _u.w[2] | _u.w[3]);
+}
+
+// _n / _d correctly rounded to nearest (ties to even). Both non zero
+double divide(U256 _n, U256 _d)
+{
+    // Align the most significant bits so the quotient is in (1/2, 2)
+    int s = int(bitLength(_n)) - int(bitLength(_d));
+    if (s >= 0)
+        shl(_d, unsigned(s));
+    else
+        shl(_n, unsigned(-s));
+
+    // 64 quotient bits. The leading one is the first or the second
+    uint64_t q = 0;
+    bool carry = false;
+    for (unsigned i = 0; i < 64; i++)
+    {
+        q <<= 1;
+        if (carry || !less(_n, _d))
+        {
+            sub(_n, _d);
+            q |= 1;
+        }
+        carry = shl1(_n);
+    }
+    bool sticky = carry || !isZero(_n);
+
+    int drop = (q >> 63) ? 11 : 10;
+    uint64_t mantissa = q >> drop;
+    uint64_t rest = q & ((uint64_t(1) << drop) - 1);
+    uint64_t half = uint64_t(1) << (drop - 1);
+    if (rest > half || (rest == half && (sticky || (mantissa & 1))))
+        mantissa++;
+
+    return ldexp(double(mantissa), drop + s - 63);
+}
+
+}  // namespace
+
+h256 dev::diffToTarget(double _diff)
+{
+    static const U256 highest = {{~0ULL, ~0ULL, ~0ULL, ~0ULL}};
+
+    if (!(_diff > 0.0) || std::isinf(_diff))
+        return toHash(_diff > 0.0 ? U256{{0, 0, 0, 0}} : highest);
+
+    // _diff is exactly m * 2^e
+    int e;
+    double f = frexp(_diff, &e);
+    uint64_t m = uint64_t(ldexp(f, 53));
+    e -= 53;
+    while (!(m & 1))
+    {
+        m >>= 1;
+        e++;
+    }
+
+    // Target is floor(0xffff * 2^k / m)
+    int k = 208 - e;
+    if (k < 0)
+    {
+        uint64_t q = 0xffffULL / m;
+        return toHash(U256{{-k < 64 ? q >> -k : 0, 0, 0, 0}});
+    }
+
+    // m < 2^53 : beyond this the quotient can't fit
+    if (16 + k > 256 + 54)
+        return toHash(highest);
+
+    // Bitwise long division of the numerator by m
+    U256 q = {{0, 0, 0, 0}};
+    uint64_t r = 0;
+    for (int i = 0; i < 16 + k; i++)
+    {
+        r = (r << 1) | (i < 16 ? (0xffffULL >> (15 - i)) & 1 : 0);
+        bool bit = r >= m;
+        if (bit)
+            r -= m;
+        if (shl1(q))
+            return toHash(highest);
+        q.w[0] |= bit ? 1 : 0;
+    }
+    return toHash(q);
+}
+
+double dev::targetToDiff(h256 const& _target)
+{
+    U256 t = fromHash(_target);
+    return isZero(t) ? 0.0 : divide(c_diff1, t);
+}
+
+double dev::targetToHashes(h256 const& _target)
+{
+    U256 t = fromHash(_target);
+    return isZero(t) ? 0.0 : divide(c_hashes1, t);
+}
@@ -0,0 +1,41 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Target.h
+ * Conversions between share difficulties and 256 bit targets.
+ *
+ * Difficulty 1 is the target 0x00000000ffff0000...0000. Arithmetic is
+ * done on fixed width integers without allocations: targets are the
+ * exact floor of the quotient, difficulties and hashes are the quotient
+ * correctly rounded to the nearest double.
+ */
+
+#pragma once
+
+#include "FixedHash.h"
+
+namespace dev
+{
+// Gets the target of a difficulty. 0 (or less) is the highest target
+h256 diffToTarget(double _diff);
+
+// Gets the difficulty of a target. 0 for the zero target
+double targetToDiff(h256 const& _target);
+
+// Gets the expected number of hashes to find a nonce within target
+double targetToHashes(h256 const& _target);
+
+}  // namespace dev
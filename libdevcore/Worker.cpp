@@ -34,6 +34,11 @@ void Worker::startWorking()
     if (m_state.load(memory_order_relaxed) != WorkerState::Stopped)
         return;
 
+    // Thread of a previous run has returned but must be joined
+    // before being replaced
+    if (m_work && m_work->joinable())
+        m_work->join();
+
     m_state.store(WorkerState::Starting, memory_order_relaxed);
 
     m_work.reset(new thread([&]() {
@@ -56,6 +61,8 @@ void Worker::startWorking()
         }
 
         m_state.store(WorkerState::Stopped, memory_order_relaxed);
+        m_stoppedSignal.fetch_add(1);
+        m_stoppedSignal.notify_all();
 
         if (returnedError && g_exitOnError)
         {
@@ -75,9 +82,20 @@ void Worker::stopWorking()
     m_state.compare_exchange_strong(ex, WorkerState::Stopping);
 }
 
+void Worker::waitStopped()
+{
+    for (;;)
+    {
+        uint32_t signal = m_stoppedSignal.load();
+        if (m_state.load(memory_order_relaxed) == WorkerState::Stopped)
+            return;
+        m_stoppedSignal.wait(signal);
+    }
+}
+
 Worker::~Worker()
 {
-    if (m_work->joinable())
+    if (m_work && m_work->joinable())
     {
         m_state.store(WorkerState::Stopping, memory_order_relaxed);
         m_work->join();
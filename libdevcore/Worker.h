@@ -27,6 +27,7 @@
 #include <string>
 #include <thread>
 
+#include "Futex.h"
 #include "Guards.h"
 
 extern bool g_exitOnError;
@@ -63,6 +64,9 @@ public:
     // Whether or not this worker should stop
     bool shouldStop() const { return m_state == WorkerState::Stopping; }
 
+    // Sleeps till the worker thread has stopped
+    void waitStopped();
+
 private:
     virtual void workLoop() = 0;
 
@@ -71,6 +75,7 @@ private:
     mutable Mutex x_work;                 // Lock
     std::unique_ptr<std::thread> m_work;  // The thread running the work of derived class
     std::atomic<WorkerState> m_state = {WorkerState::Stopped};
+    Futex m_stoppedSignal;  // Bumped each time the thread stops
 };
 
 }  // namespace dev
@@ -6,6 +6,7 @@
 #include <boost/dll.hpp>
 
 #include <libethcore/Farm.h>
+#include <libethcore/KernelCompiler.h>
 #include <ethash/ethash.hpp>
 
 #include "CLMiner.h"
@@ -255,7 +256,8 @@ CLMiner::CLMiner(unsigned _index, CLSettings _settings, DeviceDescriptor& _devic
 
 void CLMiner::workLoop()
 {
-    if (!initDevice())
+    // On hot restart context, buffers and kernels are still there
+    if (!resumeResident() && !initDevice())
         return;
 
     try
@@ -270,6 +272,17 @@ void CLMiner::workLoop()
     }
 }
 
+void CLMiner::setWorkSizes(unsigned _globalWorkSizeMultiplier, unsigned _localWorkSize)
+{
+    m_settings.globalWorkSizeMultiplier = _globalWorkSizeMultiplier;
+    m_settings.localWorkSize = _localWorkSize;
+    m_settings.globalWorkSize = m_settings.localWorkSize * m_settings.globalWorkSizeMultiplier;
+
+    // ProgPoW kernels are built for the local work size. The one for
+    // DAG generation is rebuilt on next epoch
+    forceKernelReload();
+}
+
 bool CLMiner::loadProgPoWKernel(uint32_t _seed)
 {
     // Get ptx from cache
@@ -284,7 +297,7 @@ bool CLMiner::loadProgPoWKernel(uint32_t _seed)
             if (m_deviceDescriptor.clPlatformType == ClPlatformTypeEnum::Nvidia)
             {
                 if (item.platform == ClPlatformTypeEnum::Nvidia && item.compute == m_deviceDescriptor.clNvCompute &&
-                    item.period == _seed)
+                    item.period == _seed && item.groupSize == m_settings.localWorkSize)
                 {
                     _bin = item.bin;
                     _bin_sz = item.bin_sz;
@@ -295,7 +308,7 @@ bool CLMiner::loadProgPoWKernel(uint32_t _seed)
             else
             {
                 if (item.platform == m_deviceDescriptor.clPlatformType && item.name == m_deviceDescriptor.name &&
-                    item.period == _seed)
+                    item.period == _seed && item.groupSize == m_settings.localWorkSize)
                 {
                     _bin = item.bin;
                     _bin_sz = item.bin_sz;
@@ -334,16 +347,27 @@ bool CLMiner::loadProgPoWKernel(uint32_t _seed)
     return true;
 }
 
+std::string CLMiner::compileKey()
+{
+    // Same criteria used to match items in CLKernelCache
+    if (m_deviceDescriptor.clPlatformType == ClPlatformTypeEnum::Nvidia)
+        return "cl-nv-" + m_deviceDescriptor.clNvCompute + "-" + to_string(m_settings.localWorkSize);
+    return "cl-" + to_string(int(m_deviceDescriptor.clPlatformType)) + "-" + m_deviceDescriptor.name + "-" +
+           to_string(m_settings.localWorkSize);
+}
+
 void CLMiner::compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms)
 {
     {
-        // Delete from cache older periods
+        // Delete from cache older periods (kernels compiled ahead
+        // of the active period push latest forward)
         uint32_t latest = m_progpow_kernel_latest.load(memory_order_relaxed);
+        uint32_t keep = 2 + KernelCompiler::get().lookahead();
         std::lock_guard<std::mutex> cache_mtx(CLMiner::cl_kernel_cache_mutex);
         for (size_t i = 0; i < CLMiner::CLKernelCache.size(); i++)
         {
             const CLKernelCacheItem& item = CLMiner::CLKernelCache.at(i);
-            if (item.period + 2 < latest)
+            if (item.period + keep < latest)
             {
                 CLMiner::CLKernelCache.at(i) = std::move(CLMiner::CLKernelCache.back());
                 CLMiner::CLKernelCache.pop_back();
@@ -361,13 +385,13 @@ void CLMiner::compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms)
             if (m_deviceDescriptor.clPlatformType == ClPlatformTypeEnum::Nvidia)
             {
                 if (item.platform == ClPlatformTypeEnum::Nvidia && item.compute == m_deviceDescriptor.clNvCompute &&
-                    item.period == _seed)
+                    item.period == _seed && item.groupSize == m_settings.localWorkSize)
                     return;
             }
             else
             {
                 if (item.platform == m_deviceDescriptor.clPlatformType && item.name == m_deviceDescriptor.name &&
-                    item.period == _seed)
+                    item.period == _seed && item.groupSize == m_settings.localWorkSize)
                     return;
             }
         }
@@ -499,11 +523,11 @@ void CLMiner::compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms)
     {
         std::lock_guard<std::mutex> cache_mtx(CLMiner::cl_kernel_cache_mutex);
         if (m_deviceDescriptor.clPlatformType == ClPlatformTypeEnum::Nvidia)
-            CLKernelCache.emplace_back(
-                ClPlatformTypeEnum::Nvidia, m_deviceDescriptor.clNvCompute, "", _seed, bin, bin_sz);
+            CLKernelCache.emplace_back(ClPlatformTypeEnum::Nvidia, m_deviceDescriptor.clNvCompute, "", _seed,
+                m_settings.localWorkSize, bin, bin_sz);
         else
-            CLKernelCache.emplace_back(
-                m_deviceDescriptor.clPlatformType, "", m_deviceDescriptor.name, _seed, bin, bin_sz);
+            CLKernelCache.emplace_back(m_deviceDescriptor.clPlatformType, "", m_deviceDescriptor.name, _seed,
+                m_settings.localWorkSize, bin, bin_sz);
     }
 
 #ifdef _DEVELOPER
@@ -928,9 +952,6 @@ void CLMiner::progpow_search()
     using clock = std::chrono::steady_clock;
     clock::time_point start;
 
-    m_workSearchDuration = 0;
-    m_workHashes = 0;
-
     m_queue.enqueueWriteBuffer(m_header, CL_FALSE, 0, m_work_active.header.size, m_work_active.header.data());
     m_progpow_search_kernel.setArg(1, m_header);
 
@@ -938,6 +959,7 @@ void CLMiner::progpow_search()
     uint64_t startNonce, target;
     uint32_t found_count = 0;
     startNonce = m_work_active.startNonce;
+    NonceSegment segment(m_work_active.startNonce, m_work_active.segmentLength);
 
     // Target may be passed as pinned memory pointer
     // instead of parameter on each kernel launch
@@ -951,16 +973,12 @@ void CLMiner::progpow_search()
 
     volatile search_results results;
 
-    m_workSearchStart = steady_clock::now();
+    updateSwitchTime();
 
 #ifdef _DEVELOPER
     // Optionally log job switch time
     if (g_logOptions & LOG_SWITCH)
-        cllog << "Switch time: "
-              << std::chrono::duration_cast<std::chrono::milliseconds>(
-                     std::chrono::steady_clock::now() - m_workSwitchStart)
-                     .count()
-              << " ms.";
+        cllog << "Switch time: " << RetrieveSwitchTime() / 1000 << " ms.";
 #endif
 
 
@@ -1016,9 +1034,8 @@ void CLMiner::progpow_search()
             found_count = std::min((unsigned)results.count, MAX_SEARCH_RESULTS);
             m_activeKernel.store(false, memory_order_relaxed);
 
-            // Accumulate hashrate data
-            m_workSearchDuration = duration_cast<microseconds>(steady_clock::now() - m_workSearchStart).count();
-            m_workHashes += (m_settings.localWorkSize * results.rounds);
+            // Account hashes for hashrate estimation
+            updateHashRate(uint64_t(m_settings.localWorkSize) * results.rounds);
 
             startNonce += m_settings.globalWorkSize;
         }
@@ -1031,6 +1048,7 @@ void CLMiner::progpow_search()
 
             // run the kernel
             m_activeKernel.store(true, memory_order_relaxed);
+            startNonce = segmentNonce(segment, m_work_active, startNonce, m_settings.globalWorkSize);
             m_progpow_search_kernel.setArg(3, startNonce);
             start = clock::now();
             m_queue.enqueueNDRangeKernel(
@@ -1044,8 +1062,8 @@ void CLMiner::progpow_search()
             {
                 h256 mix;
                 memcpy(mix.data(), (void*)results.result[i].mix, sizeof(results.result[i].mix));
-                auto sol =
-                    Solution{results.result[i].nonce, mix, m_work_active, std::chrono::steady_clock::now(), m_index};
+                auto sol = SolutionRecord{results.result[i].nonce, mix, m_work_active.generation, m_index,
+                    std::chrono::steady_clock::now()};
 
                 cllog << EthWhite << "Job: " << m_work_active.header.abridged()
                       << " Sol: " << toHex(sol.nonce, HexPrefix::Add) << EthReset;
@@ -1056,9 +1074,6 @@ void CLMiner::progpow_search()
             found_count = 0;
         }
 
-        // Update the hash rate
-        updateHashRate(m_workHashes, m_workSearchDuration);
-
         if (!m_activeKernel.load(memory_order_relaxed))
             break;
     }
@@ -72,13 +72,20 @@ typedef struct
 struct CLKernelCacheItem
 {
     CLKernelCacheItem(ClPlatformTypeEnum _platform, std::string _compute, std::string _name, uint32_t _period,
-        unsigned char* _bin, size_t _bin_sz)
-      : platform(_platform), compute(_compute), name(_name), period(_period), bin(_bin), bin_sz(_bin_sz)
+        unsigned _groupSize, unsigned char* _bin, size_t _bin_sz)
+      : platform(_platform),
+        compute(_compute),
+        name(_name),
+        period(_period),
+        groupSize(_groupSize),
+        bin(_bin),
+        bin_sz(_bin_sz)
     {}
     ClPlatformTypeEnum platform;  // OpenCL Platform
     string compute;               // Compute version for Nvidia platform
     string name;                  // Arch name for Amd
     uint32_t period;              // Height of ProgPoW period
+    unsigned groupSize;           // Local work size the kernel is built for
     unsigned char* bin;           // Binary/Ptx program
     size_t bin_sz;                // Binary size
 };
@@ -98,6 +105,9 @@ public:
 
     void kick_miner() override;
 
+    // Changes work sizes. Only while the worker thread is stopped
+    void setWorkSizes(unsigned _globalWorkSizeMultiplier, unsigned _localWorkSize);
+
 protected:
     bool initDevice() override;
 
@@ -108,6 +118,7 @@ private:
 
     void compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms) override;
     bool loadProgPoWKernel(uint32_t _seed) override;
+    std::string compileKey() override;
 
     void workLoop() override;
 
@@ -34,6 +34,9 @@ along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/version.hpp>
 
+#include <fstream>
+#include <set>
+
 #if 0
 #include <boost/fiber/numa/pin_thread.hpp>
 #include <boost/fiber/numa/topology.hpp>
@@ -133,6 +136,106 @@ unsigned CPUMiner::getNumDevices()
 #endif
 }
 
+/*
+ * Parses a kernel cpu list (e.g. "0-3,8-11") into processor numbers
+ */
+static vector<unsigned> parseCpuList(const string& _list)
+{
+    vector<unsigned> ret;
+    stringstream ss(_list);
+    string range;
+    while (getline(ss, range, ','))
+    {
+        try
+        {
+            size_t dash = range.find('-');
+            unsigned first = unsigned(stoul(range.substr(0, dash)));
+            unsigned last = (dash == string::npos) ? first : unsigned(stoul(range.substr(dash + 1)));
+            for (unsigned i = first; i <= last; i++)
+                ret.push_back(i);
+        }
+        catch (const std::exception&)
+        {
+            // Ignore malformed (or empty) ranges
+        }
+    }
+    return ret;
+}
+
+/*
+ * returns groups of logical processors sharing the same NUMA node
+ * or the same L3 cache. Falls back to a single group with all processors
+ */
+static vector<vector<unsigned>> getCpuGroups(unsigned _grouping)
+{
+    std::set<vector<unsigned>> groups;
+    unsigned numDevices = CPUMiner::getNumDevices();
+
+#if defined(__linux__)
+    for (unsigned i = 0; i < numDevices; i++)
+    {
+        string path;
+        if (_grouping == CPU_GROUPING_NUMA)
+            path = "/sys/devices/system/node/node" + to_string(i) + "/cpulist";
+        else
+            path = "/sys/devices/system/cpu/cpu" + to_string(i) + "/cache/index3/shared_cpu_list";
+
+        std::ifstream f(path);
+        string line;
+        if (!f.is_open() || !getline(f, line))
+            continue;
+
+        vector<unsigned> cpus = parseCpuList(line);
+        if (cpus.size())
+            groups.insert(cpus);
+    }
+#else
+    (void)_grouping;
+#endif
+
+    if (groups.empty())
+    {
+        vector<unsigned> cpus;
+        for (unsigned i = 0; i < numDevices; i++)
+            cpus.push_back(i);
+        groups.insert(cpus);
+    }
+
+    return vector<vector<unsigned>>(groups.begin(), groups.end());
+}
+
+/*
+ * Binds the current thread to a specific logical processor
+ */
+static bool bindThreadToProcessor(uint64_t _processor)
+{
+#if defined(__APPLE__) || defined(__MACOSX)
+//#error "TODO: Function bindThreadToProcessor() on MAXOSX not implemented"
+    (void)_processor;
+#elif defined(__linux__)
+    cpu_set_t cpuset;
+    int err;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(_processor, &cpuset);
+
+    err = sched_setaffinity(0, sizeof(cpuset), &cpuset);
+    if (err != 0)
+    {
+        cwarn << "Error in func " << __FUNCTION__ << " at sched_setaffinity() \"" << strerror(errno)
+              << "\"\n";
+        return false;
+    }
+#else
+    DWORD_PTR dwThreadAffinityMask = 1i64 << (_processor);
+    DWORD_PTR previous_mask;
+    previous_mask = SetThreadAffinityMask(GetCurrentThread(), dwThreadAffinityMask);
+    if (previous_mask == NULL)
+        return false;
+#endif
+    return true;
+}
+
 
 /* ######################## CPU Miner ######################## */
 
@@ -143,6 +246,9 @@ struct CPUChannel : public LogChannel
 };
 #define cpulog clog(CPUChannel)
 
+// Number of nonces hashed between two checks for a new job
+#define CPU_SEARCH_CHUNK_NONCES 4U
+
 
 CPUMiner::CPUMiner(unsigned _index, CPSettings _settings, DeviceDescriptor& _device)
   : Miner("cpu-", _index), m_settings(_settings)
@@ -157,6 +263,23 @@ bool CPUMiner::initDevice()
 {
     DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::initDevice begin");
 
+    if (!m_deviceDescriptor.cpCpuList.empty())
+    {
+        // Grouped device : the miner thread acts as the first hashing thread
+        // of the group while the others are spawned by startPool(). A group
+        // of one processor is bound to it as well : the ungrouped mapping
+        // below doesn't apply to group numbers
+        cpulog << "Using CPU group: " << m_deviceDescriptor.uniqueId << " ("
+               << m_deviceDescriptor.cpCpuList.size() << " processors)"
+               << " Memory : " << dev::getFormattedMemory((double)m_deviceDescriptor.totalMemory);
+
+        if (!bindThreadToProcessor(m_deviceDescriptor.cpCpuList.front()))
+            cwarn << "cp-" << m_index << " could not bind thread to cpu" << m_deviceDescriptor.cpCpuList.front();
+
+        DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::initDevice end");
+        return true;
+    }
+
     cpulog << "Using CPU: " << m_deviceDescriptor.cpCpuNumber << " " << m_deviceDescriptor.cuName
            << " Memory : " << dev::getFormattedMemory((double)m_deviceDescriptor.totalMemory);
 
@@ -164,33 +287,11 @@ bool CPUMiner::initDevice()
     uint64_t device_num=CPUMiner::getNumDevices();
     uint64_t processor_num=device_num-(cpu_num%device_num)-1;
 
-#if defined(__APPLE__) || defined(__MACOSX)
-//#error "TODO: Function CPUMiner::initDevice() on MAXOSX not implemented"
-#elif defined(__linux__)
-    cpu_set_t cpuset;
-    int err;
-
-    CPU_ZERO(&cpuset);
-    CPU_SET(processor_num, &cpuset);
-
-    err = sched_setaffinity(0, sizeof(cpuset), &cpuset);
-    if (err != 0)
+    if (!bindThreadToProcessor(processor_num))
     {
-        cwarn << "Error in func " << __FUNCTION__ << " at sched_setaffinity() \"" << strerror(errno)
-              << "\"\n";
         cwarn << "cp-" << m_index << "could not bind thread to cpu" << processor_num
               << "\n";
     }
-#else
-    DWORD_PTR dwThreadAffinityMask = 1i64 << (processor_num);
-    DWORD_PTR previous_mask;
-    previous_mask = SetThreadAffinityMask(GetCurrentThread(), dwThreadAffinityMask);
-    if (previous_mask == NULL)
-    {
-        cwarn << "cp-" << m_index << "could not bind thread to cpu" << processor_num
-              << "\n";
-    }
-#endif
     cpulog << "Map CPU-" << cpu_num << " to Processor-" << processor_num << " END";
     DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::initDevice end");
     return true;
@@ -204,44 +305,196 @@ void dev::eth::CPUMiner::progpow_search()
     auto header = progpow::hash256_from_bytes(m_work_active.header.data());
     auto boundary = progpow::hash256_from_bytes(m_work_active.boundary.data());
 
-    this->start_time=steady_clock::now();
-    this->hash_count=0;
+    updateSwitchTime();
+
+    if (m_thread_hr)
+    {
+        group_search();
+        return;
+    }
+
+    NonceSegment segment(m_work_active.startNonce, m_work_active.segmentLength);
 
     while (true)
     {
         // Exit next time around if there's new work awaiting
-        if (m_new_work.load(memory_order_relaxed))
+        if (m_new_work.load(memory_order_relaxed) || workObsolete())
             break;
 
-        auto r = progpow::search(
-            context, m_work_active.block, header, boundary, m_work_active.startNonce, m_settings.batchSize);
+        // Hash the batch in small chunks and check the work generation
+        // in between so a new job cancels the batch within a few nonces
+        uint32_t batch_hashes = 0;
+        while (batch_hashes < m_settings.batchSize && !workObsolete())
+        {
+            uint32_t chunk = std::min(CPU_SEARCH_CHUNK_NONCES, m_settings.batchSize - batch_hashes);
+            m_work_active.startNonce = segmentNonce(segment, m_work_active, m_work_active.startNonce, chunk);
+            auto r = progpow::search(
+                context, m_work_active.block, header, boundary, m_work_active.startNonce, chunk);
+            if (r.solution_found)
+            {
+                h256 mix{reinterpret_cast<byte*>(r.mix_hash.bytes), h256::ConstructFromPointer};
+                auto sol = SolutionRecord{
+                    r.nonce, mix, m_work_active.generation, m_index, std::chrono::steady_clock::now()};
+
+                Farm::f().submitProof(sol);
+
+                cpulog << EthWhite << "Job: " << m_work_active.header.abridged()
+                       << " Sol: " << toHex(sol.nonce, HexPrefix::Add) << EthReset;
+
+                chunk = uint32_t(r.nonce - m_work_active.startNonce) + 1;
+            }
+
+            batch_hashes += chunk;
+            m_work_active.startNonce += chunk;
+        }
+
+        updateHashRate(batch_hashes);
+    }
+}
+
+void CPUMiner::group_search()
+{
+    // Hand the active job over to the pool
+    std::shared_ptr<CPUGroupJob> job(new CPUGroupJob);
+    job->epoch = m_work_active.epoch;
+    job->block = m_work_active.block;
+    job->header = progpow::hash256_from_bytes(m_work_active.header.data());
+    job->boundary = progpow::hash256_from_bytes(m_work_active.boundary.data());
+    job->generation = m_work_active_generation;
+    job->work = m_work_active;
+
+    {
+        std::lock_guard<std::mutex> l(x_pool_nonce);
+        m_pool_nonce = m_work_active.startNonce;
+        m_pool_segment = NonceSegment(m_work_active.startNonce, m_work_active.segmentLength);
+    }
+    std::atomic_store(&m_pool_job, std::shared_ptr<const CPUGroupJob>(job));
+    uint32_t seq = m_pool_seq.fetch_add(1) + 1;
+    m_pool_seq.notify_all();
+
+    // The miner thread hashes as well and returns
+    // on new work or on a kick (pause/stop)
+    searchShared(0, *job, seq);
+
+    // Park the pool till next job
+    std::atomic_store(&m_pool_job, std::shared_ptr<const CPUGroupJob>());
+    m_pool_seq.fetch_add(1);
+    m_pool_seq.notify_all();
+}
+
+void CPUMiner::searchShared(unsigned _thread, CPUGroupJob const& _job, uint32_t _seq)
+{
+    using namespace std::chrono;
+    const auto& context = progpow::get_global_epoch_context_full(_job.epoch);
+
+    auto start = steady_clock::now();
+    uint64_t hashes = 0;
+
+    while (m_pool_seq.load() == _seq && m_work_generation.load(memory_order_relaxed) == _job.generation)
+    {
+        // The miner thread also honours kicks (pause/stop)
+        if (_thread == 0 && m_new_work.load(memory_order_relaxed))
+            break;
+
+        uint64_t nonce = nextPoolNonce(_job);
+        auto r = progpow::search(context, _job.block, _job.header, _job.boundary, nonce, CPU_SEARCH_CHUNK_NONCES);
         if (r.solution_found)
         {
             h256 mix{reinterpret_cast<byte*>(r.mix_hash.bytes), h256::ConstructFromPointer};
-            auto sol = Solution{r.nonce, mix, m_work_active, std::chrono::steady_clock::now(), m_index};
+            auto sol = SolutionRecord{r.nonce, mix, _job.work.generation, m_index, steady_clock::now()};
 
             Farm::f().submitProof(sol);
 
-            cpulog << EthWhite << "Job: " << m_work_active.header.abridged()
-                   << " Sol: " << toHex(sol.nonce, HexPrefix::Add) << EthReset;
-
-            auto to = steady_clock::now();
+            cpulog << EthWhite << "Job: " << _job.work.header.abridged() << " Sol: " << toHex(sol.nonce, HexPrefix::Add)
+                   << EthReset;
 
-            this->hash_count+=uint32_t(r.nonce - m_work_active.startNonce) + 1;
-
-            m_work_active.startNonce = r.nonce + 1;
+            hashes += (r.nonce - nonce) + 1;
+            updateHashRate((r.nonce - nonce) + 1);
         }
         else
         {
-            this->hash_count+=m_settings.batchSize;
+            hashes += CPU_SEARCH_CHUNK_NONCES;
+            updateHashRate(CPU_SEARCH_CHUNK_NONCES);
+        }
+
+        // Minimum sampling interval is 1s
+        auto us = duration_cast<microseconds>(steady_clock::now() - start).count();
+        if (us >= 1000000)
+            m_thread_hr[_thread].store(float(hashes * 1.0e6 / us), memory_order_relaxed);
+    }
+}
+
+uint64_t CPUMiner::nextPoolNonce(CPUGroupJob const& _job)
+{
+    // A chunk takes milliseconds to hash so the lock is hardly contended
+    std::lock_guard<std::mutex> l(x_pool_nonce);
+    uint64_t nonce = segmentNonce(m_pool_segment, _job.work, m_pool_nonce, CPU_SEARCH_CHUNK_NONCES);
+    m_pool_nonce = nonce + CPU_SEARCH_CHUNK_NONCES;
+    return nonce;
+}
+
+void CPUMiner::poolLoop(unsigned _thread)
+{
+    unsigned processor = m_deviceDescriptor.cpCpuList.at(_thread);
+    dev::setThreadName(("cpu-" + to_string(m_index) + "." + to_string(_thread)).c_str());
+    if (!bindThreadToProcessor(processor))
+        cwarn << "cp-" << m_index << "." << _thread << " could not bind thread to cpu" << processor;
+
+    uint32_t seen = m_pool_seq.load();
+    while (true)
+    {
+        // Read the sequence before anything else so a publish
+        // in between makes wait() return immediately
+        uint32_t seq = m_pool_seq.load();
+        if (m_pool_stop.load(memory_order_relaxed))
+            break;
 
-            m_work_active.startNonce += m_settings.batchSize;
+        std::shared_ptr<const CPUGroupJob> job = std::atomic_load(&m_pool_job);
+        if (seq == seen || !job)
+        {
+            seen = seq;
+            m_pool_seq.wait(seq);
+            continue;
         }
-        auto us = duration_cast<microseconds>(steady_clock::now() - this->start_time).count();
-        updateHashRate(this->hash_count, us);
+
+        seen = seq;
+        searchShared(_thread, *job, seq);
     }
 }
 
+void CPUMiner::startPool()
+{
+    unsigned threads = unsigned(m_deviceDescriptor.cpCpuList.size());
+    m_thread_hr.reset(new std::atomic<float>[threads]);
+    for (unsigned i = 0; i < threads; i++)
+        m_thread_hr[i].store(0.0f, memory_order_relaxed);
+
+    m_pool_stop.store(false, memory_order_relaxed);
+    for (unsigned i = 1; i < threads; i++)
+        m_pool.emplace_back(&CPUMiner::poolLoop, this, i);
+}
+
+void CPUMiner::stopPool()
+{
+    m_pool_stop.store(true, memory_order_relaxed);
+    std::atomic_store(&m_pool_job, std::shared_ptr<const CPUGroupJob>());
+    m_pool_seq.fetch_add(1);
+    m_pool_seq.notify_all();
+
+    for (auto& t : m_pool)
+        t.join();
+    m_pool.clear();
+}
+
+vector<float> CPUMiner::RetrieveThreadHashRates()
+{
+    vector<float> ret;
+    if (m_thread_hr)
+        for (unsigned i = 0; i < m_deviceDescriptor.cpCpuList.size(); i++)
+            ret.push_back(m_thread_hr[i].load(memory_order_relaxed));
+    return ret;
+}
+
 void CPUMiner::compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms)
 {
     // CPU miner does not have any kernel to compile
@@ -266,26 +519,46 @@ void CPUMiner::workLoop()
 {
     DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::workLoop() begin");
 
+    // Thread affinity is per thread hence initDevice() is needed even
+    // on hot restart. DAG and loaded kernel are kept in minerLoop()
+    resumeResident();
     if (!initDevice())
         return;
 
+    if (m_deviceDescriptor.cpCpuList.size() > 1)
+        startPool();
+
     minerLoop();
 
+    if (m_thread_hr)
+        stopPool();
+
     DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::workLoop() end");
 }
 
 
-void CPUMiner::enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection)
+void CPUMiner::enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection, unsigned _grouping)
 {
     unsigned numDevices = getNumDevices();
-
-    for (unsigned i = 0; i < numDevices; i++)
+    vector<vector<unsigned>> groups;
+    if (_grouping != CPU_GROUPING_NONE)
+        groups = getCpuGroups(_grouping);
+    else
+        for (unsigned i = 0; i < numDevices; i++)
+            groups.push_back(vector<unsigned>(1, i));
+
+    for (unsigned i = 0; i < groups.size(); i++)
     {
         string uniqueId;
         ostringstream s;
         DeviceDescriptor deviceDescriptor;
 
-        s << "cpu-" << i;
+        if (_grouping == CPU_GROUPING_NUMA)
+            s << "cpu-node-" << i;
+        else if (_grouping == CPU_GROUPING_L3)
+            s << "cpu-l3-" << i;
+        else
+            s << "cpu-" << i;
         uniqueId = s.str();
         if (_DevicesCollection.find(uniqueId) != _DevicesCollection.end())
             deviceDescriptor = _DevicesCollection[uniqueId];
@@ -296,12 +569,16 @@ void CPUMiner::enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollectio
         s.clear();
         s << "ethash::eval()/boost " << (BOOST_VERSION / 100000) << "." << (BOOST_VERSION / 100 % 1000) << "."
           << (BOOST_VERSION % 100);
+        if (_grouping != CPU_GROUPING_NONE)
+            s << " x" << groups[i].size();
         deviceDescriptor.name = s.str();
         deviceDescriptor.uniqueId = uniqueId;
         deviceDescriptor.type = DeviceTypeEnum::Cpu;
         deviceDescriptor.totalMemory = getTotalPhysAvailableMemory();
 
-        deviceDescriptor.cpCpuNumber = i;
+        deviceDescriptor.cpCpuNumber = (_grouping != CPU_GROUPING_NONE ? groups[i].front() : i);
+        if (_grouping != CPU_GROUPING_NONE)
+            deviceDescriptor.cpCpuList = groups[i];
 
         _DevicesCollection[uniqueId] = deviceDescriptor;
     }
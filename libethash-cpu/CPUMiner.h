@@ -23,11 +23,27 @@ along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <functional>
 #include <chrono>
+#include <mutex>
+
+#define CPU_GROUPING_NONE 0
+#define CPU_GROUPING_NUMA 1
+#define CPU_GROUPING_L3 2
 
 namespace dev
 {
 namespace eth
 {
+// Job shared among the hashing threads of a grouped CPU device
+struct CPUGroupJob
+{
+    int epoch = -1;
+    int block = -1;
+    progpow::hash256 header = {};
+    progpow::hash256 boundary = {};
+    uint64_t generation = 0;  // Work generation this job belongs to
+    WorkPackage work;
+};
+
 class CPUMiner : public Miner
 {
 public:
@@ -35,7 +51,13 @@ public:
     ~CPUMiner() override = default;
 
     static unsigned getNumDevices();
-    static void enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection);
+    static void enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection, unsigned _grouping);
+
+    vector<float> RetrieveThreadHashRates() override;
+
+    // Changes the hashes computed between checks for new work.
+    // Only while the worker thread is stopped
+    void setBatchSize(unsigned _batchSize) { m_settings.batchSize = _batchSize; }
 
 protected:
     bool initDevice() override;
@@ -44,12 +66,30 @@ private:
     void progpow_search() override;
     void compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms) override;
     bool loadProgPoWKernel(uint32_t _seed) override;
+    std::string compileKey() override { return "cp"; }
 
     void workLoop() override;
 
+    // Grouped device : this instance drives a pool of hashing threads
+    // sharing the same work slot and nonce counter
+    void startPool();
+    void stopPool();
+    void poolLoop(unsigned _thread);
+    void group_search();
+    void searchShared(unsigned _thread, CPUGroupJob const& _job, uint32_t _seq);
+    uint64_t nextPoolNonce(CPUGroupJob const& _job);
+
     CPSettings m_settings;
-    std::chrono::steady_clock::time_point start_time;
-    uint32_t hash_count;
+
+    std::vector<std::thread> m_pool;  // Hashing threads (thread 0 is the miner thread itself)
+    std::shared_ptr<const CPUGroupJob> m_pool_job;      // Job handed to the pool (null when parked).
+                                                        // Accessed through std::atomic_load/store
+    Futex m_pool_seq;                                   // Bumped each time m_pool_job changes
+    std::mutex x_pool_nonce;                            // Guards m_pool_nonce and m_pool_segment
+    uint64_t m_pool_nonce = 0;                          // Next nonce to be hashed by the group
+    NonceSegment m_pool_segment;                        // Segment the group is working on
+    std::atomic<bool> m_pool_stop = {false};            // Signals pool threads to exit
+    std::unique_ptr<std::atomic<float>[]> m_thread_hr;  // Hashrate of each thread
 };
 
 
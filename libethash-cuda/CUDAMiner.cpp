@@ -16,6 +16,7 @@ along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <libethcore/Farm.h>
+#include <libethcore/KernelCompiler.h>
 #include <ethash/ethash.hpp>
 
 #include "CUDAMiner.h"
@@ -170,13 +171,29 @@ void CUDAMiner::workLoop()
     m_active_streams[0] = false;
     m_active_streams[1] = false;
 
-    if (!initDevice())
+    if (resumeResident())
+    {
+        // Hot restart : buffers, DAG and module are still there
+        // this thread only needs to bind to the device
+        try
+        {
+            CUDA_SAFE_CALL(cudaSetDevice(m_deviceDescriptor.cuDeviceIndex));
+        }
+        catch (const cuda_runtime_error& ec)
+        {
+            cudalog << "Could not resume CUDA device on Pci Id " << m_deviceDescriptor.uniqueId
+                    << " Error : " << ec.what();
+            return;
+        }
+    }
+    else if (!initDevice())
         return;
 
     try
     {
-        minerLoop();                        // In base class Miner
-        CUDA_SAFE_CALL(cudaDeviceReset());  // Reset miner and stop working
+        minerLoop();  // In base class Miner
+        if (!m_resident)
+            CUDA_SAFE_CALL(cudaDeviceReset());  // Reset miner and stop working
     }
     catch (cuda_runtime_error const& _e)
     {
@@ -186,6 +203,23 @@ void CUDAMiner::workLoop()
     }
 }
 
+void CUDAMiner::releaseDevice()
+{
+    // Not on the worker thread : bind to the device first
+    try
+    {
+        CUDA_SAFE_CALL(cudaSetDevice(m_deviceDescriptor.cuDeviceIndex));
+        unloadProgPoWKernel();
+        CUDA_SAFE_CALL(cudaDeviceReset());
+    }
+    catch (const cuda_runtime_error& ec)
+    {
+        cudalog << "Could not release CUDA device on Pci Id " << m_deviceDescriptor.uniqueId
+                << " Error : " << ec.what();
+    }
+    m_progpow_kernel_loaded = false;
+}
+
 bool CUDAMiner::loadProgPoWKernel(uint32_t _seed)
 {
     unloadProgPoWKernel();
@@ -240,13 +274,15 @@ bool CUDAMiner::loadProgPoWKernel(uint32_t _seed)
 void CUDAMiner::compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms)
 {
     {
-        // Delete from cache older periods
+        // Delete from cache older periods (kernels compiled ahead
+        // of the active period push latest forward)
         uint32_t latest = m_progpow_kernel_latest.load(memory_order_relaxed);
+        uint32_t keep = 2 + KernelCompiler::get().lookahead();
         std::lock_guard<std::mutex> cache_mtx(CUDAMiner::cu_kernel_cache_mutex);
         for (size_t i = 0; i < CUDAMiner::CUKernelCache.size(); i++)
         {
             const CUKernelCacheItem& item = CUDAMiner::CUKernelCache.at(i);
-            if (item.period + 2 < latest)
+            if (item.period + keep < latest)
             {
                 CUDAMiner::CUKernelCache.at(i) = std::move(CUDAMiner::CUKernelCache.back());
                 CUDAMiner::CUKernelCache.pop_back();
@@ -477,12 +513,10 @@ void CUDAMiner::progpow_search()
 
     using namespace std::chrono;
 
-    m_workSearchDuration = 0;
-    m_workHashes = 0;
-
     uint64_t startNonce, target;
 
     startNonce = m_work_active.startNonce;
+    NonceSegment segment(m_work_active.startNonce, m_work_active.segmentLength);
 
     hash32_t header = *reinterpret_cast<hash32_t const*>(m_work_active.header.data());
     CUDA_SAFE_CALL(cudaMemcpy(d_pheader, &header, sizeof(hash32_t), cudaMemcpyHostToDevice));
@@ -513,8 +547,7 @@ void CUDAMiner::progpow_search()
                 found_count = std::min((unsigned)buffer->count, MAX_SEARCH_RESULTS);
                 buffer->count = 0;
                 m_active_streams[streamIndex] = false;
-                m_workSearchDuration = duration_cast<microseconds>(steady_clock::now() - m_workSearchStart).count();
-                m_workHashes += m_batch_size;
+                updateHashRate(m_batch_size);
             }
         }
 
@@ -522,21 +555,17 @@ void CUDAMiner::progpow_search()
         {
             if (launchIndex == 0)
             {
-                m_workSearchStart = steady_clock::now();
+                updateSwitchTime();
 
 #ifdef _DEVELOPER
                 // Optionally log job switch time
                 if (g_logOptions & LOG_SWITCH)
-                    cudalog << "Switch time: "
-                            << std::chrono::duration_cast<std::chrono::milliseconds>(
-                                   std::chrono::steady_clock::now() - m_workSwitchStart)
-                                   .count()
-                            << " ms.";
+                    cudalog << "Switch time: " << RetrieveSwitchTime() / 1000 << " ms.";
 #endif
             }
 
             // Run the batch for this stream
-            uint64_t batchNonce = startNonce;
+            uint64_t batchNonce = segmentNonce(segment, m_work_active, startNonce, m_batch_size);
             void* args[] = {&batchNonce, &d_pheader, &d_ptarget, &m_dag_progpow, &buffer, &hack_false};
             CU_SAFE_CALL(cuLaunchKernel(m_kernel, m_settings.gridSize, 1, 1,  // grid dim
                 m_settings.blockSize, 1, 1,                                   // block dim
@@ -544,7 +573,7 @@ void CUDAMiner::progpow_search()
                 stream,                                                       // stream
                 args, 0));                                                    // arguments
             m_active_streams[streamIndex] = true;
-            startNonce += m_batch_size;
+            startNonce = batchNonce + m_batch_size;
         }
 
         // Submit solution while kernel running
@@ -557,7 +586,8 @@ void CUDAMiner::progpow_search()
                 h256 mix;
                 uint64_t nonce = buffer->result[i].nonce;
                 memcpy(mix.data(), (void*)&buffer->result[i].mix, sizeof(buffer->result[i].mix));
-                auto sol = Solution{nonce, mix, m_work_active, std::chrono::steady_clock::now(), m_index};
+                auto sol = SolutionRecord{
+                    nonce, mix, m_work_active.generation, m_index, std::chrono::steady_clock::now()};
 
                 cudalog << EthWhite << "Job: " << m_work_active.header.abridged()
                         << " Sol: " << toHex(sol.nonce, HexPrefix::Add) << EthReset;
@@ -568,9 +598,6 @@ void CUDAMiner::progpow_search()
             found_count = 0;
         }
 
-        // Update the hash rate
-        updateHashRate(m_workHashes, m_workSearchDuration);
-
         if (!m_active_streams[0] && !m_active_streams[1])
             break;
 
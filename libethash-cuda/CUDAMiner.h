@@ -62,6 +62,7 @@ public:
 
 protected:
     bool initDevice() override;
+    void releaseDevice() override;
 
     bool initEpoch_internal() override;
 
@@ -73,6 +74,7 @@ private:
     void compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms) override;
     bool loadProgPoWKernel(uint32_t _seed) override;
     void unloadProgPoWKernel();
+    std::string compileKey() override { return "cu-" + m_deviceDescriptor.cuCompute; }
 
     bool m_progpow_kernel_loaded = false;
 
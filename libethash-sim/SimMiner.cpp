@@ -0,0 +1,193 @@
+/*
+This file is part of axisminer.
+
+axisminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+axisminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ SimMiner simulates mining devices but does NOT hash !
+ USE FOR SCALE TESTS ONLY !
+*/
+
+#include <libethcore/Farm.h>
+#include <ethash/ethash.hpp>
+
+#include <thread>
+
+#include "SimMiner.h"
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+struct SimChannel : public LogChannel
+{
+    static const char* name() { return EthOrange "sm"; }
+    static const int verbosity = 2;
+};
+#define simlog clog(SimChannel)
+
+// Interval between two checks for new work. Every device is a thread
+// so this bounds the wakeups of hundreds of them
+#define SIM_TICK_MS 10
+
+// Nonces light evaluated to look for a valid solution
+#define SIM_SEARCH_NONCES 4U
+
+
+SimMiner::SimMiner(unsigned _index, SMSettings _settings, DeviceDescriptor& _device)
+  : Miner("sim-", _index),
+    m_settings(_settings),
+    m_rng(random_device()()),
+    m_solutionInterval(_settings.solutionRate > 0.0 ? _settings.solutionRate : 1.0)
+{
+    m_deviceDescriptor = _device;
+}
+
+bool SimMiner::initDevice()
+{
+    simlog << "Using synthetic device " << m_deviceDescriptor.uniqueId << " "
+           << dev::getFormattedHashes(m_settings.hashrate) << " " << m_settings.solutionRate << " sol/s "
+           << m_settings.invalidPercent << "% invalid";
+    return true;
+}
+
+bool SimMiner::initEpoch_internal()
+{
+    // No DAG to generate : valid solutions are light evaluated
+    return true;
+}
+
+void SimMiner::progpow_search()
+{
+    using namespace std::chrono;
+
+    updateSwitchTime();
+
+    NonceSegment segment(m_work_active.startNonce, m_work_active.segmentLength);
+
+    auto last = steady_clock::now();
+    auto nextSolution = last + duration_cast<steady_clock::duration>(duration<double>(m_solutionInterval(m_rng)));
+
+    while (!m_new_work.load(memory_order_relaxed) && !workObsolete())
+    {
+        this_thread::sleep_for(milliseconds(SIM_TICK_MS));
+
+        auto now = steady_clock::now();
+        double hashes = m_settings.hashrate * duration<double>(now - last).count() + m_hashCarry;
+        last = now;
+        uint64_t count = uint64_t(hashes);
+        m_hashCarry = hashes - double(count);
+        if (!count)
+            continue;
+
+        // Walk the nonce space as a real device would so segment
+        // refills are exercised too
+        m_work_active.startNonce = segmentNonce(segment, m_work_active, m_work_active.startNonce, count);
+
+        if (m_settings.solutionRate > 0.0)
+        {
+            while (nextSolution <= now)
+            {
+                submitSolution(m_work_active.startNonce, count);
+                nextSolution +=
+                    duration_cast<steady_clock::duration>(duration<double>(m_solutionInterval(m_rng)));
+            }
+        }
+
+        m_work_active.startNonce += count;
+        updateHashRate(count);
+    }
+}
+
+void SimMiner::submitSolution(uint64_t _nonce, uint64_t _count)
+{
+    uint64_t nonce = _nonce + uniform_int_distribution<uint64_t>(0, _count - 1)(m_rng);
+    h256 mix;
+
+    if (uniform_int_distribution<unsigned>(0, 99)(m_rng) < m_settings.invalidPercent)
+    {
+        mix = h256::random();
+    }
+    else
+    {
+        // An actual solution needs a hash within the boundary. At
+        // difficulty 0 the first nonce does
+        const auto& context = progpow::get_global_epoch_context(m_work_active.epoch);
+        auto header = progpow::hash256_from_bytes(m_work_active.header.data());
+        auto boundary = progpow::hash256_from_bytes(m_work_active.boundary.data());
+        uint64_t iterations = std::min(uint64_t(SIM_SEARCH_NONCES), _nonce + _count - nonce);
+        auto r = progpow::search_light(context, m_work_active.block, header, boundary, nonce, size_t(iterations));
+        if (!r.solution_found)
+        {
+            simlog << "No solution within " << iterations << " nonces. Lower --diff";
+            return;
+        }
+        nonce = r.nonce;
+        mix = h256{reinterpret_cast<byte*>(r.mix_hash.bytes), h256::ConstructFromPointer};
+    }
+
+    Farm::f().submitProof(
+        SolutionRecord{nonce, mix, m_work_active.generation, m_index, std::chrono::steady_clock::now()});
+}
+
+void SimMiner::compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms)
+{
+    // Synthetic miner does not have any kernel to compile
+    (void)_seed;
+    (void)_dagelms;
+}
+
+bool SimMiner::loadProgPoWKernel(uint32_t _seed)
+{
+    // Synthetic miner does not have any kernel to load
+    (void)_seed;
+    return true;
+}
+
+/*
+ * The main work loop of a Worker thread
+ */
+void SimMiner::workLoop()
+{
+    DEV_BUILD_LOG_PROGRAMFLOW(simlog, "sm-" << m_index << " SimMiner::workLoop() begin");
+
+    if (!resumeResident() && !initDevice())
+        return;
+
+    minerLoop();
+
+    DEV_BUILD_LOG_PROGRAMFLOW(simlog, "sm-" << m_index << " SimMiner::workLoop() end");
+}
+
+void SimMiner::enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection, unsigned _count)
+{
+    for (unsigned i = 0; i < _count; i++)
+    {
+        string uniqueId = "sim-" + to_string(i);
+        DeviceDescriptor deviceDescriptor;
+        if (_DevicesCollection.find(uniqueId) != _DevicesCollection.end())
+            deviceDescriptor = _DevicesCollection[uniqueId];
+        else
+            deviceDescriptor = DeviceDescriptor();
+
+        deviceDescriptor.name = "Synthetic device";
+        deviceDescriptor.uniqueId = uniqueId;
+        deviceDescriptor.type = DeviceTypeEnum::Accelerator;
+        deviceDescriptor.totalMemory = 0;
+        deviceDescriptor.smDetected = true;
+
+        _DevicesCollection[uniqueId] = deviceDescriptor;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+This file is part of axisminer.
+
+axisminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+axisminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <libdevcore/Worker.h>
+#include <libethcore/EthashAux.h>
+#include <libethcore/Miner.h>
+
+#include <chrono>
+#include <random>
+
+namespace dev
+{
+namespace eth
+{
+/**
+ * @brief A device which does not exist.
+ * Reports a configured hashrate and finds solutions at a configured
+ * rate without hashing, so farm, pool and API paths can be loaded with
+ * hundreds of devices. Valid solutions are light evaluated hence only
+ * meet the job boundary at very low difficulties (see --diff).
+ */
+class SimMiner : public Miner
+{
+public:
+    SimMiner(unsigned _index, SMSettings _settings, DeviceDescriptor& _device);
+    ~SimMiner() override = default;
+
+    static void enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection, unsigned _count);
+
+protected:
+    bool initDevice() override;
+    bool initEpoch_internal() override;
+
+private:
+    void progpow_search() override;
+    void compileProgPoWKernel(uint32_t _seed, uint32_t _dagelms) override;
+    bool loadProgPoWKernel(uint32_t _seed) override;
+    std::string compileKey() override { return "sm"; }
+
+    void workLoop() override;
+
+    // Submits a solution among the _count nonces starting from _nonce
+    void submitSolution(uint64_t _nonce, uint64_t _count);
+
+    SMSettings m_settings;
+    std::mt19937_64 m_rng;
+    std::exponential_distribution<double> m_solutionInterval;  // Seconds between two solutions
+    double m_hashCarry = 0.0;                                  // Fraction of hash not accounted yet
+};
+
+}  // namespace eth
+}  // namespace dev
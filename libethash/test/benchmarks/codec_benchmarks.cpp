@@ -0,0 +1,261 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libdevcore/CommonData.h>
+#include <libdevcore/Target.h>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+using namespace dev;
+
+namespace
+{
+// Share difficulties as set by pools. Kept below 1e4 as the legacy
+// conversion throws on the exponent notation of their inverse above
+const double c_diffs[] = {0.5, 1.0, 3.7, 12.5, 100.0, 1000.25, 4000.0};
+const size_t c_diffsCount = sizeof(c_diffs) / sizeof(c_diffs[0]);
+
+// Former string based conversions on arbitrary precision integers
+std::string legacyTargetFromDiff(double diff)
+{
+    using BigInteger = boost::multiprecision::cpp_int;
+
+    static BigInteger base("0x00000000ffff0000000000000000000000000000000000000000000000000000");
+    BigInteger product;
+
+    if (diff == 0)
+    {
+        product = BigInteger("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    }
+    else
+    {
+        diff = 1 / diff;
+
+        BigInteger idiff(diff);
+        product = base * idiff;
+
+        std::string sdiff = boost::lexical_cast<std::string>(diff);
+        size_t ldiff = sdiff.length();
+        size_t offset = sdiff.find(".");
+
+        if (offset != std::string::npos)
+        {
+            size_t precision = (ldiff - 1) - offset;
+            std::string decimals = sdiff.substr(offset + 1);
+            decimals = decimals.erase(0, decimals.find_first_not_of('0'));
+            std::string decimalDivisor = "1";
+            decimalDivisor.resize(precision + 1, '0');
+            BigInteger multiplier(decimals);
+            BigInteger divisor(decimalDivisor);
+            BigInteger decimalproduct;
+            decimalproduct = base * multiplier;
+            decimalproduct /= divisor;
+            product += decimalproduct;
+        }
+    }
+
+    std::stringstream ss;
+    ss << "0x" << std::setw(64) << std::setfill('0') << std::hex << product;
+
+    std::string target = ss.str();
+    boost::algorithm::to_lower(target);
+    return target;
+}
+
+double legacyDiffFromTarget(std::string _target)
+{
+    using BigInteger = boost::multiprecision::cpp_int;
+
+    BigInteger dividend("0x00000000ffff0000000000000000000000000000000000000000000000000000");
+    BigInteger divisor(_target);
+    std::string quotient = boost::lexical_cast<std::string>(dividend / divisor);
+    BigInteger remainder = dividend % divisor;
+    if (!remainder.is_zero())
+    {
+        int precision = 0;
+        quotient.append(".");
+        while (precision < 6 && !remainder.is_zero())
+        {
+            precision++;
+            dividend *= 10;
+            quotient.append(boost::lexical_cast<std::string>(dividend / divisor));
+            remainder = dividend % divisor;
+        }
+    }
+    return std::stod(quotient);
+}
+
+// Former byte at a time hex codecs
+struct HexPairs
+{
+    HexPairs()
+    {
+        static const char digits[] = "0123456789abcdef";
+        for (unsigned i = 0; i < 256; i++)
+        {
+            pairs[i * 2] = digits[i >> 4];
+            pairs[i * 2 + 1] = digits[i & 0xf];
+        }
+    }
+    char pairs[512];
+};
+
+const HexPairs c_hexPairs;
+
+void legacyHexEncode(byte const* _data, size_t _size, char* _out)
+{
+    for (size_t i = 0; i < _size; i++, _out += 2)
+        std::memcpy(_out, &c_hexPairs.pairs[_data[i] * 2], 2);
+}
+
+bool legacyHexDecode(char const* _hex, size_t _size, byte* _out)
+{
+    for (size_t i = 0; i < _size; i++)
+    {
+        int h = fromHex(_hex[i * 2], WhenError::DontThrow);
+        int l = fromHex(_hex[i * 2 + 1], WhenError::DontThrow);
+        if (h < 0 || l < 0)
+            return false;
+        _out[i] = byte((h << 4) | l);
+    }
+    return true;
+}
+
+bytes sample(size_t _size)
+{
+    bytes ret(_size);
+    for (size_t i = 0; i < _size; i++)
+        ret[i] = byte(i * 37 + 11);
+    return ret;
+}
+}  // namespace
+
+static void diff_to_target_legacy(benchmark::State& state)
+{
+    size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(legacyTargetFromDiff(c_diffs[i++ % c_diffsCount]));
+}
+BENCHMARK(diff_to_target_legacy);
+
+static void diff_to_target_string(benchmark::State& state)
+{
+    size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(getTargetFromDiff(c_diffs[i++ % c_diffsCount]));
+}
+BENCHMARK(diff_to_target_string);
+
+static void diff_to_target(benchmark::State& state)
+{
+    size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(diffToTarget(c_diffs[i++ % c_diffsCount]));
+}
+BENCHMARK(diff_to_target);
+
+static void target_to_diff_legacy(benchmark::State& state)
+{
+    std::vector<std::string> targets;
+    for (double diff : c_diffs)
+        targets.push_back(getTargetFromDiff(diff));
+    size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(legacyDiffFromTarget(targets[i++ % c_diffsCount]));
+}
+BENCHMARK(target_to_diff_legacy);
+
+static void target_to_diff_string(benchmark::State& state)
+{
+    std::vector<std::string> targets;
+    for (double diff : c_diffs)
+        targets.push_back(getTargetFromDiff(diff));
+    size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(getDiffFromTarget(targets[i++ % c_diffsCount]));
+}
+BENCHMARK(target_to_diff_string);
+
+static void target_to_diff(benchmark::State& state)
+{
+    std::vector<h256> targets;
+    for (double diff : c_diffs)
+        targets.push_back(diffToTarget(diff));
+    size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(targetToDiff(targets[i++ % c_diffsCount]));
+}
+BENCHMARK(target_to_diff);
+
+static void hex_encode_legacy(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    bytes data = sample(size);
+    std::string out(size * 2, '\0');
+    for (auto _ : state)
+    {
+        legacyHexEncode(data.data(), size, &out[0]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK(hex_encode_legacy)->Arg(32)->Arg(1024);
+
+static void hex_encode(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    bytes data = sample(size);
+    std::string out(size * 2, '\0');
+    for (auto _ : state)
+    {
+        hexEncode(data.data(), size, &out[0]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK(hex_encode)->Arg(32)->Arg(1024);
+
+static void hex_decode_legacy(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::string hex = toHex(sample(size));
+    bytes out(size);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(legacyHexDecode(hex.data(), size, out.data()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK(hex_decode_legacy)->Arg(32)->Arg(1024);
+
+static void hex_decode(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    std::string hex = toHex(sample(size));
+    bytes out(size);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(hexDecode(hex.data(), size, out.data()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK(hex_decode)->Arg(32)->Arg(1024);
@@ -0,0 +1,125 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libdevcore/LineBuffer.h>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/algorithm/string/trim.hpp>
+
+#include <algorithm>
+#include <string>
+
+using namespace dev;
+
+namespace
+{
+// Messages of an EthereumStratum/1.0.0 session as sent by a pool : jobs,
+// difficulty changes and share responses, a few with CRLF endings
+char const* const c_session[] = {
+    "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"bf0488aa\",\"6526d5\","
+    "\"645cf20198c2f3861e947d4f67e3ab63b7b2e24dcc9095bd9123e7b33371f6cc\",true]}\n",
+    "{\"id\":4,\"jsonrpc\":\"2.0\",\"result\":true}\n",
+    "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[0.9999999999999999]}\r\n",
+    "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"bf0488ab\",\"6526d5\","
+    "\"2a1c5e0e8d5b4a54a4bb2c19e8f5c1f9b7a1ec3f0d54a3c43e3f4bb2f7d2d101\",false]}\n",
+    "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"bf0488ac\",\"6526d5\","
+    "\"4c6f0ab08e69c1d2e8a0bd3f4fa2b4d8e1c7f0a9b2d3e4f5a6b7c8d9e0f1a2b3\",false]}\n",
+    "{\"id\":5,\"jsonrpc\":\"2.0\",\"result\":false,\"error\":[21,\"Stale share\",null]}\r\n",
+    "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"bf0488ad\",\"6526d6\","
+    "\"9e2b8d1f3a4c5e6f708192a3b4c5d6e7f8091a2b3c4d5e6f708192a3b4c5d6e7\",true]}\n",
+    "{\"id\":6,\"jsonrpc\":\"2.0\",\"result\":true}\n",
+};
+
+// About 256 KiB of the session
+std::string traffic()
+{
+    std::string ret;
+    while (ret.size() < 256 * 1024)
+        for (char const* message : c_session)
+            ret.append(message);
+    return ret;
+}
+
+// Former receive path of the stratum client : each read is appended to
+// a string and every line is copied out and erased from its front
+size_t legacySplit(std::string& _message, char const* _data, size_t _size)
+{
+    size_t count = 0;
+    std::string rx_message(_data, _size);
+    _message.append(rx_message);
+    std::string line;
+    size_t offset = _message.find("\n");
+    while (offset != std::string::npos)
+    {
+        if (offset > 0)
+        {
+            line = _message.substr(0, offset);
+            boost::trim(line);
+            if (!line.empty())
+                count++;
+        }
+        _message.erase(0, offset + 1);
+        offset = _message.find("\n");
+    }
+    return count;
+}
+}  // namespace
+
+static void linebuffer_legacy(benchmark::State& state)
+{
+    const auto read_size = static_cast<size_t>(state.range(0));
+    const std::string data = traffic();
+
+    for (auto _ : state)
+    {
+        std::string message;
+        size_t count = 0;
+        for (size_t i = 0; i < data.size(); i += read_size)
+            count += legacySplit(message, data.data() + i, std::min(read_size, data.size() - i));
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(linebuffer_legacy)->Arg(512)->Arg(1460)->Arg(16384);
+
+static void linebuffer(benchmark::State& state)
+{
+    const auto read_size = static_cast<size_t>(state.range(0));
+    const std::string data = traffic();
+    LineBuffer buffer(32 * 1024);
+
+    for (auto _ : state)
+    {
+        buffer.clear();
+        size_t count = 0;
+        vector_ref<char const> line;
+        for (size_t i = 0; i < data.size();)
+        {
+            size_t size = std::min(std::min(read_size, data.size() - i), buffer.space());
+            std::memcpy(buffer.tail(), data.data() + i, size);
+            buffer.commit(size);
+            i += size;
+            while (buffer.nextLine(line))
+                count++;
+            buffer.compact();
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(linebuffer)->Arg(512)->Arg(1460)->Arg(16384);
@@ -0,0 +1,166 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libdevcore/CommonData.h>
+#include <libdevcore/Exceptions.h>
+#include <libdevcore/FixedHash.h>
+
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <cstdio>
+#include <string>
+
+using namespace dev;
+
+namespace
+{
+// Lengths around the 16 bytes handled at once
+const size_t c_maxSize = 67;
+
+bytes sample(size_t _size)
+{
+    bytes ret(_size);
+    for (size_t i = 0; i < _size; i++)
+        ret[i] = byte(i * 37 + 11);
+    return ret;
+}
+
+std::string referenceHex(bytes const& _data)
+{
+    std::string ret;
+    char pair[3];
+    for (byte b : _data)
+    {
+        std::snprintf(pair, sizeof(pair), "%02x", b);
+        ret += pair;
+    }
+    return ret;
+}
+}  // namespace
+
+TEST(hex, encode_every_byte)
+{
+    bytes all(256);
+    for (unsigned i = 0; i < 256; i++)
+        all[i] = byte(i);
+    std::string out(512, '\0');
+    EXPECT_EQ(hexEncode(all.data(), all.size(), &out[0]), &out[0] + 512);
+    EXPECT_EQ(out, referenceHex(all));
+    EXPECT_EQ(toHex(all), out);
+}
+
+TEST(hex, encode_lengths)
+{
+    for (size_t size = 0; size <= c_maxSize; size++)
+    {
+        SCOPED_TRACE(size);
+        bytes data = sample(size);
+        std::string out(size * 2 + 1, '#');
+        EXPECT_EQ(hexEncode(data.data(), size, &out[0]), &out[0] + size * 2);
+        EXPECT_EQ(out, referenceHex(data) + "#");
+    }
+}
+
+TEST(hex, decode_both_cases)
+{
+    for (size_t size = 0; size <= c_maxSize; size++)
+    {
+        SCOPED_TRACE(size);
+        bytes data = sample(size);
+        std::string lower = referenceHex(data);
+        std::string upper = lower;
+        std::string mixed = lower;
+        for (size_t i = 0; i < upper.size(); i++)
+        {
+            upper[i] = char(std::toupper(upper[i]));
+            if (i % 3 == 0)
+                mixed[i] = upper[i];
+        }
+        for (std::string const& hex : {lower, upper, mixed})
+        {
+            bytes out(size + 1, 0x5a);
+            EXPECT_TRUE(hexDecode(hex.data(), size, out.data()));
+            EXPECT_EQ(bytes(out.begin(), out.begin() + size), data);
+            EXPECT_EQ(out[size], 0x5a);
+            if (size)
+            {
+                EXPECT_EQ(fromHex(hex), data);
+            }
+        }
+    }
+    EXPECT_EQ(fromHex("0xDeadBEEF"), bytes({0xde, 0xad, 0xbe, 0xef}));
+}
+
+TEST(hex, decode_invalid_characters)
+{
+    // Characters next to the digit and letter ranges
+    const char invalid[] = {'/', ':', '@', 'G', '`', 'g', ' ', 'h', '\0', char(0x80), char(0xb0), char(0xe1)};
+
+    const size_t size = 40;
+    std::string hex = referenceHex(sample(size));
+    bytes out(size);
+    for (size_t pos = 0; pos < hex.size(); pos++)
+    {
+        for (char c : invalid)
+        {
+            std::string bad = hex;
+            bad[pos] = c;
+            SCOPED_TRACE(pos);
+            SCOPED_TRACE(int(c));
+            EXPECT_FALSE(hexDecode(bad.data(), size, out.data()));
+            EXPECT_TRUE(fromHex(bad).empty());
+            EXPECT_THROW(fromHex(bad, WhenError::Throw), BadHexCharacter);
+        }
+    }
+}
+
+TEST(hex, decode_odd_length)
+{
+    EXPECT_EQ(fromHex("abc"), bytes({0x0a, 0xbc}));
+    EXPECT_EQ(fromHex("0xabc"), bytes({0x0a, 0xbc}));
+    EXPECT_EQ(fromHex("F"), bytes({0x0f}));
+    EXPECT_TRUE(fromHex("gbc").empty());
+    EXPECT_THROW(fromHex("gbc", WhenError::Throw), BadHexCharacter);
+    EXPECT_TRUE(fromHex("abg").empty());
+
+    std::string odd = "7" + referenceHex(sample(32));
+    bytes expected = sample(32);
+    expected.insert(expected.begin(), 0x07);
+    EXPECT_EQ(fromHex(odd), expected);
+}
+
+TEST(hex, hash_from_hex)
+{
+    h256 h;
+    ASSERT_TRUE(hexToHash("0x1", 3, h));
+    EXPECT_EQ(h, h256(1));
+    ASSERT_TRUE(hexToHash("ABC", 3, h));
+    EXPECT_EQ(h, h256(0xabc));
+
+    std::string full = referenceHex(sample(32));
+    ASSERT_TRUE(hexToHash(full.data(), full.size(), h));
+    EXPECT_EQ(h.hex(), full);
+    EXPECT_EQ(h256(full), h);
+
+    EXPECT_FALSE(hexToHash("", 0, h));
+    EXPECT_FALSE(hexToHash("0x", 2, h));
+    EXPECT_FALSE(hexToHash("0xg", 3, h));
+    EXPECT_FALSE(hexToHash("12z4", 4, h));
+    std::string tooLong = "1" + full;
+    EXPECT_FALSE(hexToHash(tooLong.data(), tooLong.size(), h));
+}
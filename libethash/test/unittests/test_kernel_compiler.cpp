@@ -0,0 +1,96 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libethcore/KernelCompiler.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace dev::eth;
+
+namespace
+{
+// Keeps the single worker busy so that tasks enqueued meanwhile stay queued
+class Blocker
+{
+public:
+    explicit Blocker(std::string const& _key)
+    {
+        KernelCompiler& kc = KernelCompiler::get();
+        kc.configure(1, 0);
+        std::promise<void> started;
+        auto running = started.get_future();
+        std::shared_future<void> release = m_release.get_future().share();
+        kc.enqueue(_key, 0, this,
+            [&started, release]() {
+                started.set_value();
+                release.wait();
+            },
+            []() {});
+        running.wait();
+    }
+
+    void release() { m_release.set_value(); }
+
+private:
+    std::promise<void> m_release;
+};
+}  // namespace
+
+TEST(kernel_compiler, cancel_hands_task_to_waiter)
+{
+    KernelCompiler& kc = KernelCompiler::get();
+    Blocker blocker("blocker-handover");
+
+    int a = 0, b = 0;
+    std::atomic<bool> aCompiled{false}, bCompiled{false}, bDone{false};
+    EXPECT_TRUE(kc.enqueue("key-handover", 7, &a, [&]() { aCompiled = true; }, []() {}));
+    EXPECT_FALSE(kc.enqueue("key-handover", 7, &b, [&]() { bCompiled = true; }, [&]() { bDone = true; }));
+
+    std::thread waiter([&]() { kc.wait("key-handover", 7); });
+    kc.cancel(&a);
+    blocker.release();
+    waiter.join();
+
+    EXPECT_FALSE(aCompiled);
+    EXPECT_TRUE(bCompiled);
+    EXPECT_TRUE(bDone);
+    kc.cancel(&b);
+}
+
+TEST(kernel_compiler, cancel_drops_own_task)
+{
+    KernelCompiler& kc = KernelCompiler::get();
+    Blocker blocker("blocker-drop");
+
+    int a = 0;
+    std::atomic<bool> aCompiled{false}, aDone{false};
+    EXPECT_TRUE(kc.enqueue("key-drop", 7, &a, [&]() { aCompiled = true; }, [&]() { aDone = true; }));
+    EXPECT_EQ(kc.stats().pending, 2u);
+
+    kc.cancel(&a);
+    EXPECT_EQ(kc.stats().pending, 1u);
+    blocker.release();
+    kc.wait("blocker-drop", 0);
+
+    EXPECT_FALSE(aCompiled);
+    EXPECT_FALSE(aDone);
+}
@@ -0,0 +1,124 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libdevcore/LineBuffer.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace dev;
+
+namespace
+{
+// Copies _data into the buffer as a socket read would
+void receive(LineBuffer& _buffer, std::string const& _data)
+{
+    ASSERT_LE(_data.size(), _buffer.space());
+    std::memcpy(_buffer.tail(), _data.data(), _data.size());
+    _buffer.commit(_data.size());
+}
+
+// Drains the complete lines then compacts as the stratum client does
+std::vector<std::string> lines(LineBuffer& _buffer)
+{
+    std::vector<std::string> ret;
+    vector_ref<char const> line;
+    while (_buffer.nextLine(line))
+        ret.push_back(line.toString());
+    _buffer.compact();
+    return ret;
+}
+}  // namespace
+
+TEST(line_buffer, line_split_across_reads)
+{
+    LineBuffer buffer(64);
+    receive(buffer, "{\"id\":1,");
+    EXPECT_TRUE(lines(buffer).empty());
+    EXPECT_EQ(buffer.pending(), 8u);
+
+    receive(buffer, "\"result\":");
+    EXPECT_TRUE(lines(buffer).empty());
+
+    receive(buffer, "true}\n{\"id\"");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":1,\"result\":true}"}));
+    EXPECT_EQ(buffer.pending(), 5u);
+
+    receive(buffer, ":2}\n");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":2}"}));
+    EXPECT_EQ(buffer.pending(), 0u);
+    EXPECT_EQ(buffer.space(), 64u);
+}
+
+TEST(line_buffer, crlf_and_blank_lines)
+{
+    LineBuffer buffer(64);
+    receive(buffer, "\r\n\n  \t\r\n{\"id\":1}\r\n\r\n \"a b\" \r\n");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":1}", "\"a b\""}));
+    EXPECT_EQ(buffer.pending(), 0u);
+
+    // Delimiter split from its carriage return
+    receive(buffer, "{\"id\":2}\r");
+    EXPECT_TRUE(lines(buffer).empty());
+    receive(buffer, "\n");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":2}"}));
+}
+
+TEST(line_buffer, several_lines_in_one_read)
+{
+    LineBuffer buffer(128);
+    receive(buffer, "{\"id\":1}\n{\"id\":2}\n{\"id\":3}\n{\"id\"");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":1}", "{\"id\":2}", "{\"id\":3}"}));
+
+    // Incomplete line moved to the front
+    EXPECT_EQ(buffer.pending(), 5u);
+    EXPECT_EQ(buffer.space(), 128u - 5u);
+    EXPECT_EQ(std::string(buffer.tail() - 5, 5), "{\"id\"");
+
+    receive(buffer, ":4}\n");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":4}"}));
+}
+
+TEST(line_buffer, line_filling_the_buffer)
+{
+    LineBuffer buffer(16);
+    receive(buffer, "{\"id\":1}\n0123");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":1}"}));
+
+    // A line as long as the buffer leaves no room : the caller drops it
+    receive(buffer, std::string(12, 'x'));
+    EXPECT_TRUE(lines(buffer).empty());
+    EXPECT_EQ(buffer.space(), 0u);
+    EXPECT_EQ(buffer.pending(), 16u);
+
+    buffer.clear();
+    EXPECT_EQ(buffer.space(), 16u);
+    EXPECT_EQ(buffer.pending(), 0u);
+    receive(buffer, "{\"id\":2}\n");
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":2}"}));
+}
+
+TEST(line_buffer, exact_fit)
+{
+    LineBuffer buffer(9);
+    receive(buffer, "{\"id\":1}\n");
+    EXPECT_EQ(buffer.space(), 0u);
+    EXPECT_EQ(lines(buffer), std::vector<std::string>({"{\"id\":1}"}));
+    EXPECT_EQ(buffer.space(), 9u);
+}
@@ -0,0 +1,218 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libpoolprotocols/StratumParser.h>
+
+#include <json/json.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace dev;
+
+namespace
+{
+bool fastParse(std::string const& _line, StratumMessage& _msg)
+{
+    return parseStratumMessage(_line.data(), _line.data() + _line.size(), _msg);
+}
+
+bool jsonParse(std::string const& _line, Json::Value& _json)
+{
+    Json::Reader reader;
+    return reader.parse(_line, _json);
+}
+
+void expectScalar(JsonScalar _type, JsonRef _ref, Json::Value const& _json)
+{
+    switch (_type)
+    {
+    case JsonScalar::Null:
+        EXPECT_TRUE(_json.isNull());
+        break;
+    case JsonScalar::False:
+        EXPECT_TRUE(_json.isBool() && !_json.asBool());
+        break;
+    case JsonScalar::True:
+        EXPECT_TRUE(_json.isBool() && _json.asBool());
+        break;
+    case JsonScalar::Number:
+        ASSERT_TRUE(_json.isNumeric());
+        EXPECT_DOUBLE_EQ(std::stod(_ref.toString()), _json.asDouble());
+        break;
+    case JsonScalar::String:
+        ASSERT_TRUE(_json.isString());
+        EXPECT_EQ(_ref.toString(), _json.asString());
+        break;
+    default:
+        ADD_FAILURE() << "Unexpected scalar type";
+    }
+}
+
+// The fast path takes _line and reads from it what jsoncpp does
+void expectSameAsJsoncpp(std::string const& _line)
+{
+    SCOPED_TRACE(_line);
+    StratumMessage msg;
+    Json::Value json;
+    ASSERT_TRUE(fastParse(_line, msg));
+    ASSERT_TRUE(jsonParse(_line, json));
+
+    if (msg.idType == JsonScalar::None)
+        EXPECT_FALSE(json.isMember("id"));
+    else if (msg.idType == JsonScalar::Null)
+        EXPECT_TRUE(json["id"].isNull());
+    else
+        EXPECT_EQ(msg.id, json["id"].asUInt());
+
+    EXPECT_EQ(msg.rpc2, json.isMember("jsonrpc"));
+    if (json["jsonrpc"].isString())
+        EXPECT_EQ(msg.jsonrpc.toString(), json["jsonrpc"].asString());
+    else
+        EXPECT_EQ(msg.jsonrpc.size(), 0u);
+
+    EXPECT_EQ(msg.method.toString(), json.get("method", "").asString());
+
+    if (msg.result == JsonScalar::None)
+        EXPECT_FALSE(json.isMember("result"));
+    else if (msg.result == JsonScalar::Array)
+        EXPECT_TRUE(json["result"].isArray());
+    else
+        expectScalar(msg.result, JsonRef(), json["result"]);
+
+    Json::Value const& params = msg.paramsFromResult ? json["result"] : json["params"];
+    EXPECT_EQ(msg.paramsObject, params.isObject());
+    ASSERT_EQ(msg.paramsCount, params.size());
+    for (unsigned i = 0; i < msg.paramsCount; i++)
+        expectScalar(msg.types[i], msg.params[i], msg.paramsObject ? params[msg.keys[i].toString()] : params[i]);
+}
+
+// The fast path leaves _line to jsoncpp which parses it
+void expectLeftToJsoncpp(std::string const& _line)
+{
+    SCOPED_TRACE(_line);
+    StratumMessage msg;
+    Json::Value json;
+    EXPECT_FALSE(fastParse(_line, msg));
+    EXPECT_TRUE(jsonParse(_line, json));
+}
+}  // namespace
+
+TEST(stratum_parser, flat_messages)
+{
+    expectSameAsJsoncpp(
+        "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"bf0488aa\",\"6526d5\","
+        "\"645cf20198c2f3861e947d4f67e3ab63b7b2e24dcc9095bd9123e7b33371f6cc\",true]}");
+    expectSameAsJsoncpp("{\"id\":4,\"jsonrpc\":\"2.0\",\"result\":true,\"error\":null}");
+    expectSameAsJsoncpp("{ \"id\" : 7 , \"result\" : [ \"0x1\" , 2.5e3 , -1 , null , false ] }");
+    expectSameAsJsoncpp("{\"method\":\"mining.set\",\"params\":{\"epoch\":\"0x1a\",\"target\":\"0x00ff\"}}");
+    expectSameAsJsoncpp("{\"id\":4294967295,\"params\":[]}");
+    expectSameAsJsoncpp("{}");
+}
+
+TEST(stratum_parser, nested_values)
+{
+    expectLeftToJsoncpp("{\"id\":1,\"params\":[[\"a\"],1]}");
+    expectLeftToJsoncpp("{\"id\":1,\"params\":{\"a\":{\"b\":1}}}");
+    expectLeftToJsoncpp("{\"id\":1,\"result\":[{\"a\":1}]}");
+    expectLeftToJsoncpp("{\"id\":1,\"result\":{\"a\":1}}");
+    expectLeftToJsoncpp("{\"id\":1,\"extra\":[1,2],\"result\":true}");
+    expectLeftToJsoncpp("{\"id\":1,\"result\":null,\"error\":[21,\"Stale share\",null]}");
+}
+
+TEST(stratum_parser, escapes_and_unicode)
+{
+    expectLeftToJsoncpp("{\"id\":1,\"method\":\"mining.\\\"notify\",\"params\":[]}");
+    expectLeftToJsoncpp("{\"id\":1,\"params\":[\"a\\nb\"]}");
+    expectLeftToJsoncpp("{\"id\":1,\"params\":[\"caf\\u00e9\"]}");
+    expectLeftToJsoncpp("{\"id\":1,\"params\":{\"k\\\\\":\"v\"}}");
+
+    // Raw UTF-8 needs no unescaping
+    expectSameAsJsoncpp("{\"id\":1,\"method\":\"client.show_message\",\"params\":[\"caf\xc3\xa9 \xe2\x82\xac\"]}");
+}
+
+TEST(stratum_parser, non_string_jsonrpc)
+{
+    expectSameAsJsoncpp("{\"id\":1,\"jsonrpc\":2.0,\"result\":true}");
+    expectSameAsJsoncpp("{\"id\":1,\"jsonrpc\":null,\"result\":true}");
+    expectSameAsJsoncpp("{\"id\":1,\"jsonrpc\":true,\"result\":true}");
+
+    StratumMessage msg;
+    ASSERT_TRUE(fastParse("{\"id\":1,\"jsonrpc\":2.0,\"result\":true}", msg));
+    EXPECT_TRUE(msg.rpc2);
+    EXPECT_FALSE(StratumMessage::equals(msg.jsonrpc, "2.0"));
+
+    expectLeftToJsoncpp("{\"id\":1,\"jsonrpc\":[\"2.0\"],\"result\":true}");
+}
+
+TEST(stratum_parser, too_many_params)
+{
+    std::string params;
+    for (unsigned i = 0; i < StratumMessage::c_maxParams; i++)
+        params += (i ? ",\"" : "\"") + std::to_string(i) + "\"";
+    expectSameAsJsoncpp("{\"id\":1,\"params\":[" + params + "]}");
+    expectSameAsJsoncpp("{\"id\":1,\"result\":[" + params + "]}");
+
+    params += ",\"" + std::to_string(StratumMessage::c_maxParams) + "\"";
+    expectLeftToJsoncpp("{\"id\":1,\"params\":[" + params + "]}");
+    expectLeftToJsoncpp("{\"id\":1,\"result\":[" + params + "]}");
+}
+
+TEST(stratum_parser, ids)
+{
+    expectSameAsJsoncpp("{\"id\":null,\"result\":true}");
+    expectSameAsJsoncpp("{\"id\":0,\"result\":true}");
+    expectSameAsJsoncpp("{\"result\":true}");
+
+    StratumMessage msg;
+    ASSERT_TRUE(fastParse("{\"id\":null,\"result\":true}", msg));
+    EXPECT_EQ(msg.idType, JsonScalar::Null);
+
+    // Ids the fast path can't map to a request
+    expectLeftToJsoncpp("{\"id\":\"1\",\"result\":true}");
+    expectLeftToJsoncpp("{\"id\":\"\",\"result\":true}");
+    expectLeftToJsoncpp("{\"id\":-1,\"result\":true}");
+    expectLeftToJsoncpp("{\"id\":1.5,\"result\":true}");
+    expectLeftToJsoncpp("{\"id\":4294967296,\"result\":true}");
+    expectLeftToJsoncpp("{\"id\":true,\"result\":true}");
+}
+
+TEST(stratum_parser, truncated_input)
+{
+    const std::string line =
+        "{\"id\":3,\"jsonrpc\":\"2.0\",\"method\":\"mining.notify\",\"params\":[\"0x1\",12,null,true]}";
+    expectSameAsJsoncpp(line);
+
+    for (size_t len = 0; len < line.size(); len++)
+    {
+        std::string truncated = line.substr(0, len);
+        SCOPED_TRACE(truncated);
+        StratumMessage msg;
+        Json::Value json;
+        EXPECT_FALSE(fastParse(truncated, msg));
+        EXPECT_FALSE(jsonParse(truncated, json));
+    }
+}
+
+TEST(stratum_parser, trailing_data)
+{
+    StratumMessage msg;
+    EXPECT_FALSE(fastParse("{\"id\":1,\"result\":true}}", msg));
+    EXPECT_FALSE(fastParse("{\"id\":1,\"result\":true} x", msg));
+    EXPECT_TRUE(fastParse("{\"id\":1,\"result\":true} \r\n", msg));
+}
@@ -0,0 +1,176 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libdevcore/CommonData.h>
+#include <libdevcore/Target.h>
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+
+using namespace dev;
+using boost::multiprecision::cpp_int;
+
+namespace
+{
+const h256 c_zero;
+const h256 c_highest("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+const h256 c_diff1("00000000ffff0000000000000000000000000000000000000000000000000000");
+
+h256 toHash(cpp_int const& _v)
+{
+    h256 h;
+    for (unsigned i = 0; i < 32; i++)
+        h[31 - i] = byte(static_cast<unsigned>((_v >> (i * 8)) & 0xff));
+    return h;
+}
+
+// floor(0xffff * 2^208 / _diff) with arbitrary precision, saturated to 2^256 - 1
+h256 referenceTarget(double _diff)
+{
+    int e;
+    double f = std::frexp(_diff, &e);
+    cpp_int m = cpp_int(std::ldexp(f, 53));
+    e -= 53;
+
+    cpp_int n = cpp_int(0xffff) << 208;
+    cpp_int q = e >= 0 ? cpp_int(n / (m << e)) : cpp_int((n << -e) / m);
+    if (q >> 256)
+        return c_highest;
+    return toHash(q);
+}
+}  // namespace
+
+TEST(target, diff_zero_and_below)
+{
+    EXPECT_EQ(diffToTarget(0.0), c_highest);
+    EXPECT_EQ(diffToTarget(-0.0), c_highest);
+    EXPECT_EQ(diffToTarget(-1.0), c_highest);
+    EXPECT_EQ(diffToTarget(-std::numeric_limits<double>::infinity()), c_highest);
+    EXPECT_EQ(diffToTarget(std::numeric_limits<double>::quiet_NaN()), c_highest);
+    EXPECT_EQ(targetToDiff(c_zero), 0.0);
+    EXPECT_EQ(targetToHashes(c_zero), 0.0);
+}
+
+TEST(target, diff_inf)
+{
+    EXPECT_EQ(diffToTarget(std::numeric_limits<double>::infinity()), c_zero);
+}
+
+TEST(target, diff_one)
+{
+    EXPECT_EQ(diffToTarget(1.0), c_diff1);
+    EXPECT_EQ(targetToDiff(c_diff1), 1.0);
+    EXPECT_EQ(targetToHashes(c_diff1), 4294967296.0);
+    EXPECT_EQ(getTargetFromDiff(1.0), "0x" + c_diff1.hex());
+    EXPECT_EQ(getDiffFromTarget("0x" + c_diff1.hex()), 1.0);
+}
+
+TEST(target, very_large_diffs)
+{
+    // Target 1 is the highest difficulty. Above, targets round down to 0
+    const double top = std::ldexp(65535.0, 208);
+    EXPECT_EQ(diffToTarget(top), h256(1));
+    EXPECT_EQ(targetToDiff(h256(1)), top);
+    EXPECT_EQ(diffToTarget(top * 2), c_zero);
+    EXPECT_EQ(diffToTarget(std::nextafter(top, 0.0)), h256(1));
+    EXPECT_EQ(diffToTarget(1e300), c_zero);
+    EXPECT_EQ(diffToTarget(std::numeric_limits<double>::max()), c_zero);
+
+    for (double diff : {1e9, 4.5e9, 1.2345678e12, 1e18, 3e40})
+    {
+        SCOPED_TRACE(diff);
+        EXPECT_EQ(diffToTarget(diff), referenceTarget(diff));
+    }
+}
+
+TEST(target, very_tiny_diffs)
+{
+    // Targets of difficulties below 0xffff * 2^-48 don't fit and saturate
+    const double bottom = std::ldexp(1.0, -32);
+    EXPECT_EQ(diffToTarget(bottom), h256("ffff000000000000000000000000000000000000000000000000000000000000"));
+    EXPECT_EQ(targetToDiff(diffToTarget(bottom)), bottom);
+    EXPECT_EQ(diffToTarget(std::ldexp(1.0, -33)), c_highest);
+    EXPECT_EQ(diffToTarget(std::numeric_limits<double>::denorm_min()), c_highest);
+    EXPECT_EQ(diffToTarget(std::numeric_limits<double>::min()), c_highest);
+
+    double lowest = targetToDiff(c_highest);
+    EXPECT_LT(lowest, bottom);
+    EXPECT_GT(lowest, bottom * (1 - 1e-4));
+
+    for (double diff : {std::nextafter(bottom, 0.0), lowest, std::nextafter(lowest, 0.0), 2.4e-10, 1e-9, 0.001,
+             0.1, 0.3})
+    {
+        SCOPED_TRACE(diff);
+        EXPECT_EQ(diffToTarget(diff), referenceTarget(diff));
+    }
+}
+
+TEST(target, floor_of_quotient)
+{
+    for (double diff : {3.0, 7.0, 0.75, 1.1, 2.5, 12.345, 1000.5, 4294967297.0, 65535.0, 65537.0})
+    {
+        SCOPED_TRACE(diff);
+        EXPECT_EQ(diffToTarget(diff), referenceTarget(diff));
+    }
+    EXPECT_EQ(diffToTarget(2.0), h256("000000007fff8000000000000000000000000000000000000000000000000000"));
+    EXPECT_EQ(diffToTarget(3.0), h256("0000000055550000000000000000000000000000000000000000000000000000"));
+}
+
+TEST(target, difficulty_rounding)
+{
+    // Target of diff 3 is exact. Nudging it by one changes nothing
+    // a double can hold
+    h256 t = diffToTarget(3.0);
+    EXPECT_EQ(targetToDiff(t), 3.0);
+    h256 up = toHash((cpp_int(0x5555) << 208) + 1);
+    EXPECT_EQ(targetToDiff(up), 3.0);
+
+    // 0xffff * 2^208 / 3 is 0x5555 * 2^208 : 1 / 3 of the target of diff 1
+    EXPECT_EQ(targetToDiff(toHash(cpp_int(0xffff) * 3 << 208)), 1.0 / 3.0);
+
+    // Quotients are correctly rounded
+    const double top = std::ldexp(65535.0, 208);
+    EXPECT_EQ(targetToDiff(h256(3)), top / 3);
+}
+
+TEST(target, round_trips)
+{
+    for (double diff = 1e-9; diff < 1e15; diff *= 1.37)
+    {
+        SCOPED_TRACE(diff);
+        double back = targetToDiff(diffToTarget(diff));
+        EXPECT_LE(std::fabs(back - diff), diff * 1e-12);
+    }
+
+    // Power of 2 difficulties have exact targets
+    for (int e = -32; e <= 208; e += 5)
+    {
+        SCOPED_TRACE(e);
+        h256 t = diffToTarget(std::ldexp(1.0, e));
+        EXPECT_EQ(t, toHash(cpp_int(0xffff) << (208 - e)));
+        EXPECT_EQ(targetToDiff(t), std::ldexp(1.0, e));
+        EXPECT_EQ(diffToTarget(targetToDiff(t)), t);
+    }
+
+    // Hex string wrappers
+    EXPECT_EQ(getDiffFromTarget(getTargetFromDiff(4.5)), 4.5);
+    EXPECT_EQ(getHashesToTarget(getTargetFromDiff(1.0)), 4294967296.0);
+}
@@ -71,8 +71,12 @@ struct WorkPackage
     int period = -1;  // ProgPoW period
 
     uint64_t startNonce = 0;
+    uint64_t segmentLength = 0;  // Nonces assigned to the miner from startNonce (0 = unbounded)
     uint16_t exSizeBytes = 0;
 
+    bool cleanJobs = false;   // Pool asks to discard previous jobs
+    uint64_t generation = 0;  // Stamped by the farm on each new job (monotonic)
+
     //std::string algo = "ethash";
 };
 
@@ -85,5 +89,16 @@ struct Solution
     unsigned midx;                                 // Originating miner Id
 };
 
+// Compact form of a solution queued by miners to the farm
+// which resolves the job from its generation
+struct SolutionRecord
+{
+    uint64_t nonce;                                // Solution found nonce
+    h256 mixHash;                                  // Mix hash
+    uint64_t generation;                           // Generation of the job this solution refers to
+    unsigned midx;                                 // Originating miner Id
+    std::chrono::steady_clock::time_point tstamp;  // Timestamp of found solution
+};
+
 }  // namespace eth
 }  // namespace dev
@@ -15,8 +15,16 @@
  along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
 
+#include <libdevcore/Target.h>
 #include <libethcore/Farm.h>
+#include <libethcore/KernelCompiler.h>
 
 #if _OPENCL
 #include <libethash-cl/CLMiner.h>
@@ -30,29 +38,76 @@
 #include <libethash-cpu/CPUMiner.h>
 #endif
 
+#if _SIM
+#include <libethash-sim/SimMiner.h>
+#endif
+
 namespace dev
 {
 namespace eth
 {
 Farm* Farm::m_this = nullptr;
 
+// Expected hashes to find a share of difficulty 1 (targetToHashes / targetToDiff)
+static const double c_hashesPerDifficulty = 4294967296.0;
+
+static_assert(std::is_trivially_destructible<SolutionCounters>::value, "SolutionCounters are freed without dtor");
+
+// Allocates _count zeroed counters, each on its own cache line
+static SolutionCounters* allocSolutionCounters(unsigned _count)
+{
+    void* p = nullptr;
+#if defined(_WIN32)
+    p = _aligned_malloc(sizeof(SolutionCounters) * _count, alignof(SolutionCounters));
+#else
+    if (posix_memalign(&p, alignof(SolutionCounters), sizeof(SolutionCounters) * _count))
+        p = nullptr;
+#endif
+    if (!p)
+        throw std::bad_alloc();
+    SolutionCounters* counters = static_cast<SolutionCounters*>(p);
+    for (unsigned i = 0; i < _count; i++)
+        new (&counters[i]) SolutionCounters();
+    return counters;
+}
+
+void SolutionCountersDeleter::operator()(SolutionCounters* _p) const
+{
+#if defined(_WIN32)
+    _aligned_free(_p);
+#else
+    free(_p);
+#endif
+}
+
 Farm::Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection, FarmSettings _settings, CUSettings _CUSettings,
-    CLSettings _CLSettings, CPSettings _CPSettings)
-  : m_Settings(std::move(_settings)),
+    CLSettings _CLSettings, CPSettings _CPSettings, SMSettings _SMSettings)
+  : m_solutions(1024),
+    m_Settings(std::move(_settings)),
     m_CUSettings(std::move(_CUSettings)),
     m_CLSettings(std::move(_CLSettings)),
     m_CPSettings(std::move(_CPSettings)),
+    m_SMSettings(std::move(_SMSettings)),
     m_io_strand(g_io_service),
     m_collectTimer(g_io_service),
     m_DevicesCollection(_DevicesCollection)
 {
     m_this = this;
 
+    // Publish an empty snapshot so readers never get a null one
+    m_telemetryStart = std::chrono::steady_clock::now();
+    {
+        std::shared_ptr<TelemetryType> t(new TelemetryType);
+        t->start = m_telemetryStart;
+        t->hwmon = (m_Settings.hwMon != 0);
+        std::atomic_store(&m_telemetry, std::shared_ptr<const TelemetryType>(t));
+    }
+
+    KernelCompiler::get().configure(m_Settings.compileThreads, m_Settings.compileLookahead);
+
     // Init HWMON if needed
     if (m_Settings.hwMon)
     {
-        m_telemetry.hwmon = true;
-
 #if defined(__linux)
         bool need_sysfsh = false;
 #else
@@ -164,9 +219,16 @@ Farm::Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection, FarmSett
 
 Farm::~Farm()
 {
+    // Wait for the epoch context in progress (if any)
+    if (m_epochThread.joinable())
+        m_epochThread.join();
+
     // Stop data collector (before monitors !!!)
     m_collectTimer.cancel();
 
+    // Drop any pending kernel compilation
+    KernelCompiler::get().stop();
+
     // Deinit HWMON
 #if defined(__linux)
     if (sysfsh)
@@ -183,14 +245,68 @@ Farm::~Farm()
 
 void Farm::setWork(WorkPackage const& _newWp)
 {
-    // Set work to each miner giving it's own starting nonce
+    // Prevent dispatch of a ProgPoW workpackage which has block number missing
+    if (_newWp.block < 0)
+    {
+        cwarn << EthRed "Got ProgPoW job with missing block number. Discarding ..." EthReset;
+        return;
+    }
+
     Guard l(x_minerWork);
 
-    // Retrieve appropriate EpochContext
-    if (m_currentWp.epoch != _newWp.epoch)
+    // Building the context of a new epoch takes seconds : never do it
+    // on the caller's (network) thread. Hold the newest job till ready
+    if (_newWp.epoch != m_epochReady)
+    {
+        m_pendingWp = _newWp;
+        if (m_epochBuilding < 0)
+        {
+            // A previous builder has already released the lock and is exiting
+            if (m_epochThread.joinable())
+                m_epochThread.join();
+            m_epochBuilding = _newWp.epoch;
+            m_epochThread = std::thread(&Farm::buildEpochContext, this, _newWp.epoch);
+        }
+        return;
+    }
+
+    // A job on the ready epoch supersedes any held one
+    m_pendingWp = WorkPackage();
+    dispatchWork(_newWp);
+}
+
+void Farm::buildEpochContext(int _epoch)
+{
+    while (true)
     {
-        ethash::epoch_context _ec = ethash::get_global_epoch_context(_newWp.epoch);
-        m_currentEc.epochNumber = _newWp.epoch;
+        cnote << "Building context for epoch " << _epoch << " ...";
+        auto startBuild = std::chrono::steady_clock::now();
+        ethash::epoch_context _ec = ethash::get_global_epoch_context(_epoch);
+        cnote << "Epoch " << _epoch << " context ready in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startBuild)
+                     .count()
+              << " ms.";
+
+        Guard l(x_minerWork);
+
+        // Jobs went back to the ready epoch meanwhile. Miners must not
+        // change epoch under a running job : the context stays cached
+        // by ethash for when it will be needed
+        if (!m_pendingWp)
+        {
+            m_epochBuilding = -1;
+            return;
+        }
+
+        // Jobs moved to yet another epoch meanwhile
+        if (m_pendingWp.epoch != _epoch)
+        {
+            _epoch = m_pendingWp.epoch;
+            m_epochBuilding = _epoch;
+            continue;
+        }
+
+        m_currentEc.epochNumber = _epoch;
         m_currentEc.lightNumItems = _ec.light_cache_num_items;
         m_currentEc.lightSize = ethash::get_light_cache_size(_ec.light_cache_num_items);
         m_currentEc.dagNumItems = _ec.full_dataset_num_items;
@@ -198,18 +314,48 @@ void Farm::setWork(WorkPackage const& _newWp)
         m_currentEc.lightCache = _ec.light_cache;
 
         for (auto const& miner : m_miners)
-            miner->setEpoch(m_currentEc);
-    }
+            if (miner)
+                miner->setEpoch(m_currentEc);
 
-    // Prevent dispatch of a ProgPoW workpackage which has block number missing
-    if (_newWp.block < 0)
-    {
-        cwarn << EthRed "Got ProgPoW job with missing block number. Discarding ..." EthReset;
+        m_epochReady = _epoch;
+        m_epochBuilding = -1;
+
+        WorkPackage wp = m_pendingWp;
+        m_pendingWp = WorkPackage();
+        dispatchWork(wp);
         return;
     }
+}
+
+void Farm::dispatchWork(WorkPackage const& _newWp)
+{
+    auto dispatchStart = std::chrono::steady_clock::now();
 
     m_currentWp = _newWp;
-    m_telemetry.farm.totalJobs++;
+    m_currentWp.generation = ++m_jobGeneration;
+    m_totalJobs.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        Guard j(x_jobs);
+        if (m_currentWp.cleanJobs)
+            m_jobCleanGeneration = m_currentWp.generation;
+        m_jobs.push_back(m_currentWp);
+        if (m_jobs.size() > m_jobsHistoryMax)
+            m_jobs.pop_front();
+    }
+
+    // Jobs no miner searches any more are pruned once solutions queued
+    // meanwhile are drained
+    uint64_t floor = m_currentWp.generation;
+    for (auto const& miner : m_miners)
+    {
+        uint64_t generation = miner ? miner->searchGeneration() : 0;
+        if (generation)
+            floor = std::min(floor, generation);
+    }
+    m_jobsFloor.store(floor, std::memory_order_release);
+    if (!m_solutionsDraining.exchange(true))
+        g_io_service.post(m_io_strand.wrap(boost::bind(&Farm::drainSolutions, this)));
 
     if (m_Settings.startNonce)
         m_nonce_scrambler = m_Settings.startNonce;
@@ -219,24 +365,163 @@ void Farm::setWork(WorkPackage const& _newWp)
         m_nonce_scrambler = uniform_int_distribution<uint64_t>()(engine);
     }
 
-    uint64_t _startNonce;
+    size_t miners = std::count_if(
+        m_miners.begin(), m_miners.end(), [](std::shared_ptr<Miner> const& _miner) { return bool(_miner); });
+    if (!miners)
+        return;
+
+    uint64_t _startNonce, _spaceLength;
     if (m_currentWp.exSizeBytes > 0)
     {
-        // Equally divide the residual segment among miners
+        // Divide the residual segment among miners
         _startNonce = m_currentWp.startNonce;
-        m_nonce_segment_with = (unsigned int)log2(pow(2, 64 - (m_currentWp.exSizeBytes * 4)) / m_miners.size());
+        m_nonce_segment_with = (unsigned int)log2(pow(2, 64 - (m_currentWp.exSizeBytes * 4)) / miners);
+        unsigned bits = (m_currentWp.exSizeBytes * 4U < 64U) ? 64U - m_currentWp.exSizeBytes * 4U : 0U;
+        _spaceLength = uint64_t(1) << bits;
     }
     else
     {
-        // Get the randomly selected nonce
+        // Get the randomly selected nonce and give the
+        // whole farm the room of one segment per miner
         _startNonce = m_nonce_scrambler;
+        if (m_nonce_segment_with < 64 && miners <= (~uint64_t(0) >> m_nonce_segment_with))
+            _spaceLength = uint64_t(miners) << m_nonce_segment_with;
+        else
+            _spaceLength = ~uint64_t(0);
     }
 
+    assignNonceSegments(_startNonce, _spaceLength);
+
     for (unsigned int i = 0; i < m_miners.size(); i++)
     {
-        m_currentWp.startNonce = _startNonce + ((uint64_t)i << m_nonce_segment_with);
+        if (!m_miners.at(i))
+            continue;
+        {
+            Guard s(x_nonceSegments);
+            m_currentWp.startNonce = m_nonce_segments.at(i).segment.start;
+            m_currentWp.segmentLength = m_nonce_segments.at(i).segment.length;
+        }
         m_miners.at(i)->setWork(m_currentWp);
     }
+
+    m_dispatchTimes.record(uint64_t(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - dispatchStart)
+            .count()));
+}
+
+void Farm::assignNonceSegments(uint64_t _start, uint64_t _length)
+{
+    // Weigh miners on their last measured hashrate. Those
+    // with none yet (just started or paused) get the average.
+    // Indexes of removed miners get nothing
+    size_t count = m_miners.size();
+    vector<double> weights(count, 0.0);
+    double sum = 0.0;
+    unsigned measured = 0;
+    std::shared_ptr<const TelemetryType> telemetry = std::atomic_load(&m_telemetry);
+    for (size_t i = 0; i < count && i < telemetry->miners.size(); i++)
+    {
+        if (!m_miners.at(i))
+            continue;
+        weights[i] = std::max(double(telemetry->miners.at(i).hashrate), 0.0);
+        if (weights[i] > 0.0)
+        {
+            sum += weights[i];
+            measured++;
+        }
+    }
+    double average = measured ? sum / measured : 1.0;
+    sum = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (m_miners.at(i) && weights[i] <= 0.0)
+            weights[i] = average;
+        sum += weights[i];
+    }
+
+    Guard l(x_nonceSegments);
+    m_nonce_segments.resize(count);
+
+    uint64_t assignable = _length - _length / m_nonceReserveDiv;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        MinerNonceSegment& s = m_nonce_segments.at(i);
+        s = MinerNonceSegment();
+        if (!m_miners.at(i))
+            continue;
+        s.share = weights[i] / sum;
+        s.quota = std::max(uint64_t(1), uint64_t((long double)assignable * s.share));
+        if (s.quota > assignable - offset)
+            s.quota = assignable - offset;
+        s.segment.start = _start + offset;
+        s.segment.length = s.quota;
+        s.refills = 0;
+        offset += s.quota;
+    }
+
+    m_nonce_reserve.start = _start + offset;
+    m_nonce_reserve.length = _length - offset;
+    m_nonce_header = m_currentWp.header;
+}
+
+NonceSegment Farm::get_nonce_segment(unsigned _minerIdx)
+{
+    Guard l(x_nonceSegments);
+    if (_minerIdx < m_nonce_segments.size())
+        return m_nonce_segments.at(_minerIdx).segment;
+    return NonceSegment();
+}
+
+bool Farm::refillNonceSegment(unsigned _minerIdx, h256 const& _header, NonceSegment& _segment)
+{
+    Guard l(x_nonceSegments);
+
+    // Miner may be late on a job already replaced
+    if (_minerIdx >= m_nonce_segments.size() || _header != m_nonce_header || !m_nonce_reserve.length)
+        return false;
+
+    MinerNonceSegment& s = m_nonce_segments.at(_minerIdx);
+    s.segment.start = m_nonce_reserve.start;
+    s.segment.length = std::min(std::max(s.quota, uint64_t(1)), m_nonce_reserve.length);
+    s.refills++;
+    m_nonce_reserve.start += s.segment.length;
+    m_nonce_reserve.length -= s.segment.length;
+
+    _segment = s.segment;
+    return true;
+}
+
+bool Farm::joinNonceSegment(unsigned _minerIdx, NonceSegment& _segment)
+{
+    Guard l(x_nonceSegments);
+    if (m_nonce_header != m_currentWp.header || !m_nonce_reserve.length)
+        return false;
+
+    // Size the chunk as the average segment of the others
+    uint64_t total = 0;
+    unsigned count = 0;
+    for (auto const& s : m_nonce_segments)
+    {
+        if (!s.quota)
+            continue;
+        total += s.quota;
+        count++;
+    }
+    if (m_nonce_segments.size() <= _minerIdx)
+        m_nonce_segments.resize(_minerIdx + 1);
+
+    MinerNonceSegment& s = m_nonce_segments.at(_minerIdx);
+    s = MinerNonceSegment();
+    s.quota = count ? total / count : m_nonce_reserve.length / m_nonceReserveDiv;
+    s.quota = std::min(std::max(s.quota, uint64_t(1)), m_nonce_reserve.length);
+    s.segment.start = m_nonce_reserve.start;
+    s.segment.length = s.quota;
+    m_nonce_reserve.start += s.quota;
+    m_nonce_reserve.length -= s.quota;
+
+    _segment = s.segment;
+    return true;
 }
 
 /**
@@ -248,82 +533,445 @@ bool Farm::start()
     if (m_isMining.load(std::memory_order_relaxed))
         return true;
 
+    Guard ms(x_minerSet);
     Guard l(x_minerWork);
 
     // Start all subscribed miners if none yet
     if (!m_miners.size())
     {
+        // Counters must exist before any miner can find a solution. Make
+        // room for miners added at runtime, CPU groups included
+        m_solutionCountersSize = unsigned(m_DevicesCollection.size());
+#if _CPU
+        m_solutionCountersSize += CPUMiner::getNumDevices();
+#endif
+        m_solutionCounters.reset(allocSolutionCounters(m_solutionCountersSize));
+        {
+            Guard s(x_shares);
+            m_shares.resize(m_solutionCountersSize);
+        }
+
         for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
         {
             TelemetryAccountType minerTelemetry;
-#if _CUDA
-            if (it->second.subscriptionType == DeviceSubscriptionTypeEnum::Cuda)
-            {
-                minerTelemetry.prefix = "cu";
-                m_miners.push_back(std::shared_ptr<Miner>(new CUDAMiner(m_miners.size(), m_CUSettings, it->second)));
-            }
-#endif
-#if _OPENCL
-
-            if (it->second.subscriptionType == DeviceSubscriptionTypeEnum::OpenCL)
-            {
-                minerTelemetry.prefix = "cl";
-                m_miners.push_back(std::shared_ptr<Miner>(new CLMiner(m_miners.size(), m_CLSettings, it->second)));
-            }
-#endif
-#if _CPU
-
-            if (it->second.subscriptionType == DeviceSubscriptionTypeEnum::Cpu)
-            {
-                minerTelemetry.prefix = "cp";
-                m_miners.push_back(std::shared_ptr<Miner>(new CPUMiner(m_miners.size(), m_CPSettings, it->second)));
-            }
-#endif
-            if (minerTelemetry.prefix.empty())
+            std::shared_ptr<Miner> miner = createMiner(unsigned(m_miners.size()), it->second, minerTelemetry.prefix);
+            if (!miner)
                 continue;
-            m_telemetry.miners.push_back(minerTelemetry);
+            m_miners.push_back(miner);
+            m_minerPrefixes.push_back(minerTelemetry.prefix);
+            m_minerDevices.push_back(it->first);
+            resetShares(miner->Index());
             m_miners.back()->startWorking();
         }
 
+        // Make miners visible to readers before the first collect
+        std::shared_ptr<TelemetryType> t(new TelemetryType(*std::atomic_load(&m_telemetry)));
+        t->miners.resize(m_minerPrefixes.size());
+        for (size_t i = 0; i < m_minerPrefixes.size(); i++)
+            t->miners[i].prefix = m_minerPrefixes[i];
+        std::atomic_store(&m_telemetry, std::shared_ptr<const TelemetryType>(t));
+
         // Initialize DAG Load mode
-        Miner::setDagLoadInfo(m_Settings.dagLoadMode, (unsigned int)m_miners.size());
+        Miner::setDagLoadInfo(m_Settings.dagLoadMode, m_solutionCountersSize);
 
         m_isMining.store(true, std::memory_order_relaxed);
     }
     else
     {
+        // Latest work is still in each miner : have them pick it up
+        // as soon as their thread is running
         for (auto const& miner : m_miners)
+        {
+            if (!miner)
+                continue;
+            miner->markRestart();
             miner->startWorking();
+            miner->kick_miner();
+        }
         m_isMining.store(true, std::memory_order_relaxed);
     }
 
     return m_isMining.load(std::memory_order_relaxed);
 }
 
+std::shared_ptr<Miner> Farm::createMiner(unsigned _minerIdx, DeviceDescriptor& _device, std::string& _prefix)
+{
+#if _CUDA
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::Cuda)
+    {
+        _prefix = "cu";
+        return std::shared_ptr<Miner>(new CUDAMiner(_minerIdx, m_CUSettings, _device));
+    }
+#endif
+#if _OPENCL
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::OpenCL)
+    {
+        _prefix = "cl";
+        return std::shared_ptr<Miner>(new CLMiner(_minerIdx, m_CLSettings, _device));
+    }
+#endif
+#if _CPU
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::Cpu)
+    {
+        _prefix = "cp";
+        return std::shared_ptr<Miner>(new CPUMiner(_minerIdx, m_CPSettings, _device));
+    }
+#endif
+#if _SIM
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::Sim)
+    {
+        _prefix = "sm";
+        return std::shared_ptr<Miner>(new SimMiner(_minerIdx, m_SMSettings, _device));
+    }
+#endif
+    (void)_minerIdx;
+    (void)_prefix;
+    return nullptr;
+}
+
+unsigned Farm::addMiner(std::string const& _uniqueId, DeviceSubscriptionTypeEnum _type)
+{
+    Guard ms(x_minerSet);
+    Guard l(x_minerWork);
+
+    if (!m_solutionCounters)
+        throw std::invalid_argument("Farm not started");
+
+    auto it = m_DevicesCollection.find(_uniqueId);
+    if (it == m_DevicesCollection.end())
+        throw std::invalid_argument("Unknown device " + _uniqueId);
+    DeviceDescriptor& device = it->second;
+
+    if ((_type == DeviceSubscriptionTypeEnum::Cuda && !device.cuDetected) ||
+        (_type == DeviceSubscriptionTypeEnum::OpenCL && !device.clDetected) ||
+        (_type == DeviceSubscriptionTypeEnum::Cpu && device.type != DeviceTypeEnum::Cpu) ||
+        (_type == DeviceSubscriptionTypeEnum::Sim && !device.smDetected))
+        throw std::invalid_argument("Backend not available for device " + _uniqueId);
+
+    DeviceSubscriptionTypeEnum subscription = device.subscriptionType;
+    if (_type != DeviceSubscriptionTypeEnum::None)
+        device.subscriptionType = _type;
+    try
+    {
+        return attachMiner(device);
+    }
+    catch (...)
+    {
+        device.subscriptionType = subscription;
+        throw;
+    }
+}
+
+unsigned Farm::attachMiner(DeviceDescriptor& _device)
+{
+    // A device gets back its former index (and counters) if any
+    // otherwise takes one left by a device which is gone or a never
+    // used one. Counters of a reused index carry over to keep farm totals,
+    // share difficulties restart with the hash count of the new miner
+    unsigned minerIdx = 0;
+    while (minerIdx < m_minerDevices.size() && m_minerDevices[minerIdx] != _device.uniqueId)
+        minerIdx++;
+    if (minerIdx == m_minerDevices.size())
+    {
+        minerIdx = 0;
+        while (minerIdx < m_minerDevices.size() && !m_minerDevices[minerIdx].empty())
+            minerIdx++;
+    }
+    if (minerIdx < m_miners.size() && m_miners[minerIdx])
+        throw std::invalid_argument("Device " + _device.uniqueId + " is already mining");
+    if (minerIdx >= m_solutionCountersSize)
+        throw std::invalid_argument("No room for more miners");
+
+    std::string prefix;
+    std::shared_ptr<Miner> miner = createMiner(minerIdx, _device, prefix);
+    if (!miner)
+        throw std::invalid_argument("No backend to mine on device " + _device.uniqueId);
+
+    if (minerIdx == m_miners.size())
+    {
+        m_miners.push_back(miner);
+        m_minerPrefixes.push_back(prefix);
+        m_minerDevices.push_back(_device.uniqueId);
+    }
+    else
+    {
+        m_miners[minerIdx] = miner;
+        m_minerPrefixes[minerIdx] = prefix;
+        m_minerDevices[minerIdx] = _device.uniqueId;
+    }
+    resetShares(minerIdx);
+
+    // Make the miner visible to readers before next collect
+    std::shared_ptr<TelemetryType> t(new TelemetryType(*std::atomic_load(&m_telemetry)));
+    t->miners.resize(m_minerPrefixes.size());
+    t->miners[minerIdx] = TelemetryAccountType();
+    t->miners[minerIdx].prefix = prefix;
+    std::atomic_store(&m_telemetry, std::shared_ptr<const TelemetryType>(t));
+
+    // Others have loaded their DAG already
+    miner->loadDagOutOfTurn();
+
+    // Join the current job on a chunk of the nonce reserve. If none is
+    // left the miner waits for next job
+    if (m_epochReady >= 0)
+        miner->setEpoch(m_currentEc);
+    NonceSegment segment;
+    if (m_currentWp && m_currentWp.epoch == m_epochReady && joinNonceSegment(minerIdx, segment))
+    {
+        WorkPackage wp = m_currentWp;
+        wp.startNonce = segment.start;
+        wp.segmentLength = segment.length;
+        miner->setWork(wp);
+    }
+
+    if (m_isMining.load(std::memory_order_relaxed))
+        miner->startWorking();
+
+    cnote << "Added miner " << prefix << minerIdx << " on device " << _device.uniqueId;
+    return minerIdx;
+}
+
+void Farm::removeMiner(unsigned _minerIdx)
+{
+    Guard ms(x_minerSet);
+    std::shared_ptr<Miner> miner;
+    {
+        Guard l(x_minerWork);
+        if (_minerIdx >= m_miners.size() || !m_miners[_minerIdx])
+            throw std::invalid_argument("No miner at index " + to_string(_minerIdx));
+        miner = detachMiner(_minerIdx);
+    }
+    releaseMiner(_minerIdx, miner);
+}
+
+std::shared_ptr<Miner> Farm::detachMiner(unsigned _minerIdx)
+{
+    std::shared_ptr<Miner> miner;
+    miner.swap(m_miners[_minerIdx]);
+    cnote << "Removing miner " << m_minerPrefixes[_minerIdx] << _minerIdx;
+    m_minerPrefixes[_minerIdx].clear();
+    miner->stopWorking();
+    return miner;
+}
+
+void Farm::releaseMiner(unsigned _minerIdx, std::shared_ptr<Miner> const& _miner)
+{
+    // Wait out of x_minerWork as the miner may be loading its DAG.
+    // Sleeps on the worker's stop signal rather than polling it
+    _miner->waitStopped();
+
+    // Removed after a hot stop : device is still set up
+    _miner->releaseResident();
+    Miner::skipDagLoad(_minerIdx);
+
+    Guard l(x_nonceSegments);
+    if (_minerIdx < m_nonce_segments.size())
+        m_nonce_segments[_minerIdx] = MinerNonceSegment();
+}
+
+void Farm::retuneMiners(DeviceSubscriptionTypeEnum _type, std::function<void(Miner&)> const& _apply)
+{
+    std::vector<std::shared_ptr<Miner>> miners;
+    bool mining;
+    {
+        Guard l(x_minerWork);
+        mining = m_isMining.load(std::memory_order_relaxed);
+        for (auto const& miner : m_miners)
+        {
+            if (!miner || miner->getDescriptor().subscriptionType != _type)
+                continue;
+            miners.push_back(miner);
+            if (mining)
+                miner->hotStopWorking();
+        }
+    }
+
+    for (auto const& miner : miners)
+    {
+        miner->waitStopped();
+        _apply(*miner);
+    }
+
+    if (!mining)
+        return;
+    Guard l(x_minerWork);
+    for (auto const& miner : miners)
+    {
+        miner->markRestart();
+        miner->startWorking();
+        miner->kick_miner();
+    }
+}
+
+void Farm::setCLSettings(CLSettings const& _settings)
+{
+    Guard ms(x_minerSet);
+    {
+        Guard l(x_minerWork);
+        m_CLSettings.globalWorkSizeMultiplier = _settings.globalWorkSizeMultiplier;
+        m_CLSettings.localWorkSize = _settings.localWorkSize;
+    }
+#if _OPENCL
+    retuneMiners(DeviceSubscriptionTypeEnum::OpenCL, [&](Miner& _miner) {
+        static_cast<CLMiner&>(_miner).setWorkSizes(_settings.globalWorkSizeMultiplier, _settings.localWorkSize);
+    });
+#endif
+}
+
+void Farm::setCPSettings(CPSettings const& _settings)
+{
+    Guard ms(x_minerSet);
+    unsigned grouping;
+    {
+        Guard l(x_minerWork);
+        grouping = m_CPSettings.grouping;
+        m_CPSettings.batchSize = _settings.batchSize;
+        m_CPSettings.grouping = _settings.grouping;
+    }
+#if _CPU
+    if (_settings.grouping != grouping)
+    {
+        regroupCpuMiners(_settings.grouping);
+        return;
+    }
+    retuneMiners(DeviceSubscriptionTypeEnum::Cpu,
+        [&](Miner& _miner) { static_cast<CPUMiner&>(_miner).setBatchSize(_settings.batchSize); });
+#else
+    (void)grouping;
+#endif
+}
+
+void Farm::regroupCpuMiners(unsigned _grouping)
+{
+#if _CPU
+    std::vector<std::pair<unsigned, std::shared_ptr<Miner>>> detached;
+    {
+        Guard l(x_minerWork);
+        for (unsigned i = 0; i < m_miners.size(); i++)
+            if (m_miners[i] && m_miners[i]->getDescriptor().subscriptionType == DeviceSubscriptionTypeEnum::Cpu)
+                detached.push_back(std::make_pair(i, detachMiner(i)));
+    }
+    for (auto const& d : detached)
+        releaseMiner(d.first, d.second);
+
+    Guard l(x_minerWork);
+    for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end();)
+    {
+        if (it->second.type == DeviceTypeEnum::Cpu)
+            it = m_DevicesCollection.erase(it);
+        else
+            it++;
+    }
+    CPUMiner::enumDevices(m_DevicesCollection, _grouping);
+
+    // Free the indexes of groups the new layout doesn't have
+    for (unsigned i = 0; i < m_minerDevices.size(); i++)
+        if (!m_miners[i] && !m_minerDevices[i].empty() && !m_DevicesCollection.count(m_minerDevices[i]))
+            m_minerDevices[i].clear();
+
+    // Mine on all the new groups if CPUs were mined on
+    if (detached.empty())
+        return;
+    for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
+    {
+        if (it->second.type != DeviceTypeEnum::Cpu)
+            continue;
+        it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cpu;
+        try
+        {
+            attachMiner(it->second);
+        }
+        catch (const std::exception& _ex)
+        {
+            cwarn << "Unable to mine on " << it->first << " : " << _ex.what();
+        }
+    }
+#else
+    (void)_grouping;
+#endif
+}
+
+CLSettings Farm::getCLSettings()
+{
+    Guard l(x_minerWork);
+    return m_CLSettings;
+}
+
+CPSettings Farm::getCPSettings()
+{
+    Guard l(x_minerWork);
+    return m_CPSettings;
+}
+
+std::vector<std::shared_ptr<Miner>> Farm::getMiners()
+{
+    Guard l(x_minerWork);
+    std::vector<std::shared_ptr<Miner>> ret;
+    for (auto const& miner : m_miners)
+        if (miner)
+            ret.push_back(miner);
+    return ret;
+}
+
+unsigned Farm::getMinersCount()
+{
+    Guard l(x_minerWork);
+    return unsigned(std::count_if(
+        m_miners.begin(), m_miners.end(), [](std::shared_ptr<Miner> const& _miner) { return bool(_miner); }));
+}
+
+std::shared_ptr<Miner> Farm::getMiner(unsigned index)
+{
+    Guard l(x_minerWork);
+    if (index < m_miners.size())
+        return m_miners[index];
+    return nullptr;
+}
+
+bool Farm::hasMiner(unsigned _minerIdx)
+{
+    Guard l(x_minerWork);
+    return _minerIdx < m_miners.size() && m_miners[_minerIdx];
+}
+
 /**
  * @brief Stop all mining activities.
  */
-void Farm::stop()
+void Farm::stop(bool _hot)
 {
     // Avoid re-entering if not actually mining.
     // This, in fact, is also called by destructor
     if (isMining())
     {
+        Guard ms(x_minerSet);
         {
             Guard l(x_minerWork);
             for (auto const& miner : m_miners)
-                miner->stopWorking();
+            {
+                if (!miner)
+                    continue;
+                if (_hot)
+                    miner->hotStopWorking();
+                else
+                    miner->stopWorking();
+            }
             m_isMining.store(false, std::memory_order_relaxed);
         }
 
-        // Wait for all miners to finish their job
+        // Wait for all miners to finish their job. The set of
+        // miners can't change while x_minerSet is held
         for (auto const& miner : m_miners)
-        {
-            while (miner->state() != WorkerState::Stopped)
-            {
-                this_thread::sleep_for(std::chrono::microseconds(100));
-            }
-        }
+            if (miner)
+                miner->waitStopped();
+    }
+
+    // A cold stop also releases what a former hot stop kept resident
+    if (!_hot)
+    {
+        Guard ms(x_minerSet);
+        for (auto const& miner : m_miners)
+            if (miner)
+                miner->releaseResident();
     }
 }
 
@@ -336,7 +984,8 @@ void Farm::pause()
     Guard l(x_minerWork);
     m_paused.store(true, std::memory_order_relaxed);
     for (auto const& m : m_miners)
-        m->pause(MinerPauseEnum::PauseDueToFarmPaused);
+        if (m)
+            m->pause(MinerPauseEnum::PauseDueToFarmPaused);
 }
 
 /**
@@ -357,24 +1006,28 @@ void Farm::resume()
     Guard l(x_minerWork);
     m_paused.store(false, std::memory_order_relaxed);
     for (auto const& m : m_miners)
-        m->resume(MinerPauseEnum::PauseDueToFarmPaused);
+        if (m)
+            m->resume(MinerPauseEnum::PauseDueToFarmPaused);
 }
 
 /**
  * @brief Stop all mining activities and Starts them again
  */
-void Farm::restart()
+void Farm::restart(bool _hot)
 {
+    m_restarts.fetch_add(1, std::memory_order_relaxed);
+    if (_hot)
+        m_hotRestarts.fetch_add(1, std::memory_order_relaxed);
     if (m_onMinerRestart)
-        m_onMinerRestart();
+        m_onMinerRestart(_hot);
 }
 
 /**
  * @brief Stop all mining activities and Starts them again (async post)
  */
-void Farm::restart_async()
+void Farm::restart_async(bool _hot)
 {
-    m_io_strand.get_io_service().post(m_io_strand.wrap(boost::bind(&Farm::restart, this)));
+    m_io_strand.get_io_service().post(m_io_strand.wrap(boost::bind(&Farm::restart, this, _hot)));
 }
 
 /**
@@ -397,38 +1050,119 @@ bool Farm::reboot(const std::vector<std::string>& args)
  */
 void Farm::accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accounting)
 {
-    if (_accounting == SolutionAccountingEnum::Accepted)
-    {
-        m_telemetry.farm.solutions.accepted++;
-        m_telemetry.farm.solutions.tstamp = std::chrono::steady_clock::now();
-        m_telemetry.miners.at(_minerIdx).solutions.accepted++;
-        m_telemetry.miners.at(_minerIdx).solutions.tstamp = std::chrono::steady_clock::now();
+    accountSolution(_minerIdx, _accounting, false);
+}
+
+void Farm::accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accounting, bool _stale)
+{
+    // Farm totals are summed from miners' counters when read
+    if (_minerIdx >= m_solutionCountersSize)
         return;
-    }
-    if (_accounting == SolutionAccountingEnum::Wasted)
+
+    // Pools answer submissions in order so the response is for
+    // the oldest pending share of this miner
+    if (_accounting == SolutionAccountingEnum::Accepted || _accounting == SolutionAccountingEnum::Rejected)
     {
-        m_telemetry.farm.solutions.wasted++;
-        m_telemetry.farm.solutions.tstamp = std::chrono::steady_clock::now();
-        m_telemetry.miners.at(_minerIdx).solutions.wasted++;
-        m_telemetry.miners.at(_minerIdx).solutions.tstamp = std::chrono::steady_clock::now();
-        return;
+        Guard l(x_shares);
+        ShareDifficulties& shares = m_shares.at(_minerIdx);
+        if (!shares.pending.empty())
+        {
+            double difficulty = shares.pending.front().first;
+            bool stale = shares.pending.front().second;
+            shares.pending.pop_front();
+            if (_accounting == SolutionAccountingEnum::Rejected)
+                shares.rejected += difficulty;
+            else if (_stale || stale)
+                shares.stale += difficulty;
+            else
+            {
+                shares.accepted += difficulty;
+                shares.acceptedSq += difficulty * difficulty;
+            }
+        }
     }
-    if (_accounting == SolutionAccountingEnum::Rejected)
+
+    SolutionCounters& counters = m_solutionCounters[_minerIdx];
+    switch (_accounting)
     {
-        m_telemetry.farm.solutions.rejected++;
-        m_telemetry.farm.solutions.tstamp = std::chrono::steady_clock::now();
-        m_telemetry.miners.at(_minerIdx).solutions.rejected++;
-        m_telemetry.miners.at(_minerIdx).solutions.tstamp = std::chrono::steady_clock::now();
-        return;
+    case SolutionAccountingEnum::Accepted:
+        counters.accepted.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SolutionAccountingEnum::Wasted:
+        counters.wasted.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SolutionAccountingEnum::Rejected:
+        counters.rejected.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SolutionAccountingEnum::Failed:
+        counters.failed.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SolutionAccountingEnum::StaleDropped:
+        counters.staleDropped.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case SolutionAccountingEnum::Duplicate:
+        counters.duplicates.fetch_add(1, std::memory_order_relaxed);
+        break;
     }
-    if (_accounting == SolutionAccountingEnum::Failed)
-    {
-        m_telemetry.farm.solutions.failed++;
-        m_telemetry.farm.solutions.tstamp = std::chrono::steady_clock::now();
-        m_telemetry.miners.at(_minerIdx).solutions.failed++;
-        m_telemetry.miners.at(_minerIdx).solutions.tstamp = std::chrono::steady_clock::now();
+    counters.tstamp.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void Farm::clearPendingShares()
+{
+    Guard l(x_shares);
+    for (auto& shares : m_shares)
+        shares.pending.clear();
+}
+
+EffectiveHashRateType Farm::effectiveHashRate(ShareDifficulties const& _shares, double _hashes, double _seconds)
+{
+    EffectiveHashRateType ret;
+    ret.accepted = _shares.accepted;
+    ret.rejected = _shares.rejected;
+    ret.stale = _shares.stale;
+    if (_seconds <= 0.0)
+        return ret;
+
+    // Shares arrive as a Poisson process : the sum of their difficulties
+    // has a variance equal to the sum of squared difficulties
+    ret.hashrate = _shares.accepted * c_hashesPerDifficulty / _seconds;
+    double margin = 1.96 * std::sqrt(_shares.acceptedSq) * c_hashesPerDifficulty / _seconds;
+    ret.low = std::max(ret.hashrate - margin, 0.0);
+    ret.high = ret.hashrate + margin;
+    ret.reported = _hashes / _seconds;
+    if (ret.reported > 0.0)
+        ret.deviation = (ret.hashrate - ret.reported) * 100.0 / ret.reported;
+    return ret;
+}
+
+void Farm::resetShares(unsigned _minerIdx)
+{
+    Guard l(x_shares);
+    if (_minerIdx >= m_shares.size())
         return;
-    }
+    m_shares[_minerIdx] = ShareDifficulties();
+    m_shares[_minerIdx].start = std::chrono::steady_clock::now();
+}
+
+void Farm::accountResponseTime(std::chrono::milliseconds _delay)
+{
+    m_responseTimes.record(_delay.count() > 0 ? uint64_t(_delay.count()) * 1000 : 0);
+}
+
+SolutionAccountType Farm::readSolutionCounters(unsigned _minerIdx)
+{
+    SolutionAccountType ret;
+    SolutionCounters const& counters = m_solutionCounters[_minerIdx];
+    ret.accepted = counters.accepted.load(std::memory_order_relaxed);
+    ret.rejected = counters.rejected.load(std::memory_order_relaxed);
+    ret.wasted = counters.wasted.load(std::memory_order_relaxed);
+    ret.failed = counters.failed.load(std::memory_order_relaxed);
+    ret.staleDropped = counters.staleDropped.load(std::memory_order_relaxed);
+    ret.duplicates = counters.duplicates.load(std::memory_order_relaxed);
+    int64_t ticks = counters.tstamp.load(std::memory_order_relaxed);
+    ret.tstamp = ticks ? std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks)) :
+                         m_telemetryStart;
+    return ret;
 }
 
 /**
@@ -437,7 +1171,20 @@ void Farm::accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accountin
 
 SolutionAccountType Farm::getSolutions()
 {
-    return m_telemetry.farm.solutions;
+    SolutionAccountType ret;
+    ret.tstamp = m_telemetryStart;
+    for (unsigned i = 0; i < m_solutionCountersSize; i++)
+    {
+        SolutionAccountType m = readSolutionCounters(i);
+        ret.accepted += m.accepted;
+        ret.rejected += m.rejected;
+        ret.wasted += m.wasted;
+        ret.failed += m.failed;
+        ret.staleDropped += m.staleDropped;
+        ret.duplicates += m.duplicates;
+        ret.tstamp = std::max(ret.tstamp, m.tstamp);
+    }
+    return ret;
 }
 
 /**
@@ -445,14 +1192,9 @@ SolutionAccountType Farm::getSolutions()
  */
 SolutionAccountType Farm::getSolutions(unsigned _minerIdx)
 {
-    try
-    {
-        return m_telemetry.miners.at(_minerIdx).solutions;
-    }
-    catch (const std::exception&)
-    {
+    if (_minerIdx >= m_solutionCountersSize)
         return SolutionAccountType();
-    }
+    return readSolutionCounters(_minerIdx);
 }
 
 /**
@@ -464,7 +1206,27 @@ Json::Value Farm::get_nonce_scrambler_json()
     Json::Value jRes;
     jRes["start_nonce"] = toHex(m_nonce_scrambler, HexPrefix::Add);
     jRes["device_width"] = m_nonce_segment_with;
-    jRes["device_count"] = (uint64_t)m_miners.size();
+    jRes["device_count"] = getMinersCount();
+
+    Guard l(x_nonceSegments);
+    Json::Value jSegments = Json::Value(Json::arrayValue);
+    for (unsigned i = 0; i < m_nonce_segments.size(); i++)
+    {
+        MinerNonceSegment const& s = m_nonce_segments.at(i);
+        Json::Value jSegment;
+        jSegment["index"] = i;
+        jSegment["start"] = toHex(s.segment.start, HexPrefix::Add);
+        jSegment["end"] = toHex(uint64_t(s.segment.start + s.segment.length), HexPrefix::Add);
+        jSegment["share"] = s.share;
+        jSegment["refills"] = s.refills;
+        jSegments.append(jSegment);
+    }
+    jRes["segments"] = jSegments;
+
+    Json::Value jReserve = Json::Value(Json::arrayValue);
+    jReserve.append(toHex(m_nonce_reserve.start, HexPrefix::Add));
+    jReserve.append(toHex(uint64_t(m_nonce_reserve.start + m_nonce_reserve.length), HexPrefix::Add));
+    jRes["reserve"] = jReserve;
 
     return jRes;
 }
@@ -475,38 +1237,182 @@ void Farm::setTStartTStop(unsigned tstart, unsigned tstop)
     m_Settings.tempStop = tstop;
 }
 
-void Farm::submitProof(Solution const& _s)
+void Farm::submitProof(SolutionRecord const& _s)
 {
-    g_io_service.post(m_io_strand.wrap(boost::bind(&Farm::submitProofAsync, this, _s)));
+    if (!m_solutions.push(_s))
+    {
+        m_solutionsDropped.fetch_add(1, std::memory_order_relaxed);
+        cwarn << "Solution " << toHex(_s.nonce, HexPrefix::Add) << " dropped. Submit queue is full.";
+        return;
+    }
+    m_solutionsQueued.fetch_add(1, std::memory_order_relaxed);
+
+    // Post a drain unless one is already pending
+    if (!m_solutionsDraining.exchange(true))
+        g_io_service.post(m_io_strand.wrap(boost::bind(&Farm::drainSolutions, this)));
 }
 
-void Farm::submitProofAsync(Solution const& _s)
+void Farm::drainSolutions()
 {
-    if (!m_Settings.noEval)
+    // Clear the flag before popping: a solution queued from now on
+    // is either drained here or triggers a new drain
+    m_solutionsDraining.store(false);
+
+    // Solutions on jobs older than the floor were queued before it was set
+    uint64_t floor = m_jobsFloor.load(std::memory_order_acquire);
+
+    unsigned depth = unsigned(m_solutions.size());
+    if (depth > m_solutionsMaxDepth.load(std::memory_order_relaxed))
+        m_solutionsMaxDepth.store(depth, std::memory_order_relaxed);
+
+    SolutionRecord records[m_solutionsBatch];
+    unsigned count = 0;
+    while (count < m_solutionsBatch && m_solutions.pop(records[count]))
+        count++;
+
+    // Batch full : there may be more. Let other handlers run in between
+    if (count == m_solutionsBatch && !m_solutionsDraining.exchange(true))
+        g_io_service.post(m_io_strand.wrap(boost::bind(&Farm::drainSolutions, this)));
+
+    for (unsigned i = 0; i < count; i++)
     {
-        bool valid = false;
+        SolutionRecord const& r = records[i];
+
+        Solution sol;
+        bool found = false;
+        bool stale;
+        h256 boundary;
+        {
+            Guard l(x_jobs);
+            for (auto it = m_jobs.rbegin(); it != m_jobs.rend(); ++it)
+            {
+                if (it->generation == r.generation)
+                {
+                    sol.work = *it;
+                    found = true;
+                    break;
+                }
+            }
+            stale = (r.generation < m_jobCleanGeneration);
 
-        valid = ProgPoWAux::verify( _s.work.epoch, _s.work.block, _s.work.header, _s.mixHash, _s.nonce, _s.work.boundary);
+            // Difficulty of jobs gone from history is that of the latest
+            if (found)
+                boundary = sol.work.boundary;
+            else if (!m_jobs.empty())
+                boundary = m_jobs.back().boundary;
+        }
+        double difficulty = (boundary == h256() ? 0.0 : targetToDiff(boundary));
 
-        if (!valid)
+        // Jobs gone from history (a miner lagging behind more than
+        // m_jobsHistoryMax jobs) are stale anyway and can't be submitted
+        if (!found || (stale && m_Settings.stalePolicy == STALE_POLICY_DROP))
         {
-            accountSolution(_s.midx, SolutionAccountingEnum::Failed);
-            cwarn << EthRedBold "**Failed " << EthReset << EthWhiteBold << "GPU " << _s.midx << EthReset
-                  << " gave incorrect result. Lower overclocking values if it happens "
-                     "frequently.";
-            return;
+            accountSolution(r.midx, SolutionAccountingEnum::StaleDropped);
+            {
+                Guard s(x_shares);
+                if (r.midx < m_shares.size())
+                    m_shares[r.midx].stale += difficulty;
+            }
+            cnote << EthOrange "Solution " << toHex(r.nonce, HexPrefix::Add) << " dropped. Job is stale." << EthReset;
+            continue;
         }
-    }
 
-    m_onSolutionFound(_s);
+        // A solution on a newer job resets the set of submitted nonces.
+        // Late solutions on previous jobs are not checked
+        if (sol.work.header != m_submittedHeader && r.generation > m_submittedGeneration)
+        {
+            m_submittedNonces.clear();
+            m_submittedHeader = sol.work.header;
+        }
+        if (sol.work.header == m_submittedHeader)
+        {
+            m_submittedGeneration = std::max(m_submittedGeneration, r.generation);
+            if (!m_submittedNonces.insert(r.nonce))
+            {
+                accountSolution(r.midx, SolutionAccountingEnum::Duplicate);
+                cnote << EthOrange "Solution " << toHex(r.nonce, HexPrefix::Add) << " dropped. Duplicate nonce."
+                      << EthReset;
+                continue;
+            }
+        }
+
+        sol.nonce = r.nonce;
+        sol.mixHash = r.mixHash;
+        sol.tstamp = r.tstamp;
+        sol.midx = r.midx;
+
+        if (!m_Settings.noEval && !(stale && m_Settings.stalePolicy == STALE_POLICY_SUBMIT_UNVERIFIED))
+        {
+            auto verifyStart = std::chrono::steady_clock::now();
+            bool valid = ProgPoWAux::verify(
+                sol.work.epoch, sol.work.block, sol.work.header, sol.mixHash, sol.nonce, sol.work.boundary);
+            m_verifyTimes.record(uint64_t(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - verifyStart)
+                    .count()));
+
+            if (!valid)
+            {
+                accountSolution(sol.midx, SolutionAccountingEnum::Failed);
+                cwarn << EthRedBold "**Failed " << EthReset << EthWhiteBold << "GPU " << sol.midx << EthReset
+                      << " gave incorrect result. Lower overclocking values if it happens "
+                         "frequently.";
+                continue;
+            }
+        }
+
+        {
+            Guard s(x_shares);
+            if (sol.midx < m_shares.size())
+            {
+                auto& pending = m_shares[sol.midx].pending;
+                pending.push_back(std::make_pair(difficulty, stale));
+
+                // Bound shares the pool never answered
+                if (pending.size() > m_maxPendingShares)
+                    pending.pop_front();
+            }
+        }
+
+        m_onSolutionFound(sol);
+
+        uint64_t us = uint64_t(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sol.tstamp)
+                .count());
+        m_submitTimes.record(us);
+        m_solutionsSubmitted.fetch_add(1, std::memory_order_relaxed);
+        m_submitLatencyLast.store(us, std::memory_order_relaxed);
+        m_submitLatencyTotal.fetch_add(us, std::memory_order_relaxed);
+        if (us > m_submitLatencyMax.load(std::memory_order_relaxed))
+            m_submitLatencyMax.store(us, std::memory_order_relaxed);
 
 #ifdef _DEVELOPER
-    if (g_logOptions & LOG_SUBMIT)
-        cnote << "Submit time: "
-              << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _s.tstamp)
-                     .count()
-              << " us.";
+        if (g_logOptions & LOG_SUBMIT)
+            cnote << "Submit time: " << us << " us.";
 #endif
+    }
+
+    // All solutions queued before the floor was set are drained
+    if (count < m_solutionsBatch)
+    {
+        Guard l(x_jobs);
+        while (m_jobs.size() > m_jobsHistory && m_jobs.front().generation < floor)
+            m_jobs.pop_front();
+    }
+}
+
+SolutionQueueStats Farm::getSolutionQueueStats()
+{
+    SolutionQueueStats ret;
+    ret.queued = m_solutionsQueued.load(std::memory_order_relaxed);
+    ret.dropped = m_solutionsDropped.load(std::memory_order_relaxed);
+    ret.depth = unsigned(m_solutions.size());
+    ret.maxDepth = m_solutionsMaxDepth.load(std::memory_order_relaxed);
+    ret.lastLatencyUs = m_submitLatencyLast.load(std::memory_order_relaxed);
+    ret.maxLatencyUs = m_submitLatencyMax.load(std::memory_order_relaxed);
+    ret.submitted = m_solutionsSubmitted.load(std::memory_order_relaxed);
+    if (ret.submitted)
+        ret.avgLatencyUs = m_submitLatencyTotal.load(std::memory_order_relaxed) / ret.submitted;
+    return ret;
 }
 
 // Collects data about hashing and hardware status
@@ -515,17 +1421,65 @@ void Farm::collectData(const boost::system::error_code& ec)
     if (ec)
         return;
 
+    auto collectStart = std::chrono::steady_clock::now();
+
+    // Build a fresh snapshot and publish it at once so readers never
+    // see a half updated one
+    std::shared_ptr<TelemetryType> t(new TelemetryType);
+    t->start = m_telemetryStart;
+    t->hwmon = (m_Settings.hwMon != 0);
+    t->farm.totalJobs = m_totalJobs.load(std::memory_order_relaxed);
+    t->restarts = m_restarts.load(std::memory_order_relaxed);
+    t->hotRestarts = m_hotRestarts.load(std::memory_order_relaxed);
+    t->farm.solutions = getSolutions();
+
+    // Miners may be added or removed meanwhile
+    std::vector<std::shared_ptr<Miner>> miners;
+    {
+        Guard l(x_minerWork);
+        miners = m_miners;
+        t->miners.resize(m_minerPrefixes.size());
+        for (size_t i = 0; i < m_minerPrefixes.size(); i++)
+            t->miners[i].prefix = m_minerPrefixes[i];
+    }
+    for (size_t i = 0; i < t->miners.size(); i++)
+        t->miners[i].solutions = getSolutions(unsigned(i));
+
     // Reset hashrate (it will accumulate from miners)
     float farm_hr = 0.0f;
+    t->farm.hashrateWindows.assign(m_Settings.hrWindows.size(), 0.0f);
+
+    // Hashrates are estimated from hash counters sampled at the same time
+    // so farm rates are plain sums of miners' ones
+    auto now = std::chrono::steady_clock::now();
+    while (m_hashRates.size() < miners.size())
+        m_hashRates.emplace_back(m_Settings.hrWindows, m_Settings.hrEmaSeconds);
 
     // Process miners
-    for (auto const& miner : m_miners)
+    for (auto const& miner : miners)
     {
+        if (!miner)
+            continue;
         int minerIdx = miner->Index();
-        float hr = (miner->paused() ? 0.0f : miner->RetrieveHashRate());
+        RateEstimator& rate = m_hashRates.at(minerIdx);
+        rate.sample(miner->RetrieveHashCount(), now);
+        float hr = float(rate.ema());
         farm_hr += hr;
-        m_telemetry.miners.at(minerIdx).hashrate = hr;
-        m_telemetry.miners.at(minerIdx).paused = miner->paused();
+        t->miners.at(minerIdx).hashrate = hr;
+        t->miners.at(minerIdx).hashrateRaw = float(rate.raw());
+        t->farm.hashrateRaw += float(rate.raw());
+        std::vector<double> windows = rate.windows();
+        for (size_t i = 0; i < windows.size(); i++)
+        {
+            t->miners.at(minerIdx).hashrateWindows.push_back(float(windows[i]));
+            t->farm.hashrateWindows[i] += float(windows[i]);
+        }
+        t->miners.at(minerIdx).paused = miner->paused();
+        t->miners.at(minerIdx).switchTime = miner->RetrieveSwitchTime();
+        t->miners.at(minerIdx).restartTime = miner->RetrieveRestartTime();
+        t->farm.restartTime = std::max(t->farm.restartTime, t->miners.at(minerIdx).restartTime);
+        t->miners.at(minerIdx).threadHashrates = miner->RetrieveThreadHashRates();
+        t->switchTimes.merge(miner->RetrieveSwitchTimes());
 
 
         if (m_Settings.hwMon)
@@ -634,15 +1588,65 @@ void Farm::collectData(const boost::system::error_code& ec)
                     miner->resume(MinerPauseEnum::PauseDueToOverHeating);
             }
 
-            m_telemetry.miners.at(minerIdx).sensors.tempC = tempC;
-            m_telemetry.miners.at(minerIdx).sensors.fanP = fanpcnt;
-            m_telemetry.miners.at(minerIdx).sensors.powerW = powerW / ((double)1000.0);
-            m_telemetry.miners.at(minerIdx).sensors.voltage = voltage / ((double)1000.0);
+            t->miners.at(minerIdx).sensors.tempC = tempC;
+            t->miners.at(minerIdx).sensors.fanP = fanpcnt;
+            t->miners.at(minerIdx).sensors.powerW = powerW / ((double)1000.0);
+            t->miners.at(minerIdx).sensors.voltage = voltage / ((double)1000.0);
         }
 
-        m_telemetry.farm.hashrate = farm_hr;
     }
 
+    t->farm.hashrate = farm_hr;
+
+    // Effective hashrates are averaged since each miner started as hashes
+    // computed on different jobs and difficulties can't be told apart.
+    // Farm's one is the sum of miners' ones, which may have started at
+    // different times
+    {
+        Guard s(x_shares);
+        EffectiveHashRateType& farm = t->farm.effective;
+        farm = EffectiveHashRateType();
+        double farmVariance = 0.0;
+        for (auto const& miner : miners)
+        {
+            if (!miner)
+                continue;
+            unsigned minerIdx = miner->Index();
+            if (minerIdx >= m_shares.size())
+                continue;
+            ShareDifficulties const& shares = m_shares[minerIdx];
+            double seconds = std::chrono::duration<double>(now - shares.start).count();
+            double hashes = double(miner->RetrieveHashCount());
+            EffectiveHashRateType const& e = t->miners.at(minerIdx).effective =
+                effectiveHashRate(shares, hashes, seconds);
+            farm.accepted += e.accepted;
+            farm.rejected += e.rejected;
+            farm.stale += e.stale;
+            farm.hashrate += e.hashrate;
+            farm.reported += e.reported;
+            farmVariance += (e.high - e.hashrate) * (e.high - e.hashrate);
+        }
+        double margin = std::sqrt(farmVariance);
+        farm.low = std::max(farm.hashrate - margin, 0.0);
+        farm.high = farm.hashrate + margin;
+        if (farm.reported > 0.0)
+            farm.deviation = (farm.hashrate - farm.reported) * 100.0 / farm.reported;
+    }
+
+    t->responseTimes = m_responseTimes.snapshot();
+    t->verifyTimes = m_verifyTimes.snapshot();
+    t->submitTimes = m_submitTimes.snapshot();
+    t->dispatchTimes = m_dispatchTimes.snapshot();
+
+    m_submitRate.sample(m_solutionsSubmitted.load(std::memory_order_relaxed), now);
+    t->submitRate = float(m_submitRate.ema());
+
+    m_collectTimes.record(uint64_t(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - collectStart)
+            .count()));
+    t->collectTimes = m_collectTimes.snapshot();
+    std::atomic_store(&m_telemetry, std::shared_ptr<const TelemetryType>(t));
+
     // Resubmit timer for another loop
     m_collectTimer.expires_from_now(boost::posix_time::milliseconds(m_collectInterval));
     m_collectTimer.async_wait(
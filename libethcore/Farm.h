@@ -18,6 +18,7 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <list>
 #include <thread>
 
@@ -30,6 +31,10 @@
 #include <json/json.h>
 
 #include <libdevcore/Common.h>
+#include <libdevcore/Histogram.h>
+#include <libdevcore/MpscRing.h>
+#include <libdevcore/NonceSet.h>
+#include <libdevcore/RateEstimator.h>
 #include <libdevcore/Worker.h>
 
 #include <libethcore/Miner.h>
@@ -42,6 +47,11 @@
 #include <libhwmon/wrapadl.h>
 #endif
 
+// How to handle solutions for jobs older than the last clean job
+#define STALE_POLICY_SUBMIT 0             // Verify and submit as any other
+#define STALE_POLICY_DROP 1               // Drop before verification
+#define STALE_POLICY_SUBMIT_UNVERIFIED 2  // Submit skipping verification
+
 extern boost::asio::io_service g_io_service;
 
 namespace dev
@@ -50,13 +60,64 @@ namespace eth
 {
 struct FarmSettings
 {
-    unsigned dagLoadMode = 0;         // 0 = Parallel; 1 = Serialized
-    bool noEval = false;              // Whether or not to re-evaluate solutions
-    unsigned hwMon = 0;               // 0 - No monitor; 1 - Temp and Fan; 2 - Temp Fan Power
-    uint64_t startNonce = 0;          // 0=not set, each other value: use it as nonce
-    unsigned nonceSegmentWidth = 32;  //
-    unsigned tempStart = 40;          // Temperature threshold to restart mining (if paused)
-    unsigned tempStop = 0;            // Temperature threshold to pause mining (overheating)
+    unsigned dagLoadMode = 0;                         // 0 = Parallel; 1 = Serialized
+    bool noEval = false;                              // Whether or not to re-evaluate solutions
+    unsigned stalePolicy = STALE_POLICY_SUBMIT;       // See STALE_POLICY_*
+    unsigned hwMon = 0;                               // 0 - No monitor; 1 - Temp and Fan; 2 - Temp Fan Power
+    uint64_t startNonce = 0;                          // 0=not set, each other value: use it as nonce
+    unsigned nonceSegmentWidth = 32;                  //
+    unsigned tempStart = 40;                          // Temperature threshold to restart mining (if paused)
+    unsigned tempStop = 0;                            // Temperature threshold to pause mining (overheating)
+    unsigned compileThreads = 2;                      // Worker threads compiling ProgPoW kernels
+    unsigned compileLookahead = 2;                    // Number of ProgPoW periods to compile ahead
+    std::vector<unsigned> hrWindows = {10, 60, 900};  // Hashrate averaging windows (seconds)
+    unsigned hrEmaSeconds = 30;                       // Time constant of smoothed hashrate (seconds)
+};
+
+// Live solution counters of a miner. Updated from different threads and
+// aligned to a cache line so counters of different miners never share one
+struct alignas(64) SolutionCounters
+{
+    std::atomic<unsigned> accepted = {0};
+    std::atomic<unsigned> rejected = {0};
+    std::atomic<unsigned> wasted = {0};
+    std::atomic<unsigned> failed = {0};
+    std::atomic<unsigned> staleDropped = {0};
+    std::atomic<unsigned> duplicates = {0};
+    std::atomic<int64_t> tstamp = {0};  // steady_clock ticks of the last update (0 = never)
+};
+static_assert(sizeof(SolutionCounters) == 64, "SolutionCounters must fill a cache line");
+
+// Frees an array of SolutionCounters from allocSolutionCounters(). Plain
+// new[] does not honour over-alignment before C++17
+struct SolutionCountersDeleter
+{
+    void operator()(SolutionCounters* _p) const;
+};
+
+// Difficulty of shares of a miner
+struct ShareDifficulties
+{
+    std::deque<std::pair<double, bool>> pending;  // Difficulty and stale flag of submitted shares
+                                                  // waiting for pool response (oldest first)
+    double accepted = 0.0;
+    double acceptedSq = 0.0;  // Sum of squares (for variance of accepted)
+    double rejected = 0.0;
+    double stale = 0.0;
+    std::chrono::steady_clock::time_point start;  // When the miner of the slot started counting hashes
+};
+
+// Counters of the queue carrying solutions from miners to the pool client
+struct SolutionQueueStats
+{
+    uint64_t queued = 0;         // Solutions queued by miners
+    uint64_t dropped = 0;        // Solutions dropped on full queue
+    unsigned depth = 0;          // Solutions actually waiting
+    unsigned maxDepth = 0;       // Highest depth seen by the submit side
+    uint64_t lastLatencyUs = 0;  // From find to hand over to the pool client
+    uint64_t avgLatencyUs = 0;
+    uint64_t maxLatencyUs = 0;
+    uint64_t submitted = 0;      // Solutions handed over to the pool client
 };
 
 /**
@@ -70,7 +131,7 @@ public:
     unsigned tstart = 0, tstop = 0;
 
     Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection, FarmSettings _settings, CUSettings _CUSettings,
-        CLSettings _CLSettings, CPSettings _CPSettings);
+        CLSettings _CLSettings, CPSettings _CPSettings, SMSettings _SMSettings = SMSettings());
 
     ~Farm();
 
@@ -90,8 +151,9 @@ public:
     /**
      * @brief All mining activities to a full stop.
      * Implies all mining threads are stopped.
+     * @param _hot Keep devices, DAGs and loaded kernels for the next start()
      */
-    void stop();
+    void stop(bool _hot = false);
 
     /**
      * @brief Signals all miners to suspend mining
@@ -110,13 +172,47 @@ public:
 
     /**
      * @brief Stop all mining activities and Starts them again
+     * @param _hot Only cycle miner threads keeping devices set up
      */
-    void restart();
+    void restart(bool _hot = true);
 
     /**
      * @brief Stop all mining activities and Starts them again (async post)
+     * @param _hot Only cycle miner threads keeping devices set up
      */
-    void restart_async();
+    void restart_async(bool _hot = true);
+
+    /**
+     * @brief Starts mining on a device of the collection while the farm is running
+     * @param _uniqueId Id of the device (eg. its PCI ID)
+     * @param _type Backend to drive the device with (None keeps the subscribed one)
+     * @return Index of the miner
+     * @throws std::invalid_argument if the device can't be mined on
+     */
+    unsigned addMiner(std::string const& _uniqueId, DeviceSubscriptionTypeEnum _type);
+
+    /**
+     * @brief Stops a miner and releases its device. Its index is kept
+     * for the device should it be added again
+     * @throws std::invalid_argument if there's no miner at _minerIdx
+     */
+    void removeMiner(unsigned _minerIdx);
+
+    /**
+     * @brief Applies new work sizes to OpenCL miners. Epoch contexts and DAGs
+     * are kept, only ProgPoW kernels are rebuilt
+     */
+    void setCLSettings(CLSettings const& _settings);
+
+    /**
+     * @brief Applies new settings to CPU miners. On a change of grouping
+     * CPU miners are replaced by ones driving the new groups
+     */
+    void setCPSettings(CPSettings const& _settings);
+
+    CLSettings getCLSettings();
+
+    CPSettings getCPSettings();
 
     /**
      * @brief Returns whether or not the farm has been started
@@ -131,39 +227,34 @@ public:
 
     /**
      * @brief Get information on the progress of mining this work package.
-     * @return The progress with mining so far.
+     * @return A copy of the latest consistent snapshot (refreshed on each collect interval)
      */
-    TelemetryType& Telemetry() { return m_telemetry; }
+    TelemetryType Telemetry() { return *std::atomic_load(&m_telemetry); }
 
     /**
      * @brief Gets current hashrate
      */
-    float HashRate() { return m_telemetry.farm.hashrate; };
+    float HashRate() { return std::atomic_load(&m_telemetry)->farm.hashrate; };
 
     /**
      * @brief Gets the collection of pointers to miner instances
      */
-    std::vector<std::shared_ptr<Miner>> getMiners() { return m_miners; }
+    std::vector<std::shared_ptr<Miner>> getMiners();
 
     /**
      * @brief Gets the number of miner instances
      */
-    unsigned getMinersCount() { return (unsigned)m_miners.size(); };
+    unsigned getMinersCount();
 
     /**
-     * @brief Gets the pointer to a miner instance
+     * @brief Gets the pointer to a miner instance (nullptr if removed)
      */
-    std::shared_ptr<Miner> getMiner(unsigned index)
-    {
-        try
-        {
-            return m_miners.at(index);
-        }
-        catch (const std::exception&)
-        {
-            return nullptr;
-        }
-    }
+    std::shared_ptr<Miner> getMiner(unsigned index);
+
+    /**
+     * @brief Whether a miner runs at _minerIdx
+     */
+    bool hasMiner(unsigned _minerIdx) override;
 
     /**
      * @brief Accounts a solution to a miner and, as a consequence, to
@@ -171,6 +262,21 @@ public:
      */
     void accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accounting) override;
 
+    /**
+     * @brief As above. _stale marks shares accepted by the pool as stale
+     */
+    void accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accounting, bool _stale);
+
+    /**
+     * @brief Forgets shares still waiting for a response (eg. on disconnection)
+     */
+    void clearPendingShares();
+
+    /**
+     * @brief Records the time elapsed from submission of a share to pool response
+     */
+    void accountResponseTime(std::chrono::milliseconds _delay);
+
     /**
      * @brief Gets the solutions account for the whole farm
      */
@@ -182,7 +288,7 @@ public:
     SolutionAccountType getSolutions(unsigned _minerIdx);
 
     using SolutionFound = std::function<void(const Solution&)>;
-    using MinerRestart = std::function<void()>;
+    using MinerRestart = std::function<void(bool)>;
 
     /**
      * @brief Provides a valid header based upon that received previously with setWork().
@@ -224,6 +330,17 @@ public:
      */
     Json::Value get_nonce_scrambler_json();
 
+    /**
+     * @brief Gets the nonce segment a miner is actually working on
+     */
+    NonceSegment get_nonce_segment(unsigned _minerIdx);
+
+    /**
+     * @brief Hands a fresh chunk of the nonce space reserve to a miner
+     * which has exhausted its own segment
+     */
+    bool refillNonceSegment(unsigned _minerIdx, h256 const& _header, NonceSegment& _segment) override;
+
     void setTStartTStop(unsigned tstart, unsigned tstop);
 
     unsigned get_tstart() override { return m_Settings.tempStart; }
@@ -232,20 +349,73 @@ public:
 
     /**
      * @brief Called from a Miner to note a WorkPackage has a solution.
+     * Queues the solution for the submit side without blocking.
      * @param _s The solution.
      */
-    void submitProof(Solution const& _s) override;
+    void submitProof(SolutionRecord const& _s) override;
+
+    /**
+     * @brief Gets the counters of the solutions queue
+     */
+    SolutionQueueStats getSolutionQueueStats();
 
 private:
     std::atomic<bool> m_paused = {false};
 
-    // Async submits solution serializing execution
-    // in Farm's strand
-    void submitProofAsync(Solution const& _s);
+    // Drains queued solutions in Farm's strand, verifies
+    // and hands them over to the pool client
+    void drainSolutions();
 
     // Collects data about hashing and hardware status
     void collectData(const boost::system::error_code& ec);
 
+    // Splits the nonce space of current job among miners
+    // proportionally to their hashrate
+    void assignNonceSegments(uint64_t _start, uint64_t _length);
+
+    // Builds the context of _epoch (in m_epochThread) and
+    // dispatches the held job once ready
+    void buildEpochContext(int _epoch);
+
+    // Sets work to each miner giving it its own nonce segment.
+    // Requires x_minerWork held and the job's epoch ready
+    void dispatchWork(WorkPackage const& _newWp);
+
+    // Reads the live solution counters of a miner
+    SolutionAccountType readSolutionCounters(unsigned _minerIdx);
+
+    // Derives effective hashrate from share difficulties over _seconds
+    static EffectiveHashRateType effectiveHashRate(ShareDifficulties const& _shares, double _hashes, double _seconds);
+
+    // Restarts share difficulties of a slot along with the hash count of
+    // the miner just created for it
+    void resetShares(unsigned _minerIdx);
+
+    // Instantiates the miner for the backend _device is subscribed to
+    std::shared_ptr<Miner> createMiner(unsigned _minerIdx, DeviceDescriptor& _device, std::string& _prefix);
+
+    // Creates a miner for _device and has it join the current job.
+    // Requires x_minerWork held
+    unsigned attachMiner(DeviceDescriptor& _device);
+
+    // Takes a miner out of the farm and signals it to stop.
+    // Requires x_minerWork held
+    std::shared_ptr<Miner> detachMiner(unsigned _minerIdx);
+
+    // Waits for a detached miner to stop
+    void releaseMiner(unsigned _minerIdx, std::shared_ptr<Miner> const& _miner);
+
+    // Hot stops the miners of a backend, has _apply change their settings
+    // and starts them again. Requires x_minerSet held
+    void retuneMiners(DeviceSubscriptionTypeEnum _type, std::function<void(Miner&)> const& _apply);
+
+    // Replaces CPU devices and miners with the ones of _grouping.
+    // Requires x_minerSet held
+    void regroupCpuMiners(unsigned _grouping);
+
+    // Gives a miner joining the current job a chunk of the reserve
+    bool joinNonceSegment(unsigned _minerIdx, NonceSegment& _segment);
+
     /**
      * @brief Spawn a file - must be located in the directory of axisminer binary
      * @return false if file was not found or it is not executeable
@@ -253,14 +423,70 @@ private:
     bool spawn_file_in_bin_dir(const char* filename, const std::vector<std::string>& args);
 
     mutable Mutex x_minerWork;
-    std::vector<std::shared_ptr<Miner>> m_miners;  // Collection of miners
+    std::vector<std::shared_ptr<Miner>> m_miners;  // Collection of miners (nullptr if removed)
+    std::vector<std::string> m_minerDevices;       // Device unique id of each miner index (empty if free)
+    Mutex x_minerSet;                              // Serializes changes to the set of miners
 
     WorkPackage m_currentWp;
     EpochContext m_currentEc;
 
+    // Epoch contexts are built in background. Guarded by x_minerWork
+    std::thread m_epochThread;
+    int m_epochReady = -1;     // Epoch of m_currentEc
+    int m_epochBuilding = -1;  // Epoch being built (-1 if none)
+    WorkPackage m_pendingWp;   // Newest job waiting for its epoch context
+
+    // Solutions queued by miners. Jobs are kept as long as a miner may
+    // still search them to resolve the generation of solutions drained late
+    MpscRing<SolutionRecord> m_solutions;
+    std::atomic<bool> m_solutionsDraining = {false};  // A drain is posted to the strand
+    static const unsigned m_solutionsBatch = 32;      // Max solutions processed per drain
+    Mutex x_jobs;
+    std::deque<WorkPackage> m_jobs;                   // Latest jobs (newest at back)
+    static const unsigned m_jobsHistory = 8;          // Number of jobs kept whatever miners search
+    static const unsigned m_jobsHistoryMax = 64;      // Max number of jobs kept for miners lagging behind
+    std::atomic<uint64_t> m_jobsFloor = {0};          // Oldest generation miners search, set on dispatch
+    uint64_t m_jobGeneration = 0;                     // Generation of latest job
+    uint64_t m_jobCleanGeneration = 0;                // Generation of latest job which cleared the previous ones
+
+    // Nonces submitted on the latest job seen by the submit side.
+    // Only accessed in Farm's strand
+    NonceSet m_submittedNonces;
+    h256 m_submittedHeader;
+    uint64_t m_submittedGeneration = 0;
+
+    std::atomic<uint64_t> m_solutionsQueued = {0};
+    std::atomic<uint64_t> m_solutionsDropped = {0};
+    std::atomic<unsigned> m_solutionsMaxDepth = {0};
+    std::atomic<uint64_t> m_solutionsSubmitted = {0};
+    std::atomic<uint64_t> m_submitLatencyLast = {0};
+    std::atomic<uint64_t> m_submitLatencyTotal = {0};
+    std::atomic<uint64_t> m_submitLatencyMax = {0};
+
     std::atomic<bool> m_isMining = {false};
 
-    TelemetryType m_telemetry;  // Holds progress and status info for farm and miners
+    // Telemetry is published as an immutable snapshot once per collect
+    // interval. Always accessed through std::atomic_load / std::atomic_store
+    std::shared_ptr<const TelemetryType> m_telemetry;
+    std::chrono::steady_clock::time_point m_telemetryStart;
+    std::vector<std::string> m_minerPrefixes;                // Telemetry prefix of each miner
+    std::unique_ptr<SolutionCounters[], SolutionCountersDeleter> m_solutionCounters;  // One per miner index
+    unsigned m_solutionCountersSize = 0;                     // Max number of miner indexes
+    std::atomic<unsigned long> m_totalJobs = {0};
+    std::atomic<unsigned long> m_restarts = {0};
+    std::atomic<unsigned long> m_hotRestarts = {0};
+    LatencyHistogram m_responseTimes;
+    LatencyHistogram m_verifyTimes;
+    LatencyHistogram m_submitTimes;
+    LatencyHistogram m_dispatchTimes;        // Fan out of a job to all miners
+    LatencyHistogram m_collectTimes;         // Build of a telemetry snapshot
+    std::vector<RateEstimator> m_hashRates;  // One per miner. Only accessed in collectData
+    RateEstimator m_submitRate{std::vector<unsigned>(), 10};  // Of solutions submitted. Only accessed
+                                                              // in collectData
+
+    Mutex x_shares;
+    std::vector<ShareDifficulties> m_shares;  // One per device
+    static const size_t m_maxPendingShares = 64;
 
     SolutionFound m_onSolutionFound;
     MinerRestart m_onMinerRestart;
@@ -269,6 +495,7 @@ private:
     CUSettings m_CUSettings;  // Cuda settings passed to CUDA Miner instantiator
     CLSettings m_CLSettings;  // OpenCL settings passed to CL Miner instantiator
     CPSettings m_CPSettings;  // CPU settings passed to CPU Miner instantiator
+    SMSettings m_SMSettings;  // Synthetic settings passed to Sim Miner instantiator
 
     boost::asio::io_service::strand m_io_strand;
     boost::asio::deadline_timer m_collectTimer;
@@ -284,6 +511,22 @@ private:
     uint64_t m_nonce_scrambler;         // see also: FarmSettings.startNonce
     unsigned int m_nonce_segment_with;  // set from FarmSettings.nonceSegmentWidth
 
+    // Segments are sized on the hashrate of each miner. A share of the
+    // nonce space is held back and handed out in chunks to miners which
+    // exhaust their segment before next job
+    struct MinerNonceSegment
+    {
+        NonceSegment segment;  // Segment actually assigned (moves on refill)
+        uint64_t quota = 0;    // Length of the initial segment, also the size of refills
+        double share = 0.0;    // Hashrate share the segment has been sized on
+        unsigned refills = 0;  // Number of refills on current job
+    };
+    Mutex x_nonceSegments;
+    std::vector<MinerNonceSegment> m_nonce_segments;
+    NonceSegment m_nonce_reserve;                 // What's left for refills
+    h256 m_nonce_header;                          // Job the segments refer to
+    static const unsigned m_nonceReserveDiv = 4;  // 1/4 of the space is held back
+
     // Wrappers for hardware monitoring libraries and their mappers
     wrap_nvml_handle* nvmlh = nullptr;
     std::map<string, int> map_nvml_handle = {};
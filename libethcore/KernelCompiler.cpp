@@ -0,0 +1,226 @@
+/*
+ This file is part of axisminer.
+
+ axisminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ axisminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+
+#include <libdevcore/Log.h>
+
+#include "KernelCompiler.h"
+
+namespace dev
+{
+namespace eth
+{
+KernelCompiler& KernelCompiler::get()
+{
+    static KernelCompiler instance;
+    return instance;
+}
+
+KernelCompiler::~KernelCompiler()
+{
+    stop();
+}
+
+void KernelCompiler::configure(unsigned _workers, unsigned _lookahead)
+{
+    std::lock_guard<std::mutex> l(x_tasks);
+    m_numWorkers = std::max(_workers, 1U);
+    m_lookahead = _lookahead;
+}
+
+KernelCompiler::Task* KernelCompiler::findPending(const std::string& _key, uint32_t _period)
+{
+    for (Task& t : m_queue)
+        if (t.period == _period && t.key == _key)
+            return &t;
+    for (Task& t : m_running)
+        if (t.period == _period && t.key == _key)
+            return &t;
+    return nullptr;
+}
+
+bool KernelCompiler::enqueue(const std::string& _key, uint32_t _period, const void* _owner, std::function<void()> _task,
+    std::function<void()> _done)
+{
+    std::lock_guard<std::mutex> l(x_tasks);
+    if (m_stop)
+        return false;
+
+    // Join the pending compilation. A miner asking again for the same one
+    // is not merged twice
+    if (Task* pending = findPending(_key, _period))
+    {
+        for (const Waiter& w : pending->waiters)
+            if (w.owner == _owner)
+                return false;
+        pending->waiters.push_back(Waiter{_owner, std::move(_task), std::move(_done)});
+        m_stats.merged++;
+        return false;
+    }
+
+    // Lazily spawn workers on first request
+    if (m_workers.empty())
+    {
+        for (unsigned i = 0; i < m_numWorkers; i++)
+            m_workers.emplace_back(&KernelCompiler::workerLoop, this);
+    }
+
+    m_queue.push_back(Task{_key, _period, _owner, {Waiter{_owner, std::move(_task), std::move(_done)}}});
+    m_taskSignal.notify_one();
+    return true;
+}
+
+void KernelCompiler::wait(const std::string& _key, uint32_t _period)
+{
+    std::unique_lock<std::mutex> l(x_tasks);
+    m_doneSignal.wait(l, [&] { return m_stop || !findPending(_key, _period); });
+}
+
+void KernelCompiler::cancel(const void* _owner)
+{
+    std::unique_lock<std::mutex> l(x_tasks);
+
+    // Other miners' compilations won't notify it
+    auto dropWaiter = [_owner](Task& _t) {
+        for (auto it = _t.waiters.begin(); it != _t.waiters.end(); ++it)
+        {
+            if (it->owner == _owner)
+            {
+                _t.waiters.erase(it);
+                break;
+            }
+        }
+    };
+    for (auto it = m_queue.begin(); it != m_queue.end();)
+    {
+        dropWaiter(*it);
+
+        // Queued tasks of _owner are handed to the next miner waiting for
+        // them, if any
+        if (it->waiters.empty())
+        {
+            it = m_queue.erase(it);
+            continue;
+        }
+        it->owner = it->waiters.front().owner;
+        ++it;
+    }
+    for (Task& t : m_running)
+        dropWaiter(t);
+    m_doneSignal.notify_all();
+
+    m_doneSignal.wait(l, [&] {
+        for (const Task& t : m_running)
+            if (t.owner == _owner)
+                return false;
+        return true;
+    });
+}
+
+void KernelCompiler::stop()
+{
+    {
+        std::lock_guard<std::mutex> l(x_tasks);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_taskSignal.notify_all();
+    m_doneSignal.notify_all();
+
+    for (auto& t : m_workers)
+        t.join();
+    m_workers.clear();
+}
+
+KernelCompilerStats KernelCompiler::stats()
+{
+    std::lock_guard<std::mutex> l(x_tasks);
+    KernelCompilerStats ret = m_stats;
+    ret.pending = unsigned(m_queue.size() + m_running.size());
+    ret.lookahead = m_lookahead;
+    return ret;
+}
+
+void KernelCompiler::workerLoop()
+{
+    dev::setThreadName("compiler");
+
+    std::unique_lock<std::mutex> l(x_tasks);
+    while (true)
+    {
+        m_taskSignal.wait(l, [&] { return m_stop || !m_queue.empty(); });
+        if (m_stop)
+            break;
+
+        m_running.push_back(std::move(m_queue.front()));
+        m_queue.pop_front();
+        Task& task = m_running.back();
+        std::function<void()> fn = std::move(task.waiters.front().fn);
+        std::string key = task.key;
+        uint32_t period = task.period;
+        const void* owner = task.owner;
+
+        l.unlock();
+
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            fn();
+        }
+        catch (const std::exception& _ex)
+        {
+            ok = false;
+            cwarn << "Failed to compile ProgPoW kernel (" << key << ") at period " << period << " : " << _ex.what();
+        }
+        uint64_t ms = uint64_t(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+        l.lock();
+
+        if (ok)
+        {
+            m_stats.compiled++;
+            m_stats.lastMs = ms;
+            m_stats.maxMs = std::max(m_stats.maxMs, ms);
+            m_totalMs += ms;
+            m_stats.avgMs = m_totalMs / m_stats.compiled;
+        }
+        else
+        {
+            m_stats.failed++;
+        }
+
+        for (auto it = m_running.begin(); it != m_running.end(); ++it)
+        {
+            if (it->owner == owner && it->period == period && it->key == key)
+            {
+                // Under the lock so that cancel() can't return meanwhile
+                if (ok)
+                    for (const Waiter& w : it->waiters)
+                        w.done();
+                m_running.erase(it);
+                break;
+            }
+        }
+        m_doneSignal.notify_all();
+    }
+}
+
+}  // namespace eth
+}  // namespace dev
@@ -0,0 +1,135 @@
+/*
+ This file is part of axisminer.
+
+ axisminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ axisminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dev
+{
+namespace eth
+{
+// Snapshot of the compile service counters
+struct KernelCompilerStats
+{
+    unsigned compiled = 0;   // Successfully completed compilations
+    unsigned failed = 0;     // Failed compilations
+    unsigned merged = 0;     // Requests merged into an already queued or running one
+    unsigned pending = 0;    // Queued plus running compilations
+    uint64_t lastMs = 0;     // Duration of last compilation
+    uint64_t avgMs = 0;      // Average duration of compilations
+    uint64_t maxMs = 0;      // Longest compilation
+    unsigned lookahead = 0;  // Number of periods compiled ahead of the current one
+};
+
+/**
+ * @brief Process wide service compiling ProgPoW period kernels in background.
+ * Requests are identified by a key (backend and device class, i.e. whatever
+ * identifies an entry of the backend's kernel cache) and a period: equal
+ * requests coming from different miners are merged into one compilation.
+ */
+class KernelCompiler
+{
+public:
+    static KernelCompiler& get();
+
+    /**
+     * @brief Sets number of worker threads and how many periods miners should
+     * compile ahead of the current one. Takes effect before first request.
+     */
+    void configure(unsigned _workers, unsigned _lookahead);
+
+    unsigned lookahead() const { return m_lookahead; }
+
+    /**
+     * @brief Queues a compilation unless an equal one is already queued or running
+     * @param _owner The miner which provides _task. Used by cancel()
+     * @param _task Compiles for _owner. Kept when merged, to compile in
+     * place of the owner of the queued request if it cancels
+     * @param _done Invoked once the compilation succeeded, also when the
+     * request has been merged into another miner's one. Must not block
+     * @return false if the request has been merged
+     */
+    bool enqueue(const std::string& _key, uint32_t _period, const void* _owner, std::function<void()> _task,
+        std::function<void()> _done);
+
+    /**
+     * @brief Blocks till no compilation for (_key, _period) is queued or running
+     */
+    void wait(const std::string& _key, uint32_t _period);
+
+    /**
+     * @brief Withdraws _owner from queued tasks and waits for its running
+     * ones. Queued tasks other miners merged into are compiled with the
+     * task of the next of them instead, the others are dropped. _owner is
+     * not notified of other miners' compilations any more
+     */
+    void cancel(const void* _owner);
+
+    /**
+     * @brief Stops the worker threads. Queued tasks are dropped.
+     */
+    void stop();
+
+    KernelCompilerStats stats();
+
+private:
+    KernelCompiler() = default;
+    ~KernelCompiler();
+
+    // A miner waiting for a compilation
+    struct Waiter
+    {
+        const void* owner;
+        std::function<void()> fn;  // Its own compile task
+        std::function<void()> done;
+    };
+
+    struct Task
+    {
+        std::string key;
+        uint32_t period;
+        const void* owner;            // Miner whose task compiles, the first waiter
+        std::vector<Waiter> waiters;  // Owner first, then the requests merged
+    };
+
+    void workerLoop();
+    Task* findPending(const std::string& _key, uint32_t _period);
+
+    std::mutex x_tasks;
+    std::condition_variable m_taskSignal;  // Signals a new task or stop
+    std::condition_variable m_doneSignal;  // Signals completion of a task
+    std::deque<Task> m_queue;
+    std::vector<Task> m_running;
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+
+    unsigned m_numWorkers = 2;
+    unsigned m_lookahead = 2;
+
+    KernelCompilerStats m_stats;
+    uint64_t m_totalMs = 0;
+};
+
+}  // namespace eth
+}  // namespace dev
@@ -16,20 +16,21 @@
  */
 
 #include "Miner.h"
+#include "KernelCompiler.h"
 
 namespace dev
 {
 namespace eth
 {
 unsigned Miner::s_dagLoadMode = 0;
-unsigned Miner::s_dagLoadIndex = 0;
+std::atomic<unsigned> Miner::s_dagLoadIndex(0);
+Futex Miner::s_dagLoadSignal;
 unsigned Miner::s_minersCount = 0;
 
 FarmFace* FarmFace::m_this = nullptr;
 
 Miner::Miner(std::string const& _name, unsigned _index) : Worker(_name + std::to_string(_index)), m_index(_index)
 {
-    m_work_latest.header = h256();
 }
 
 DeviceDescriptor Miner::getDescriptor()
@@ -39,26 +40,64 @@ DeviceDescriptor Miner::getDescriptor()
 
 void Miner::setWork(WorkPackage const& _work)
 {
-    {
-        boost::mutex::scoped_lock l(x_work);
-        m_work_latest = _work;
-#ifdef _DEVELOPER
-        m_workSwitchStart = std::chrono::steady_clock::now();
-#endif
-    }
+    // Only the Farm writes the slot : publish a new immutable snapshot
+    // and advance the generation so a running search can bail out
+    std::shared_ptr<MinerWorkSlot> slot(new MinerWorkSlot);
+    slot->work = _work;
+    slot->generation = m_work_generation.load(memory_order_relaxed) + 1;
+    slot->assigned = std::chrono::steady_clock::now();
+
+    std::atomic_store(&m_work_latest, std::shared_ptr<const MinerWorkSlot>(std::move(slot)));
+    m_work_generation.fetch_add(1, memory_order_release);
 
     kick_miner();
 }
 
 void Miner::stopWorking()
 {
+    m_keepResident.store(false, memory_order_relaxed);
+    Worker::stopWorking();
+    kick_miner();
+
+    // Release a miner eventually waiting for its turn to load DAG
+    s_dagLoadSignal.fetch_add(1);
+    s_dagLoadSignal.notify_all();
+}
+
+void Miner::hotStopWorking()
+{
+    m_keepResident.store(true, memory_order_relaxed);
     Worker::stopWorking();
     kick_miner();
+
+    s_dagLoadSignal.fetch_add(1);
+    s_dagLoadSignal.notify_all();
+}
+
+void Miner::markRestart() noexcept
+{
+    m_restartMark.store(std::chrono::steady_clock::now().time_since_epoch().count(), memory_order_relaxed);
+}
+
+bool Miner::resumeResident() noexcept
+{
+    bool resident = m_resident;
+    m_resident = false;
+    return resident;
+}
+
+void Miner::releaseResident()
+{
+    if (!resumeResident())
+        return;
+    releaseDevice();
+    m_work_active = WorkPackage();
 }
 
 void Miner::kick_miner()
 {
     m_new_work.store(true, std::memory_order_relaxed);
+    m_new_work_signal.fetch_add(1);
     m_new_work_signal.notify_one();
 }
 
@@ -118,26 +157,20 @@ void Miner::resume(MinerPauseEnum fromwhat)
         kick_miner();
 }
 
-float Miner::RetrieveHashRate() noexcept
-{
-    bool ex = true;
-    if (!m_hrLive.compare_exchange_strong(ex, false))
-        m_hr.store(0.0f, memory_order_relaxed);
-
-    return m_hr.load(std::memory_order_relaxed);
-}
-
 bool Miner::initEpoch()
 {
     // When loading of DAG is sequential wait for
     // this instance to become current
-    if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+    bool sequential = (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL && !m_dagLoadOutOfTurn);
+    m_dagLoadOutOfTurn = false;
+    if (sequential)
     {
-        while (s_dagLoadIndex < m_index)
+        while (!shouldStop())
         {
-            boost::system_time const timeout = boost::get_system_time() + boost::posix_time::seconds(3);
-            boost::mutex::scoped_lock l(x_work);
-            m_dag_loaded_signal.timed_wait(l, timeout);
+            uint32_t signal = s_dagLoadSignal.load();
+            if (s_dagLoadIndex.load() >= m_index)
+                break;
+            s_dagLoadSignal.wait(signal);
         }
         if (shouldStop())
             return false;
@@ -147,18 +180,38 @@ bool Miner::initEpoch()
     // specific for miner
     bool result = initEpoch_internal();
 
-    // Advance to next miner or reset to zero for
+    // Advance to next miner or reset to the first one for
     // next run if all have processed
-    if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+    if (sequential)
+        advanceDagLoad(m_index);
+
+    return result;
+}
+
+void Miner::advanceDagLoad(unsigned _index)
+{
+    // Skip indexes of removed miners
+    unsigned next = _index + 1;
+    while (next < s_minersCount && !FarmFace::f().hasMiner(next))
+        next++;
+    if (next < s_minersCount)
     {
-        s_dagLoadIndex = (m_index + 1);
-        if (s_minersCount == s_dagLoadIndex)
-            s_dagLoadIndex = 0;
-        else
-            m_dag_loaded_signal.notify_all();
+        s_dagLoadIndex.store(next);
+        s_dagLoadSignal.fetch_add(1);
+        s_dagLoadSignal.notify_all();
+        return;
     }
 
-    return result;
+    next = 0;
+    while (next < s_minersCount && !FarmFace::f().hasMiner(next))
+        next++;
+    s_dagLoadIndex.store(next < s_minersCount ? next : 0);
+}
+
+void Miner::skipDagLoad(unsigned _index)
+{
+    if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL && s_dagLoadIndex.load() == _index)
+        advanceDagLoad(_index);
 }
 
 bool Miner::initEpoch_internal()
@@ -182,12 +235,12 @@ void Miner::minerLoop()
         newProg = false;
         newProgPoWPeriod = 0;
 
-        // Wait for work or 3 seconds (whichever the first)
+        // Wait for work. Read the signal word before testing the flag
+        // so a kick in between makes wait() return immediately
+        uint32_t signal = m_new_work_signal.load();
         if (!m_new_work.load(memory_order_relaxed))
         {
-            boost::system_time const timeout = boost::get_system_time() + boost::posix_time::seconds(3);
-            boost::mutex::scoped_lock l(x_work);
-            m_new_work_signal.timed_wait(l, timeout);
+            m_new_work_signal.wait(signal);
             continue;
         }
 
@@ -196,10 +249,13 @@ void Miner::minerLoop()
 
         if (shouldStop())  // Exit ! Request to terminate
             break;
-        if (paused() || !m_work_latest)  // Wait ! Gpu is not ready or there is no work
+
+        // Pick up latest work snapshot
+        std::shared_ptr<const MinerWorkSlot> slot = std::atomic_load(&m_work_latest);
+        if (paused() || !slot || !slot->work)  // Wait ! Gpu is not ready or there is no work
             continue;
 /*
-        if(m_work_latest.block<940410) {
+        if(slot->work.block<940410) {
             this_thread::sleep_for(chrono::seconds(10));
             clog << "not yet above the 940410 height, sleep 2 seconds!\n";
             continue;
@@ -207,31 +263,22 @@ void Miner::minerLoop()
 */
         // Copy latest work into active slot
         {
-            boost::mutex::scoped_lock l(x_work);
+            WorkPackage latest = slot->work;
 
             // On epoch change for sure we have a period switch
-            newEpoch = (m_work_latest.epoch != m_work_active.epoch) ? true : false;
+            newEpoch = (latest.epoch != m_work_active.epoch) ? true : false;
             // Check latest period is different from active period
             // This also occurs on epoch change as long as PROGPOW_PERIOD is
             // a divisor of Epoch height (i.e. (30k % PROGPOW_PERIOD) == 0)
-            if (m_work_latest.block / PROGPOW_PERIOD != m_work_active.period)
+            if (latest.block / PROGPOW_PERIOD != m_work_active.period)
             {
-                newProgPoWPeriod = m_work_latest.block / PROGPOW_PERIOD;
+                newProgPoWPeriod = latest.block / PROGPOW_PERIOD;
                 newProg=true;
-                m_work_latest.period = int(newProgPoWPeriod);
+                latest.period = int(newProgPoWPeriod);
             }
             else
             {
-                m_work_latest.period = m_work_active.period;
-
-                // Do get prepared for next period
-                if (uint32_t(m_work_latest.period) >= m_progpow_kernel_latest.load(memory_order_relaxed))
-                {
-                    if (((m_work_latest.period + 1) * PROGPOW_PERIOD) % 30000 != 0)
-                    {
-                        invokeAsyncCompile(uint32_t(m_work_latest.period + 1), false);
-                    }
-                }
+                latest.period = m_work_active.period;
             }
 
             // Lower current target so we can be sure it will be set as
@@ -239,19 +286,29 @@ void Miner::minerLoop()
             if (newEpoch || newProg)
                 m_current_target = 0;
 
-            m_work_active = m_work_latest;
-            l.unlock();
+            m_work_active = std::move(latest);
+            m_work_active_generation = slot->generation;
+            m_searchGeneration.store(m_work_active.generation, memory_order_release);
+            m_progpow_kernel_active.store(uint32_t(m_work_active.period), memory_order_relaxed);
+            m_workActiveSwitchStart = slot->assigned;
         }
 
         // Epoch change ?
         if (newEpoch)
         {
+            // Kernels of previous epoch are useless
+            m_progpow_kernel_latest.store(0, memory_order_relaxed);
+
             // If mining algo is ProgPoW invoke async compilation
             // of kernel while DAG is generating. Epoch context is already loaded
             invokeAsyncCompile(uint32_t(m_work_active.period), false);
 
             if (!initEpoch())
+            {
+                // DAG may be incomplete : force its generation on next start
+                m_work_active = WorkPackage();
                 break;  // This will simply exit the thread
+            }
 
             // Forces load of new period
             loadProgPoWKernel(newProgPoWPeriod);
@@ -280,68 +337,115 @@ void Miner::minerLoop()
             }
         }
 
+        // Do get prepared for next periods
+        compileAhead(uint32_t(m_work_active.period));
+
         // Start progpow searching
         progpow_search();
     }
 
-    unloadProgPoWKernel();
+    m_searchGeneration.store(0, memory_order_release);
 
-    if (m_compilerThread)
+    // On a hot stop device, DAG and loaded kernel are kept for the
+    // next start. Otherwise they're released and must be set up again
+    m_resident = m_keepResident.load(memory_order_relaxed);
+    if (!m_resident)
     {
-        m_compilerThread->join();
-        m_compilerThread.reset();
+        unloadProgPoWKernel();
+        m_work_active = WorkPackage();
     }
+
+    // Our compile tasks reference this instance
+    KernelCompiler::get().cancel(this);
 }
 
-void Miner::updateHashRate(uint32_t _hashes, uint64_t _microseconds) noexcept
+void Miner::updateHashRate(uint64_t _hashes) noexcept
 {
-    // Signal we've received an update
-    m_hrLive.store(true, memory_order_relaxed);
+    // Grouped CPU devices call this from each hashing thread
+    m_hashCount.fetch_add(_hashes, memory_order_relaxed);
+}
+
+void Miner::updateSwitchTime() noexcept
+{
+    auto now = std::chrono::steady_clock::now();
 
-    // If the sampling interval is too small treat this call as
-    // as simple "I'm alive" call.
-    // Minimum sampling interval is 1s.
-    if (_microseconds < 1000000ULL)
+    // First hash after a restart : the job was assigned before the restart
+    // so this isn't a job switch
+    int64_t mark = m_restartMark.exchange(0, memory_order_relaxed);
+    if (mark)
+    {
+        auto elapsed = now - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(mark));
+        m_restartTime.store(
+            uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()), memory_order_relaxed);
         return;
+    }
 
-    float instantHr = float(_hashes * 1.0e6f) / _microseconds;
-    m_hr.store(instantHr, memory_order_relaxed);
+    auto elapsed = now - m_workActiveSwitchStart;
+    uint64_t us = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    m_workSwitchTime.store(us, memory_order_relaxed);
+    m_workSwitchTimes.record(us);
 }
 
-void Miner::invokeAsyncCompile(uint32_t _seed, bool _wait)
+uint64_t Miner::segmentNonce(NonceSegment& _segment, WorkPackage const& _work, uint64_t _nonce, uint64_t _count)
 {
-    _wait=true;
-    if (m_compilerThread)
+    // Unsigned arithmetic keeps this right for segments wrapping around 2^64
+    if (!_segment.length || (_nonce - _segment.start) + _count <= _segment.length)
+        return _nonce;
+
+    NonceSegment refill;
+    if (!FarmFace::f().refillNonceSegment(m_index, _work.header, refill))
     {
-        if (m_compilerThread->joinable())
-            m_compilerThread->join();
+        // Keep going past the end of the segment rather than idling.
+        // Don't ask again for the rest of this job
+        cwarn << "Nonce segment exhausted on job " << _work.header.abridged();
+        _segment.length = 0;
+        return _nonce;
     }
 
-    m_progpow_kernel_compile_inprogress.store(true, std::memory_order_relaxed);
-    std::string tname = dev::getThreadName();
+    _segment = refill;
+    return refill.start;
+}
 
-    m_compilerThread.reset(new std::thread(
-        [&](uint32_t _seed, std::string _tname) {
-            try
-            {
-                dev::setThreadName(_tname.c_str());
-                compileProgPoWKernel(_seed, uint32_t(m_epochContext.dagSize / ETHASH_MIX_BYTES));
-                m_progpow_kernel_latest.store(_seed, memory_order_relaxed);
-            }
-            catch (const std::runtime_error& _ex)
+void Miner::invokeAsyncCompile(uint32_t _seed, bool _wait)
+{
+    uint32_t dagelms = uint32_t(m_epochContext.dagSize / ETHASH_MIX_BYTES);
+    std::string key = compileKey();
+
+    // Kernel lands in the backend cache shared by all miners with the same
+    // key : whoever compiles it, every miner waiting for it is done
+    KernelCompiler::get().enqueue(
+        key, _seed, this, [this, _seed, dagelms]() { compileProgPoWKernel(_seed, dagelms); },
+        [this, _seed]() {
+            uint32_t latest = m_progpow_kernel_latest.load(memory_order_relaxed);
+            while (_seed > latest &&
+                   !m_progpow_kernel_latest.compare_exchange_weak(latest, _seed, memory_order_relaxed))
             {
-                cwarn << "Failed to compile ProgPoW kernel : " << _ex.what();
             }
-            m_progpow_kernel_compile_inprogress.store(false, std::memory_order_relaxed);
-        },
-        _seed, tname));
+        });
 
     if (_wait)
+        KernelCompiler::get().wait(key, _seed);
+}
+
+void Miner::compileAhead(uint32_t _period)
+{
+    unsigned lookahead = KernelCompiler::get().lookahead();
+    for (uint32_t p = _period + 1; p <= _period + lookahead; p++)
     {
-        m_compilerThread->join();
-        m_compilerThread.reset();
+        // Kernels depend on DAG size : don't cross epoch boundary
+        if ((p * PROGPOW_PERIOD) % 30000 == 0)
+            break;
+        if (p > m_progpow_kernel_latest.load(memory_order_relaxed))
+            invokeAsyncCompile(p, false);
     }
 }
 
+unsigned Miner::kernelsAhead() const noexcept
+{
+    uint32_t latest = m_progpow_kernel_latest.load(memory_order_relaxed);
+    uint32_t active = m_progpow_kernel_active.load(memory_order_relaxed);
+    return (latest > active) ? latest - active : 0;
+}
+
 }  // namespace eth
 }  // namespace dev
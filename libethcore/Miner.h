@@ -24,6 +24,8 @@
 
 #include "EthashAux.h"
 #include <libdevcore/Common.h>
+#include <libdevcore/Futex.h>
+#include <libdevcore/Histogram.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/Worker.h>
 
@@ -65,7 +67,8 @@ enum class DeviceSubscriptionTypeEnum
     None,
     OpenCL,
     Cuda,
-    Cpu
+    Cpu,
+    Sim
 
 };
 
@@ -74,7 +77,8 @@ enum class MinerType
     Mixed,
     CL,
     CUDA,
-    CPU
+    CPU,
+    SIM
 };
 
 enum class HwMonitorInfoType
@@ -99,7 +103,9 @@ enum class SolutionAccountingEnum
     Accepted,
     Rejected,
     Wasted,
-    Failed
+    Failed,
+    StaleDropped,
+    Duplicate
 };
 
 // Holds settings for CUDA Miner
@@ -124,6 +130,18 @@ struct CPSettings
 {
     vector<unsigned> devices;
     unsigned batchSize = 30U;
+    unsigned grouping = 0;  // 0 = one miner per logical CPU
+                            // 1 = one miner per NUMA node
+                            // 2 = one miner per L3 cache domain
+};
+
+// Holds settings for synthetic (scale test) Miners
+struct SMSettings
+{
+    unsigned devices = 0;         // Number of synthetic devices
+    double hashrate = 30.0e6;     // Hashrate reported by each device (h/s)
+    double solutionRate = 0.1;    // Solutions found by each device per second
+    unsigned invalidPercent = 0;  // Share of solutions carrying a wrong mix hash
 };
 
 struct SolutionAccountType
@@ -132,6 +150,8 @@ struct SolutionAccountType
     unsigned rejected = 0;
     unsigned wasted = 0;
     unsigned failed = 0;
+    unsigned staleDropped = 0;  // Found on superseded jobs and not submitted
+    unsigned duplicates = 0;    // Nonces already submitted on the same job
     std::chrono::steady_clock::time_point tstamp = std::chrono::steady_clock::now();
     string str()
     {
@@ -142,6 +162,10 @@ struct SolutionAccountType
             _ret.append(":R" + to_string(rejected));
         if (failed)
             _ret.append(":F" + to_string(failed));
+        if (staleDropped)
+            _ret.append(":S" + to_string(staleDropped));
+        if (duplicates)
+            _ret.append(":D" + to_string(duplicates));
         return _ret;
     };
 };
@@ -163,14 +187,34 @@ struct HwSensorsType
     };
 };
 
+// Hashrate inferred from the difficulty of shares. Hashrates are in
+// hashes per second averaged since start
+struct EffectiveHashRateType
+{
+    double accepted = 0.0;   // Sum of difficulties of accepted shares
+    double rejected = 0.0;   // Sum of difficulties of rejected shares
+    double stale = 0.0;      // Sum of difficulties of stale shares (dropped or accepted as stale)
+    double hashrate = 0.0;   // Hashrate proven by accepted shares
+    double low = 0.0;        // Lower bound of 95% confidence interval of hashrate
+    double high = 0.0;       // Upper bound of 95% confidence interval of hashrate
+    double reported = 0.0;   // Average hashrate computed by the device(s)
+    double deviation = 0.0;  // Deviation of hashrate from reported (percent)
+};
+
 struct TelemetryAccountType
 {
     string prefix = "";
-    float hashrate = 0.0f;
+    float hashrate = 0.0f;          // Smoothed (EMA) hashrate
+    float hashrateRaw = 0.0f;       // Hashrate over the last collect interval
+    vector<float> hashrateWindows;  // Average hashrate over each configured window
     bool paused = false;
     HwSensorsType sensors;
     SolutionAccountType solutions;
-    unsigned long totalJobs;  // Total number of jobs received from WorkProvider(s)
+    unsigned long totalJobs = 0;  // Total number of jobs received from WorkProvider(s)
+    uint64_t switchTime = 0;        // Last measured job switch time (microseconds)
+    uint64_t restartTime = 0;       // Last measured restart to first hash time (microseconds)
+    vector<float> threadHashrates;  // Hashrate of each thread (only for grouped devices)
+    EffectiveHashRateType effective;
 };
 
 struct DeviceDescriptor
@@ -213,7 +257,11 @@ struct DeviceDescriptor
     unsigned int cuComputeMajor;
     unsigned int cuComputeMinor;
 
-    int cpCpuNumber;  // For CPU
+    int cpCpuNumber;             // For CPU
+    vector<unsigned> cpCpuList;  // For grouped CPU devices the logical processors
+                                 // driven by the same miner
+
+    bool smDetected = false;  // For synthetic devices
 
     bool isCompiler;  // Marks this device/thread eligible for compilation
                       // of ProgPoW kernels
@@ -245,6 +293,19 @@ struct TelemetryType
 
     TelemetryAccountType farm;
     std::vector<TelemetryAccountType> miners;
+
+    // Latency histograms (microseconds) cumulated since start
+    HistogramSnapshot responseTimes;  // From submission of a share to pool response
+    HistogramSnapshot verifyTimes;    // Host verification of solutions
+    HistogramSnapshot submitTimes;    // From find of a solution to hand over to the pool client
+    HistogramSnapshot switchTimes;    // From job assignment to first hash (all miners)
+    HistogramSnapshot dispatchTimes;  // Fan out of a job to all miners
+    HistogramSnapshot collectTimes;   // Build of a telemetry snapshot
+
+    float submitRate = 0.0f;  // Solutions handed over to the pool client per second
+
+    unsigned long restarts = 0;     // Restarts since start
+    unsigned long hotRestarts = 0;  // Of which keeping devices set up
     std::string str()
     {
         std::stringstream _ret;
@@ -291,9 +352,13 @@ struct TelemetryType
 
         int i = -1;                 // Current miner index
         int m = miners.size() - 1;  // Max miner index
+        while (m >= 0 && miners[m].prefix.empty())
+            m--;
         for (TelemetryAccountType miner : miners)
         {
             i++;
+            if (miner.prefix.empty())  // Removed miner
+                continue;
             hr = miner.hashrate;
             if (hr > 0.0f)
                 hr /= pow(1000.0f, magnitude);
@@ -317,6 +382,16 @@ struct TelemetryType
 };
 
 
+// Range of nonces assigned to a miner. A length of 0 means unbounded
+struct NonceSegment
+{
+    NonceSegment() = default;
+    NonceSegment(uint64_t _start, uint64_t _length) : start(_start), length(_length) {}
+
+    uint64_t start = 0;
+    uint64_t length = 0;
+};
+
 /**
  * @brief Class for hosting one or more Miners.
  * @warning Must be implemented in a threadsafe manner since it will be called from multiple
@@ -335,17 +410,41 @@ public:
     /**
      * @brief Called from a Miner to note a WorkPackage has a solution.
      * @param _p The solution.
-     * @return true iff the solution was good (implying that mining should be .
      */
-    virtual void submitProof(Solution const& _p) = 0;
+    virtual void submitProof(SolutionRecord const& _p) = 0;
     virtual void accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accounting) = 0;
     virtual uint64_t get_nonce_scrambler() = 0;
     virtual unsigned get_segment_width() = 0;
 
+    /**
+     * @brief Called from a Miner which has exhausted its nonce segment.
+     * @param _header Header of the job the miner is working on
+     * @param _segment Receives the new segment
+     * @return false if the job is no longer current or no space is left
+     */
+    virtual bool refillNonceSegment(unsigned _minerIdx, h256 const& _header, NonceSegment& _segment) = 0;
+
+    /**
+     * @brief Whether a miner runs at _minerIdx (miners may be removed at runtime)
+     */
+    virtual bool hasMiner(unsigned _minerIdx) = 0;
+
 private:
     static FarmFace* m_this;
 };
 
+/**
+ * @brief Latest work assigned to a miner.
+ * Published as an immutable snapshot so the miner thread can pick it up
+ * without taking any lock.
+ */
+struct MinerWorkSlot
+{
+    WorkPackage work;
+    uint64_t generation = 0;                         // Value of the miner's work generation
+    std::chrono::steady_clock::time_point assigned;  // When setWork() published it
+};
+
 /**
  * @brief A miner - a member and adoptee of the Farm.
  * @warning Not threadsafe. It is assumed Farm will synchronise calls to/from this class.
@@ -362,10 +461,17 @@ public:
     static void setDagLoadInfo(unsigned _mode, unsigned _devicecount)
     {
         s_dagLoadMode = _mode;
-        s_dagLoadIndex = 0;
+        s_dagLoadIndex.store(0);
         s_minersCount = _devicecount;
     };
 
+    // Passes the turn to load DAG of a removed miner to the next one
+    static void skipDagLoad(unsigned _index);
+
+    // Lets the first DAG of a miner added at runtime load without
+    // waiting for its turn. To be called before startWorking()
+    void loadDagOutOfTurn() { m_dagLoadOutOfTurn = true; }
+
     /**
      * @brief Gets the device descriptor assigned to this instance
      */
@@ -390,6 +496,24 @@ public:
     // Stop worker thread; causes call to stopWorking() and waits till thread has stopped.
     void stopWorking() override;
 
+    /**
+     * @brief Stops the worker thread keeping device, DAG and loaded ProgPoW
+     * kernel resident so the next startWorking() resumes hashing at once
+     */
+    void hotStopWorking();
+
+    /**
+     * @brief Releases device, DAG and loaded kernel kept by a hot stop as
+     * a cold stop would have. Only while the worker thread is stopped
+     */
+    void releaseResident();
+
+    /**
+     * @brief Starts timing a restart. Time till the first hash is then
+     * available through RetrieveRestartTime()
+     */
+    void markRestart() noexcept;
+
     /**
      * @brief Kick an asleep miner.
      */
@@ -422,10 +546,44 @@ public:
     void resume(MinerPauseEnum fromwhat);
 
     /**
-     * @brief Retrieves currrently collected hashrate
+     * @brief Retrieves the number of hashes computed since start
+     * Rates are estimated by the farm sampling this counter
+     */
+    uint64_t RetrieveHashCount() const noexcept { return m_hashCount.load(memory_order_relaxed); }
+
+    /**
+     * @brief Retrieves the last measured job switch time in microseconds
+     * i.e. the time elapsed from setWork() to the first hash on the new job
+     */
+    uint64_t RetrieveSwitchTime() noexcept { return m_workSwitchTime.load(memory_order_relaxed); }
+
+    /**
+     * @brief Retrieves the histogram of all measured job switch times
+     */
+    HistogramSnapshot RetrieveSwitchTimes() const { return m_workSwitchTimes.snapshot(); }
+
+    /**
+     * @brief Retrieves the last measured restart time in microseconds
+     * i.e. the time elapsed from markRestart() to the first hash
+     */
+    uint64_t RetrieveRestartTime() noexcept { return m_restartTime.load(memory_order_relaxed); }
+
+    /**
+     * @brief Retrieves hashrate of each hashing thread driven by this instance
+     * Empty if the instance drives a single thread
+     */
+    virtual vector<float> RetrieveThreadHashRates() { return vector<float>(); }
+
+    /**
+     * @brief Number of ProgPoW period kernels ready ahead of the active period
      */
-    float RetrieveHashRate() noexcept;
+    unsigned kernelsAhead() const noexcept;
 
+    /**
+     * @brief Farm generation of the job being searched (0 if none). Solutions
+     * on older jobs are queued before it changes
+     */
+    uint64_t searchGeneration() const noexcept { return m_searchGeneration.load(memory_order_acquire); }
 
 protected:
     /**
@@ -446,48 +604,80 @@ protected:
     // This is the effective miner Loop
     void minerLoop();
 
-    // Collects and averages (EMA) hashrate
-    void updateHashRate(uint32_t _hashes, uint64_t _microseconds) noexcept;
+    // Accounts the hashes computed since the previous call
+    void updateHashRate(uint64_t _hashes) noexcept;
+
+    // Records the time elapsed since the active job was assigned.
+    // To be called by derived classes right before the first hash
+    // on a new job
+    void updateSwitchTime() noexcept;
+
+    // Whether the device is still set up from before a hot stop. To be
+    // called once by derived classes at the start of workLoop()
+    bool resumeResident() noexcept;
+
+    // Has the next job load the ProgPoW kernel again as on a period
+    // change (eg. after a change of work sizes). Epoch and DAG are kept.
+    // Only while the worker thread is stopped
+    void forceKernelReload() noexcept { m_work_active.period = -1; }
+
+    // Returns _nonce if the _count nonces starting from it lie within
+    // _segment. Otherwise asks the farm to refill _segment and returns
+    // its new start (or _nonce if the farm has no space left)
+    uint64_t segmentNonce(NonceSegment& _segment, WorkPackage const& _work, uint64_t _nonce, uint64_t _count);
+
+    // Whether or not a newer job has been assigned after the active one
+    bool workObsolete() const noexcept
+    {
+        return m_work_generation.load(memory_order_relaxed) != m_work_active_generation;
+    }
 
     static unsigned s_minersCount;   // Total Number of Miners
     static unsigned s_dagLoadMode;   // Way dag should be loaded
-    static unsigned s_dagLoadIndex;  // In case of serialized load of dag this is the index of miner
-                                     // which should load next
+    static std::atomic<unsigned> s_dagLoadIndex;  // In case of serialized load of dag this is the index
+                                                  // of miner which should load next
+    bool m_dagLoadOutOfTurn = false;              // Next DAG loads regardless of s_dagLoadIndex
 
     const unsigned m_index = 0;           // Ordinal index of the Instance (not the device)
     DeviceDescriptor m_deviceDescriptor;  // Info about the device
 
     EpochContext m_epochContext;
 
-#ifdef _DEVELOPER
-    std::chrono::steady_clock::time_point m_workSwitchStart;
-#endif
+    std::chrono::steady_clock::time_point m_workActiveSwitchStart;  // Time the active job was assigned
+    std::atomic<uint64_t> m_workSwitchTime = {0};                   // Last measured job switch time (us)
+    LatencyHistogram m_workSwitchTimes;                             // All measured job switch times (us)
+
+    std::atomic<bool> m_keepResident = {false};  // Set by hotStopWorking()
+    bool m_resident = false;                     // Worker thread exited keeping device set up
+    std::atomic<int64_t> m_restartMark = {0};    // steady_clock ticks of markRestart() (0 = none)
+    std::atomic<uint64_t> m_restartTime = {0};   // Last measured restart time (us)
 
     HwMonitorInfo m_hwmoninfo;
-    mutable boost::mutex x_work;
     mutable boost::mutex x_pause;
 
-    std::unique_ptr<std::thread> m_compilerThread;  // Background thread for ProgPoW kernel
-                                                    // compilation
-
     atomic<bool> m_new_work = {false};
-    boost::condition_variable m_new_work_signal;
-    boost::condition_variable m_dag_loaded_signal;
-
-    WorkPackage m_work_latest, m_work_active;
+    Futex m_new_work_signal;       // Bumped by kick_miner() to wake the miner thread
+    static Futex s_dagLoadSignal;  // Bumped on each advance of s_dagLoadIndex
+
+    // Single writer (Farm) work slot. Always accessed through
+    // std::atomic_load / std::atomic_store
+    std::shared_ptr<const MinerWorkSlot> m_work_latest;
+    WorkPackage m_work_active;
+    std::atomic<uint64_t> m_work_generation = {0};  // Incremented on each setWork
+    uint64_t m_work_active_generation = 0;          // Generation of m_work_active
+    std::atomic<uint64_t> m_searchGeneration = {0};  // Farm generation of m_work_active while searching it
     uint64_t m_current_target = 0;
 
-    std::chrono::steady_clock::time_point m_workSearchStart;  // Actual start point of hashing time
-    uint64_t m_workSearchDuration = 0;                        // Total search duration on a job
-    uint32_t m_workHashes;                                    // Total hashes processed on a job
-
-    void invokeAsyncCompile(uint32_t _seed, bool _wait = false);      // Async ProgPoW compilation
-    std::atomic<bool> m_progpow_kernel_compile_inprogress = {false};  // Flag signalling background
-                                                                      // compile in progress
-    std::atomic<uint32_t> m_progpow_kernel_latest = {0U};             // Holds the highest kernel period in
-                                                                      // cache
+    void invokeAsyncCompile(uint32_t _seed, bool _wait = false);  // Async ProgPoW compilation
+    void compileAhead(uint32_t _period);  // Queues compilation of the periods following _period
+    std::atomic<uint32_t> m_progpow_kernel_latest = {0U};  // Holds the highest kernel period in
+                                                           // cache
+    std::atomic<uint32_t> m_progpow_kernel_active = {0U};  // Period of the active work
 
 private:
+    // Hands the turn to load DAG to the first miner after _index
+    static void advanceDagLoad(unsigned _index);
+
     bitset<MinerPauseEnum::Pause_MAX> m_pauseFlags;
 
 
@@ -497,8 +687,14 @@ private:
     virtual bool loadProgPoWKernel(uint32_t _seed) = 0;                        // Effectively loads the kernel into GPU
     virtual void unloadProgPoWKernel(){};
 
-    std::atomic<float> m_hr = {0.0};
-    std::atomic<bool> m_hrLive = {false};
+    // Releases from the calling thread what a hot stop kept resident
+    virtual void releaseDevice() { unloadProgPoWKernel(); }
+
+    // Identifies the kernels this miner can share with others (backend and
+    // device class) so equal compile requests are merged
+    virtual std::string compileKey() { return m_deviceDescriptor.uniqueId; }
+
+    std::atomic<uint64_t> m_hashCount = {0};  // Hashes computed since start
 };
 
 }  // namespace eth
@@ -46,6 +46,7 @@ struct Session
     string sessionId = "";
     string workerId = "";
     unsigned int epoch = 0;
+    bool resume = false;  // Whether or not the server can resume the session
     chrono::steady_clock::time_point lastTxStamp = chrono::steady_clock::now();
 };
 
@@ -74,6 +75,19 @@ public:
     virtual bool isConnected() { return m_connected.load(memory_order_relaxed); }
     virtual bool isPendingState() { return false; }
 
+    // Whether or not the session just lost can be resumed by a new client
+    // of the same connection
+    virtual bool isResumable() { return false; }
+
+    // Marks the disconnection about to be requested as deliberate (eg. a
+    // switch to another connection) rather than a failure of the pool
+    void setDeliberateDisconnect() { m_deliberateDisconnect.store(true, memory_order_relaxed); }
+    bool isDeliberateDisconnect() { return m_deliberateDisconnect.load(memory_order_relaxed); }
+
+    // Whether or not the client is a standby one nothing is mined on
+    void setStandby(bool _standby) { m_standby.store(_standby, memory_order_relaxed); }
+    bool isStandby() { return m_standby.load(memory_order_relaxed); }
+
     virtual bool isSubscribed() { return (m_session ? m_session->subscribed.load(memory_order_relaxed) : false); }
     virtual bool isAuthorized() { return (m_session ? m_session->authorized.load(memory_order_relaxed) : false); }
 
@@ -98,6 +112,8 @@ protected:
     unique_ptr<Session> m_session = nullptr;
 
     std::atomic<bool> m_connected = {false};  // This is related to socket ! Not session
+    std::atomic<bool> m_deliberateDisconnect = {false};
+    std::atomic<bool> m_standby = {false};
 
     boost::asio::ip::basic_endpoint<boost::asio::ip::tcp> m_endpoint;
 
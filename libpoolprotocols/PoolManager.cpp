@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <chrono>
 
+#include <libdevcore/Target.h>
+
 #include "PoolManager.h"
 
 using namespace std;
@@ -18,13 +21,13 @@ PoolManager::PoolManager(PoolSettings _settings)
 
     m_currentWp.header = h256();
 
-    Farm::f().onMinerRestart([&]() {
-        cnote << "Restart miners...";
+    Farm::f().onMinerRestart([&](bool _hot) {
+        cnote << (_hot ? "Hot restart miners..." : "Restart miners...");
 
         if (Farm::f().isMining())
         {
             cnote << "Shutting down miners...";
-            Farm::f().stop();
+            Farm::f().stop(_hot);
         }
 
         cnote << "Spinning up miners...";
@@ -50,70 +53,47 @@ PoolManager::PoolManager(PoolSettings _settings)
     });
 }
 
-void PoolManager::setClientHandlers()
+void PoolManager::setClientHandlers(PoolClient* _client)
 {
-    p_client->onConnected([&]() {
-        {
-            // If HostName is already an IP address no need to append the
-            // effective ip address.
-            if (p_client->getConnection()->HostNameType() == dev::UriHostNameType::Dns ||
-                p_client->getConnection()->HostNameType() == dev::UriHostNameType::Basic)
-            {
-                string ep = p_client->ActiveEndPoint();
-                if (!ep.empty())
-                    m_selectedHost = p_client->getConnection()->Host() + " " + ep;
-            }
-
-            cnote << "Established connection to " << m_selectedHost;
-
-            // Reset current WorkPackage
-            m_currentWp.job.clear();
-            m_currentWp.header = h256();
-
-            // Rough implementation to return to primary pool
-            // after specified amount of time
-            if (m_activeConnectionIdx != 0 && m_Settings.poolFailoverTimeout)
-            {
-                m_failovertimer.expires_from_now(boost::posix_time::minutes(m_Settings.poolFailoverTimeout));
-                m_failovertimer.async_wait(m_io_strand.wrap(
-                    boost::bind(&PoolManager::failovertimer_elapsed, this, boost::asio::placeholders::error)));
-            }
-            else
-            {
-                m_failovertimer.cancel();
-            }
-        }
+    _client->onConnected([this, _client]() {
+        if (standbyConnected(_client))
+            return;
 
-        if (!Farm::f().isMining())
+        // If HostName is already an IP address no need to append the
+        // effective ip address.
+        if (p_client->getConnection()->HostNameType() == dev::UriHostNameType::Dns ||
+            p_client->getConnection()->HostNameType() == dev::UriHostNameType::Basic)
         {
-            cnote << "Spinning up miners...";
-            Farm::f().start();
-        }
-        else if (Farm::f().paused())
-        {
-            cnote << "Resume mining ...";
-            Farm::f().resume();
+            string ep = p_client->ActiveEndPoint();
+            if (!ep.empty())
+                m_selectedHost = p_client->getConnection()->Host() + " " + ep;
         }
 
-        // Activate timing for HR submission
-        if (m_Settings.reportHashrate)
-        {
-            m_submithrtimer.expires_from_now(boost::posix_time::seconds(m_Settings.hashRateInterval));
-            m_submithrtimer.async_wait(m_io_strand.wrap(
-                boost::bind(&PoolManager::submithrtimer_elapsed, this, boost::asio::placeholders::error)));
-        }
+        cnote << "Established connection to " << m_selectedHost;
 
-        // Signal async operations have completed
-        m_async_pending.store(false, std::memory_order_relaxed);
+        clientActivated();
     });
 
-    p_client->onDisconnected([&]() {
+    _client->onDisconnected([this, _client]() {
+        if (standbyDisconnected(_client))
+            return;
+
         cnote << "Disconnected from " << m_selectedHost;
 
+        // Connections which failed or dropped are backed off by failover
+        if (!m_stopping.load(std::memory_order_relaxed) && !p_client->isDeliberateDisconnect())
+            p_client->getConnection()->Stats().accountFailure();
+
+        // Session may be resumed by next client of the same connection
+        m_resumeConn = p_client->isResumable() ? p_client->getConnection() : nullptr;
+
         // Clear current connection
         p_client->unsetConnection();
         m_currentWp.header = h256();
 
+        // Submitted shares won't be answered any more
+        Farm::f().clearPendingShares();
+
         // Stop timing actors
         m_failovertimer.cancel();
         m_submithrtimer.cancel();
@@ -132,85 +112,166 @@ void PoolManager::setClientHandlers()
             // Signal we will reconnect async
             m_async_pending.store(true, std::memory_order_relaxed);
 
-            // Suspend mining and submit new connection request
-            cnote << "No connection. Suspend mining ...";
-            Farm::f().pause();
+            // Keep miners busy if a standby connection can take over
+            // right away or the session can be resumed, else suspend mining
+            bool ready = bool(m_resumeConn);
+            {
+                Guard l(x_standby);
+                for (auto const& s : m_standby)
+                    ready = ready || (!s->retiring && s->client && s->client->isConnected() && s->wp);
+            }
+            if (!ready)
+            {
+                cnote << "No connection. Suspend mining ...";
+                Farm::f().pause();
+            }
+
+            // Submit new connection request
             g_io_service.post(m_io_strand.wrap(boost::bind(&PoolManager::rotateConnect, this)));
         }
     });
 
-    p_client->onWorkReceived([&](WorkPackage const& wp) {
+    _client->onWorkReceived([this, _client](WorkPackage const& wp) {
         // Should not happen !
         if (!wp)
             return;
 
-        int _currentEpoch = m_currentWp.epoch;
+        if (auto conn = _client->getConnection())
+            conn->Stats().accountSuccess();
 
-        bool newEpoch = (_currentEpoch == -1);
-        bool newBlock = (wp.block != -1 && wp.block != m_currentWp.block);
-        bool newDiff = (wp.boundary != m_currentWp.boundary);
+        if (standbyWorkReceived(_client, wp))
+            return;
 
-        // In EthereumStratum/2.0.0 epoch number is set in session
-        if (!newEpoch)
-        {
-            if (p_client->getConnection()->StratumMode() == 3)
-            {
-                newEpoch = (wp.epoch != m_currentWp.epoch);
-            }
-            else
-            {
-                if (wp.block != -1)
-                    newEpoch = ((wp.block / 30000) != m_currentWp.epoch);
-                else
-                    newEpoch = (wp.seed != m_currentWp.seed);
-            }
-        }
+        workReceived(wp);
+    });
 
-        m_currentWp = wp;
+    _client->onSolutionAccepted(
+        [this, _client](std::chrono::milliseconds const& _responseDelay, unsigned const& _minerIdx, bool _asStale) {
+            cnote << EthLime "**Accepted " << (_asStale ? "stale " : "") << EthReset << _responseDelay.count()
+                  << " ms. " << m_selectedHost;
+            Farm::f().accountResponseTime(_responseDelay);
+            Farm::f().accountSolution(_minerIdx, SolutionAccountingEnum::Accepted, _asStale);
+            if (auto conn = _client->getConnection())
+                conn->Stats().accountShare(true, _asStale);
+        });
 
-        if (newEpoch)
-        {
-            m_epochChanges.fetch_add(1, std::memory_order_relaxed);
+    _client->onSolutionRejected(
+        [this, _client](std::chrono::milliseconds const& _responseDelay, unsigned const& _minerIdx) {
+            cwarn << EthRed "**Rejected " EthReset << _responseDelay.count() << " ms. " << m_selectedHost;
+            Farm::f().accountResponseTime(_responseDelay);
+            Farm::f().accountSolution(_minerIdx, SolutionAccountingEnum::Rejected);
+            if (auto conn = _client->getConnection())
+                conn->Stats().accountShare(false, false);
+        });
+}
 
-            // If epoch is valued in workpackage take it
-            if (wp.epoch == -1)
-            {
-                if (m_currentWp.block > 0)
-                    m_currentWp.epoch = m_currentWp.block / 30000;
-                else
-                    m_currentWp.epoch = ethash::find_epoch_number(ethash::hash256_from_bytes(m_currentWp.seed.data()));
-            }
+void PoolManager::clientActivated()
+{
+    // Reset current WorkPackage
+    m_currentWp.job.clear();
+    m_currentWp.header = h256();
+
+    // Rough implementation to return to primary pool
+    // after specified amount of time
+    if (m_activeConnectionIdx != 0 && m_Settings.poolFailoverTimeout)
+    {
+        m_failovertimer.expires_from_now(boost::posix_time::minutes(m_Settings.poolFailoverTimeout));
+        m_failovertimer.async_wait(
+            m_io_strand.wrap(boost::bind(&PoolManager::failovertimer_elapsed, this, boost::asio::placeholders::error)));
+    }
+    else
+    {
+        m_failovertimer.cancel();
+    }
+
+    if (!Farm::f().isMining())
+    {
+        cnote << "Spinning up miners...";
+        Farm::f().start();
+    }
+    else if (Farm::f().paused())
+    {
+        cnote << "Resume mining ...";
+        Farm::f().resume();
+    }
+
+    // Activate timing for HR submission
+    if (m_Settings.reportHashrate)
+    {
+        m_submithrtimer.expires_from_now(boost::posix_time::seconds(m_Settings.hashRateInterval));
+        m_submithrtimer.async_wait(
+            m_io_strand.wrap(boost::bind(&PoolManager::submithrtimer_elapsed, this, boost::asio::placeholders::error)));
+    }
+
+    // Signal async operations have completed
+    m_async_pending.store(false, std::memory_order_relaxed);
+
+    // Standby connections follow the active one
+    if (m_Settings.standbyConnections)
+        g_io_service.post(m_io_strand.wrap(boost::bind(&PoolManager::refreshStandby, this)));
+}
+
+void PoolManager::workReceived(WorkPackage const& wp)
+{
+    int _currentEpoch = m_currentWp.epoch;
+
+    bool newEpoch = (_currentEpoch == -1);
+    bool newBlock = (wp.block != -1 && wp.block != m_currentWp.block);
+    bool newDiff = (wp.boundary != m_currentWp.boundary);
+
+    // Shares of previous block or of another connection are
+    // stale anyway, even if the pool did not flag clean jobs
+    bool cleanJobs = (wp.cleanJobs || newBlock || !m_currentWp);
+
+    // In EthereumStratum/2.0.0 epoch number is set in session
+    if (!newEpoch)
+    {
+        if (p_client->getConnection()->StratumMode() == 3)
+        {
+            newEpoch = (wp.epoch != m_currentWp.epoch);
         }
         else
         {
-            m_currentWp.epoch = _currentEpoch;
+            if (wp.block != -1)
+                newEpoch = ((wp.block / 30000) != m_currentWp.epoch);
+            else
+                newEpoch = (wp.seed != m_currentWp.seed);
         }
+    }
+
+    m_currentWp = wp;
+    m_currentWp.cleanJobs = cleanJobs;
 
-        if (newDiff && m_Settings.minDiff)
+    if (newEpoch)
+    {
+        m_epochChanges.fetch_add(1, std::memory_order_relaxed);
+
+        // If epoch is valued in workpackage take it
+        if (wp.epoch == -1)
         {
-            double d = dev::getDiffFromTarget(m_currentWp.boundary.hex(HexPrefix::Add));
-            if (d < m_Settings.minDiff)
-                m_currentWp.boundary = h256(dev::getTargetFromDiff(m_Settings.minDiff, HexPrefix::Add));
+            if (m_currentWp.block > 0)
+                m_currentWp.epoch = m_currentWp.block / 30000;
+            else
+                m_currentWp.epoch = ethash::find_epoch_number(ethash::hash256_from_bytes(m_currentWp.seed.data()));
         }
+    }
+    else
+    {
+        m_currentWp.epoch = _currentEpoch;
+    }
 
-        showMiningAt(newEpoch, newBlock, newDiff);
+    if (newDiff && m_Settings.minDiff)
+    {
+        double d = dev::targetToDiff(m_currentWp.boundary);
+        if (d < m_Settings.minDiff)
+            m_currentWp.boundary = dev::diffToTarget(m_Settings.minDiff);
+    }
 
-        cnote << "Job: " EthWhite << m_currentWp.header.abridged() << EthReset << " " << m_selectedHost;
+    showMiningAt(newEpoch, newBlock, newDiff);
 
-        Farm::f().setWork(m_currentWp);
-    });
+    cnote << "Job: " EthWhite << m_currentWp.header.abridged() << EthReset << " " << m_selectedHost;
 
-    p_client->onSolutionAccepted(
-        [&](std::chrono::milliseconds const& _responseDelay, unsigned const& _minerIdx, bool _asStale) {
-            cnote << EthLime "**Accepted " << (_asStale ? "stale " : "") << EthReset << _responseDelay.count()
-                  << " ms. " << m_selectedHost;
-            Farm::f().accountSolution(_minerIdx, SolutionAccountingEnum::Accepted);
-        });
-
-    p_client->onSolutionRejected([&](std::chrono::milliseconds const& _responseDelay, unsigned const& _minerIdx) {
-        cwarn << EthRed "**Rejected " EthReset << _responseDelay.count() << " ms. " << m_selectedHost;
-        Farm::f().accountSolution(_minerIdx, SolutionAccountingEnum::Rejected);
-    });
+    Farm::f().setWork(m_currentWp);
 }
 
 void PoolManager::stop()
@@ -220,8 +281,15 @@ void PoolManager::stop()
         m_async_pending.store(true, std::memory_order_relaxed);
         m_stopping.store(true, std::memory_order_relaxed);
 
+        {
+            Guard l(x_standby);
+            for (auto const& s : m_standby)
+                g_io_service.post(m_io_strand.wrap([this, s]() { retireStandby(s); }));
+        }
+
         if (p_client && p_client->isConnected())
         {
+            p_client->setDeliberateDisconnect();
             p_client->disconnect();
             // Wait for async operations to complete
             while (m_running.load(std::memory_order_relaxed))
@@ -278,6 +346,9 @@ void PoolManager::removeConnection(unsigned int idx)
     m_Settings.connections.erase(m_Settings.connections.begin() + idx);
     if (m_activeConnectionIdx > idx)
         m_activeConnectionIdx--;
+
+    if (m_Settings.standbyConnections)
+        g_io_service.post(m_io_strand.wrap(boost::bind(&PoolManager::refreshStandby, this)));
 }
 
 void PoolManager::setActiveConnectionCommon(unsigned int idx)
@@ -292,6 +363,7 @@ void PoolManager::setActiveConnectionCommon(unsigned int idx)
         m_connectionSwitches.fetch_add(1, std::memory_order_relaxed);
         m_activeConnectionIdx = idx;
         m_connectionAttempt = 0;
+        p_client->setDeliberateDisconnect();
         p_client->disconnect();
     }
     else
@@ -340,6 +412,23 @@ std::shared_ptr<URI> PoolManager::getActiveConnection()
     }
 }
 
+// Renders round trip times. Values are in microseconds
+static Json::Value rttToJson(HistogramSnapshot const& _h)
+{
+    Json::Value jRes;
+    jRes["count"] = Json::UInt64(_h.count);
+    jRes["min"] = Json::UInt64(_h.min);
+    jRes["mean"] = Json::UInt64(_h.mean());
+    jRes["max"] = Json::UInt64(_h.max);
+
+    Json::Value percentiles = Json::Value(Json::arrayValue);
+    percentiles.append(Json::UInt64(_h.percentile(50)));
+    percentiles.append(Json::UInt64(_h.percentile(90)));
+    percentiles.append(Json::UInt64(_h.percentile(99)));
+    jRes["percentiles"] = percentiles;
+    return jRes;
+}
+
 Json::Value PoolManager::getConnectionsJson()
 {
     // Returns the list of configured connections
@@ -350,8 +439,55 @@ Json::Value PoolManager::getConnectionsJson()
         JConn["index"] = (unsigned)i;
         JConn["active"] = (i == m_activeConnectionIdx ? true : false);
         JConn["uri"] = m_Settings.connections[i]->str();
+
+        PoolStats& stats = m_Settings.connections[i]->Stats();
+        Json::Value latency;
+        latency["subscribe"] = rttToJson(stats.rtt(PoolRequest::Subscribe));
+        latency["authorize"] = rttToJson(stats.rtt(PoolRequest::Authorize));
+        latency["submit"] = rttToJson(stats.rtt(PoolRequest::Submit));
+        latency["hashrate"] = rttToJson(stats.rtt(PoolRequest::Hashrate));
+        JConn["latency"] = latency;
+
+        Json::Value shares;
+        shares["accepted"] = Json::UInt64(stats.accepted());
+        shares["rejected"] = Json::UInt64(stats.rejected());
+        shares["stale"] = Json::UInt64(stats.stale());
+        JConn["shares"] = shares;
+        JConn["stalerate"] = stats.staleRate();
+        JConn["score"] = stats.score();
+        JConn["failures"] = Json::UInt64(stats.failures());
+        JConn["backoff"] = chrono::duration<double>(stats.backoff()).count();
+
+        if (m_Settings.connections[i]->SecLevel() != SecureLevel::NONE)
+        {
+            Json::Value tls;
+            tls["handshake"] = rttToJson(stats.handshakes());
+            tls["resumed"] = Json::UInt64(stats.resumedHandshakes());
+            tls["full"] = Json::UInt64(stats.fullHandshakes());
+            JConn["tls"] = tls;
+        }
+        if (m_Settings.connections[i]->Family() == ProtocolFamily::STRATUM)
+        {
+            Json::Value sessions;
+            sessions["resumed"] = Json::UInt64(stats.resumedSessions());
+            sessions["fresh"] = Json::UInt64(stats.freshSessions());
+            JConn["sessions"] = sessions;
+        }
+        if (m_Settings.standbyConnections)
+            JConn["standby"] = false;
         jRes.append(JConn);
     }
+
+    // Standby connections holding a job, ready to take over
+    Guard l(x_standby);
+    for (auto const& s : m_standby)
+    {
+        if (s->retiring || !s->client || !s->client->isConnected() || !s->wp)
+            continue;
+        for (size_t i = 0; i < m_Settings.connections.size(); i++)
+            if (m_Settings.connections[i] == s->conn)
+                jRes[(unsigned)i]["standby"] = true;
+    }
     return jRes;
 }
 
@@ -368,6 +504,10 @@ void PoolManager::rotateConnect()
     if (p_client && p_client->isConnected())
         return;
 
+    // Switch to a standby connection ready to take over if any
+    if (promoteStandby())
+        return;
+
     // Check we're within bounds
     if (m_activeConnectionIdx >= m_Settings.connections.size())
         m_activeConnectionIdx = 0;
@@ -395,30 +535,33 @@ void PoolManager::rotateConnect()
         else
         {
             m_connectionAttempt = 0;
-            m_activeConnectionIdx++;
-            if (m_activeConnectionIdx >= m_Settings.connections.size())
-                m_activeConnectionIdx = 0;
+            m_activeConnectionIdx = nextConnection();
             m_connectionSwitches.fetch_add(1, std::memory_order_relaxed);
         }
     }
 
+    // Miners were left running for a standby which is gone meanwhile or
+    // for a session to resume on another connection
+    bool resuming = !m_Settings.connections.empty() && m_Settings.connections.at(m_activeConnectionIdx) == m_resumeConn;
+    m_resumeConn = nullptr;
+    if (!resuming && Farm::f().isMining() && !Farm::f().paused())
+    {
+        cnote << "No connection. Suspend mining ...";
+        Farm::f().pause();
+    }
+
     if (!m_Settings.connections.empty() && m_Settings.connections.at(m_activeConnectionIdx)->Host() != "exit")
     {
+        // A standby connection to the same pool would share its definition
+        retireStandby(m_Settings.connections.at(m_activeConnectionIdx));
+
         if (p_client)
             p_client = nullptr;
 
-        if (m_Settings.connections.at(m_activeConnectionIdx)->Family() == ProtocolFamily::GETWORK)
-            p_client = std::unique_ptr<PoolClient>(
-                new EthGetworkClient(m_Settings.noWorkTimeout, m_Settings.getWorkPollInterval));
-        if (m_Settings.connections.at(m_activeConnectionIdx)->Family() == ProtocolFamily::STRATUM)
-            p_client = std::unique_ptr<PoolClient>(
-                new EthStratumClient(m_Settings.noWorkTimeout, m_Settings.noResponseTimeout));
-        if (m_Settings.connections.at(m_activeConnectionIdx)->Family() == ProtocolFamily::SIMULATION)
-            p_client = std::unique_ptr<PoolClient>(
-                new SimulateClient(m_Settings.benchmarkBlock, m_Settings.benchmarkDiff, m_Settings.benchmarkVarDiff));
+        p_client = std::unique_ptr<PoolClient>(createClient(m_Settings.connections.at(m_activeConnectionIdx)));
 
         if (p_client)
-            setClientHandlers();
+            setClientHandlers(p_client.get());
 
         // Count connectionAttempts
         m_connectionAttempt++;
@@ -450,6 +593,334 @@ void PoolManager::rotateConnect()
     }
 }
 
+/*
+ * Gets the connection to rotate to after the active one failed, skipping
+ * the ones backing off after failures unless all of them do. With the
+ * latency policy the 'exit' directive only bounds the connections taken
+ * into account.
+ */
+unsigned PoolManager::nextConnection()
+{
+    unsigned next = m_activeConnectionIdx + 1;
+    if (next >= m_Settings.connections.size())
+        next = 0;
+    if (m_Settings.failoverPolicy != FAILOVER_POLICY_LATENCY)
+    {
+        for (unsigned i = next; i != m_activeConnectionIdx; i = (i + 1) % m_Settings.connections.size())
+        {
+            auto const& conn = m_Settings.connections[i];
+            if (conn->Host() == "exit" || conn->Stats().backoff() == chrono::steady_clock::duration::zero())
+                return i;
+        }
+        return next;
+    }
+
+    unsigned best = next;
+    bool found = false;
+    for (unsigned i = 0; i < m_Settings.connections.size(); i++)
+    {
+        if (m_Settings.connections[i]->Host() == "exit")
+            break;
+        if (i == m_activeConnectionIdx)
+            continue;
+        if (!found || preferredConnection(i, best))
+        {
+            best = i;
+            found = true;
+        }
+    }
+    return best;
+}
+
+// Whether or not connection _a is preferred to _b by the failover policy.
+// Connections backing off after failures come last, the one to be tried
+// again first ahead. Connections nothing is known about come after the
+// others in list order
+bool PoolManager::preferredConnection(unsigned _a, unsigned _b)
+{
+    auto backoffA = m_Settings.connections[_a]->Stats().backoff();
+    auto backoffB = m_Settings.connections[_b]->Stats().backoff();
+    if (backoffA != backoffB)
+        return backoffA < backoffB;
+
+    if (m_Settings.failoverPolicy == FAILOVER_POLICY_LATENCY)
+    {
+        double a = m_Settings.connections[_a]->Stats().score();
+        double b = m_Settings.connections[_b]->Stats().score();
+        if ((a >= 0.0) != (b >= 0.0))
+            return a >= 0.0;
+        if (a != b)
+            return a < b;
+    }
+    return _a < _b;
+}
+
+PoolClient* PoolManager::createClient(std::shared_ptr<URI> const& _conn)
+{
+    if (_conn->Family() == ProtocolFamily::GETWORK)
+        return new EthGetworkClient(m_Settings.noWorkTimeout, m_Settings.getWorkPollInterval);
+    if (_conn->Family() == ProtocolFamily::STRATUM)
+        return new EthStratumClient(m_Settings.noWorkTimeout, m_Settings.noResponseTimeout);
+    if (_conn->Family() == ProtocolFamily::SIMULATION)
+        return new SimulateClient(m_Settings.benchmarkBlock, m_Settings.benchmarkDiff, m_Settings.benchmarkVarDiff);
+    return nullptr;
+}
+
+/*
+ * Replaces the (disconnected) active client with a standby one holding a
+ * job. Standby of the connection selected as active is preferred, else the
+ * best one for the failover policy. Returns false if none is ready.
+ */
+bool PoolManager::promoteStandby()
+{
+    if (!m_Settings.standbyConnections || m_stopping.load(std::memory_order_relaxed))
+        return false;
+
+    std::unique_ptr<PoolClient> old;
+    {
+        Guard l(x_standby);
+
+        auto selected = m_standby.end();
+        unsigned selectedIdx = 0;
+        for (auto it = m_standby.begin(); it != m_standby.end(); it++)
+        {
+            auto const& s = *it;
+            if (s->retiring || !s->client || !s->client->isConnected() || !s->wp)
+                continue;
+
+            for (unsigned i = 0; i < m_Settings.connections.size(); i++)
+            {
+                if (m_Settings.connections[i] != s->conn)
+                    continue;
+                if (selected == m_standby.end() || i == m_activeConnectionIdx ||
+                    (selectedIdx != m_activeConnectionIdx && preferredConnection(i, selectedIdx)))
+                {
+                    selected = it;
+                    selectedIdx = i;
+                }
+                break;
+            }
+        }
+        if (selected == m_standby.end())
+            return false;
+
+        auto s = *selected;
+        m_standby.erase(selected);
+        s->timer.cancel();
+
+        old = std::move(p_client);
+        p_client = std::move(s->client);
+        p_client->setStandby(false);
+
+        if (selectedIdx != m_activeConnectionIdx)
+            m_connectionSwitches.fetch_add(1, std::memory_order_relaxed);
+        m_activeConnectionIdx = selectedIdx;
+        m_connectionAttempt = 0;
+        m_selectedHost = s->host;
+
+        cnote << "Switched to standby connection " << m_selectedHost;
+
+        // Standby handlers no longer recognize the client as such, yet
+        // jobs it delivers meanwhile wait for the one held to be set
+        clientActivated();
+        workReceived(s->wp);
+    }
+
+    return true;
+}
+
+/*
+ * Keeps a standby connection to each of the first standbyConnections
+ * connections (other than the active one) and drops the others.
+ */
+void PoolManager::refreshStandby()
+{
+    std::vector<std::shared_ptr<URI>> wanted;
+    if (!m_stopping.load(std::memory_order_relaxed))
+    {
+        for (unsigned i = 0; i < m_Settings.connections.size(); i++)
+        {
+            if (wanted.size() == m_Settings.standbyConnections)
+                break;
+
+            auto const& conn = m_Settings.connections[i];
+            if (conn->Host() == "exit")
+                break;
+            if (i == m_activeConnectionIdx || conn->Family() == ProtocolFamily::SIMULATION ||
+                conn->IsUnrecoverable())
+                continue;
+            wanted.push_back(conn);
+        }
+    }
+
+    std::vector<std::shared_ptr<StandbyClient>> unwanted;
+    {
+        Guard l(x_standby);
+        for (auto const& s : m_standby)
+        {
+            if (s->retiring)
+                continue;
+            auto it = std::find(wanted.begin(), wanted.end(), s->conn);
+            if (it == wanted.end())
+                unwanted.push_back(s);
+            else
+                wanted.erase(it);
+        }
+    }
+
+    for (auto const& s : unwanted)
+        retireStandby(s);
+
+    for (auto const& conn : wanted)
+    {
+        auto s = std::make_shared<StandbyClient>();
+        s->conn = conn;
+        s->host = conn->Host() + ":" + to_string(conn->Port());
+        {
+            Guard l(x_standby);
+            m_standby.push_back(s);
+        }
+        cnote << "Selected standby pool " << s->host;
+        connectStandby(s);
+    }
+}
+
+void PoolManager::connectStandby(std::shared_ptr<StandbyClient> _standby)
+{
+    if (_standby->retiring || _standby->conn->IsUnrecoverable())
+    {
+        dropStandby(_standby);
+        return;
+    }
+
+    PoolClient* client = createClient(_standby->conn);
+    client->setStandby(true);
+    {
+        Guard l(x_standby);
+        _standby->client.reset(client);
+        _standby->wp = WorkPackage();
+        _standby->connecting = true;
+    }
+
+    setClientHandlers(client);
+    client->setConnection(_standby->conn);
+    client->connect();
+}
+
+void PoolManager::retireStandby(std::shared_ptr<StandbyClient> _standby)
+{
+    bool connecting;
+    {
+        Guard l(x_standby);
+        if (_standby->retiring)
+            return;
+        _standby->retiring = true;
+        connecting = _standby->connecting;
+    }
+
+    // Connected clients are dropped once disconnected. The ones still
+    // connecting are disconnected as soon as they get connected
+    if (_standby->client)
+        _standby->client->setDeliberateDisconnect();
+    if (!connecting)
+        dropStandby(_standby);
+    else if (_standby->client->isConnected())
+        _standby->client->disconnect();
+}
+
+void PoolManager::retireStandby(std::shared_ptr<URI> const& _conn)
+{
+    std::shared_ptr<StandbyClient> standby;
+    {
+        Guard l(x_standby);
+        for (auto const& s : m_standby)
+            if (s->conn == _conn && !s->retiring)
+                standby = s;
+    }
+    if (standby)
+        retireStandby(standby);
+}
+
+void PoolManager::dropStandby(std::shared_ptr<StandbyClient> _standby)
+{
+    _standby->timer.cancel();
+
+    Guard l(x_standby);
+    m_standby.remove(_standby);
+}
+
+bool PoolManager::standbyConnected(PoolClient* _client)
+{
+    std::shared_ptr<StandbyClient> standby;
+    bool retiring;
+    {
+        Guard l(x_standby);
+        for (auto const& s : m_standby)
+            if (s->client.get() == _client)
+                standby = s;
+        if (!standby)
+            return false;
+        retiring = standby->retiring;
+
+        string ep = _client->ActiveEndPoint();
+        if (!ep.empty() && (standby->conn->HostNameType() == dev::UriHostNameType::Dns ||
+                               standby->conn->HostNameType() == dev::UriHostNameType::Basic))
+            standby->host = standby->conn->Host() + " " + ep;
+    }
+
+    if (retiring)
+        g_io_service.post(m_io_strand.wrap([_client]() { _client->disconnect(); }));
+    else
+        cnote << "Established standby connection to " << standby->host;
+
+    return true;
+}
+
+bool PoolManager::standbyDisconnected(PoolClient* _client)
+{
+    Guard l(x_standby);
+
+    std::shared_ptr<StandbyClient> standby;
+    for (auto const& s : m_standby)
+        if (s->client.get() == _client)
+            standby = s;
+    if (!standby)
+        return false;
+
+    _client->unsetConnection();
+    standby->wp = WorkPackage();
+    standby->connecting = false;
+
+    // Client can't be released within its own handler
+    if (standby->retiring)
+    {
+        g_io_service.post(m_io_strand.wrap(boost::bind(&PoolManager::dropStandby, this, standby)));
+    }
+    else
+    {
+        standby->conn->Stats().accountFailure();
+        cnote << "Disconnected from standby " << standby->host << ". Retrying in 5 seconds ...";
+        standby->timer.expires_from_now(boost::posix_time::seconds(5));
+        standby->timer.async_wait(m_io_strand.wrap(
+            boost::bind(&PoolManager::standbytimer_elapsed, this, standby, boost::asio::placeholders::error)));
+    }
+
+    return true;
+}
+
+bool PoolManager::standbyWorkReceived(PoolClient* _client, WorkPackage const& wp)
+{
+    Guard l(x_standby);
+    for (auto const& s : m_standby)
+        if (s->client.get() == _client)
+        {
+            // Only the last job matters : nothing is mined on it
+            s->wp = wp;
+            return true;
+        }
+    return false;
+}
+
 void PoolManager::showMiningAt(bool _showEpoch, bool _showBlock, bool _showDiff)
 {
     if (!m_currentWp || (!_showEpoch && !_showBlock && !_showDiff))
@@ -462,9 +933,8 @@ void PoolManager::showMiningAt(bool _showEpoch, bool _showBlock, bool _showDiff)
         ss << "Block : " EthWhiteBold << m_currentWp.block << EthReset << " ";
     if (_showDiff)
     {
-        string t = m_currentWp.boundary.hex(HexPrefix::Add);
-        double h = dev::getHashesToTarget(t);
-        double i = dev::getDiffFromTarget(t);
+        double h = dev::targetToHashes(m_currentWp.boundary);
+        double i = dev::targetToDiff(m_currentWp.boundary);
         ss << "Difficulty : " EthWhiteBold << fixed << setprecision(5) << i << " = " << dev::getFormattedHashes(h)
            << EthReset;
     }
@@ -484,6 +954,7 @@ void PoolManager::failovertimer_elapsed(const boost::system::error_code& ec)
                 m_connectionAttempt = 0;
                 m_connectionSwitches.fetch_add(1, std::memory_order_relaxed);
                 cnote << "Failover timeout reached, retrying connection to primary pool";
+                p_client->setDeliberateDisconnect();
                 p_client->disconnect();
             }
         }
@@ -507,6 +978,12 @@ void PoolManager::submithrtimer_elapsed(const boost::system::error_code& ec)
     }
 }
 
+void PoolManager::standbytimer_elapsed(std::shared_ptr<StandbyClient> _standby, const boost::system::error_code& ec)
+{
+    if (!ec && m_running.load(std::memory_order_relaxed))
+        connectStandby(_standby);
+}
+
 int PoolManager::getCurrentEpoch()
 {
     return m_currentWp.epoch;
@@ -517,7 +994,7 @@ double PoolManager::getCurrentDifficulty()
     if (!m_currentWp)
         return 0.0;
 
-    return dev::getHashesToTarget(m_currentWp.boundary.hex(HexPrefix::Add));
+    return dev::targetToHashes(m_currentWp.boundary);
 }
 
 unsigned PoolManager::getConnectionSwitches()
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <iostream>
+#include <list>
 
 #include <json/json.h>
 
+#include <libdevcore/Guards.h>
 #include <libdevcore/Worker.h>
 #include <libethcore/Farm.h>
 #include <libethcore/Miner.h>
@@ -15,6 +17,9 @@
 
 using namespace std;
 
+#define FAILOVER_POLICY_ORDER 0    // Next connection in list order
+#define FAILOVER_POLICY_LATENCY 1  // Connection with the lowest submit latency and stale rate
+
 namespace dev
 {
 namespace eth
@@ -34,6 +39,8 @@ struct PoolSettings
     unsigned hashRateInterval = 60;      // Interval in seconds among hashrate submissions
     std::string hashRateId = h256::random().hex(HexPrefix::Add);  // Unique identifier for HashRate submission
     unsigned connectionMaxRetries = 3;                            // Max number of connection retries
+    unsigned standbyConnections = 0;  // Number of secondary connections kept ready to take over
+    unsigned failoverPolicy = FAILOVER_POLICY_ORDER;  // See FAILOVER_POLICY_*
     unsigned benchmarkBlock = 0;    // Block number used by SimulateClient to test performances
     double benchmarkDiff = 1.0;     // Difficulty used by SimulateClient to test performances
     bool benchmarkVarDiff = false;  // Optional to specify if Simulate client should randomize
@@ -63,9 +70,43 @@ public:
     unsigned getEpochChanges();
 
 private:
+    // A secondary connection kept subscribed, authorized and fed with jobs
+    // so that it can replace the active one without reconnecting
+    struct StandbyClient
+    {
+        StandbyClient() : timer(g_io_service) {}
+
+        std::shared_ptr<URI> conn;
+        std::unique_ptr<PoolClient> client = nullptr;
+        std::string host;                   // Host name (and endpoint)
+        WorkPackage wp;                     // Last job received
+        bool connecting = false;            // Whether or not a disconnection is still to be signalled
+        bool retiring = false;              // Whether or not it's being dropped
+        boost::asio::deadline_timer timer;  // Delays reconnections
+    };
+
     void rotateConnect();
 
-    void setClientHandlers();
+    unsigned nextConnection();
+    bool preferredConnection(unsigned _a, unsigned _b);
+
+    PoolClient* createClient(std::shared_ptr<URI> const& _conn);
+
+    void setClientHandlers(PoolClient* _client);
+
+    void clientActivated();
+
+    void workReceived(WorkPackage const& wp);
+
+    bool promoteStandby();
+    void refreshStandby();
+    void connectStandby(std::shared_ptr<StandbyClient> _standby);
+    void retireStandby(std::shared_ptr<StandbyClient> _standby);
+    void retireStandby(std::shared_ptr<URI> const& _conn);
+    void dropStandby(std::shared_ptr<StandbyClient> _standby);
+    bool standbyConnected(PoolClient* _client);
+    bool standbyDisconnected(PoolClient* _client);
+    bool standbyWorkReceived(PoolClient* _client, WorkPackage const& wp);
 
     void showMiningAt(bool _showEpoch, bool _showBlock, bool _showDiff);
 
@@ -75,6 +116,7 @@ private:
 
     void failovertimer_elapsed(const boost::system::error_code& ec);
     void submithrtimer_elapsed(const boost::system::error_code& ec);
+    void standbytimer_elapsed(std::shared_ptr<StandbyClient> _standby, const boost::system::error_code& ec);
 
     std::atomic<bool> m_running = {false};
     std::atomic<bool> m_stopping = {false};
@@ -86,6 +128,7 @@ private:
     std::atomic<unsigned> m_connectionSwitches = {0};
 
     unsigned m_activeConnectionIdx = 0;
+    std::shared_ptr<URI> m_resumeConn;  // Connection lost with a session left to resume
 
     WorkPackage m_currentWp;
 
@@ -95,6 +138,9 @@ private:
 
     std::unique_ptr<PoolClient> p_client = nullptr;
 
+    Mutex x_standby;  // Guards standby list and switches of p_client to a standby
+    std::list<std::shared_ptr<StandbyClient>> m_standby;
+
     std::atomic<unsigned> m_epochChanges = {0};
 
     static PoolManager* m_this;
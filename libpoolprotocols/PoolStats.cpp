@@ -0,0 +1,150 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <libpoolprotocols/PoolStats.h>
+
+using namespace std;
+using namespace dev;
+
+void PendingRequests::push(unsigned _id, bool _timed)
+{
+    Guard l(x_pending);
+    m_pending.push_back({_id, _timed, chrono::steady_clock::now()});
+}
+
+bool PendingRequests::pop(unsigned _id, chrono::steady_clock::duration& _elapsed)
+{
+    auto now = chrono::steady_clock::now();
+
+    Guard l(x_pending);
+    for (auto it = m_pending.begin(); it != m_pending.end(); it++)
+    {
+        if (it->id != _id)
+            continue;
+        _elapsed = now - it->sent;
+        m_pending.erase(it);
+        return true;
+    }
+    return false;
+}
+
+bool PendingRequests::oldest(chrono::steady_clock::time_point& _sent) const
+{
+    Guard l(x_pending);
+    for (auto const& r : m_pending)
+        if (r.timed)
+        {
+            _sent = r.sent;
+            return true;
+        }
+    return false;
+}
+
+bool PendingRequests::empty() const
+{
+    Guard l(x_pending);
+    return m_pending.empty();
+}
+
+void PendingRequests::clear()
+{
+    Guard l(x_pending);
+    m_pending.clear();
+}
+
+void PoolStats::recordRtt(PoolRequest _request, chrono::steady_clock::duration _rtt)
+{
+    auto us = chrono::duration_cast<chrono::microseconds>(_rtt).count();
+    m_rtt[unsigned(_request)].record(us > 0 ? uint64_t(us) : 0);
+}
+
+HistogramSnapshot PoolStats::rtt(PoolRequest _request) const
+{
+    return m_rtt[unsigned(_request)].snapshot();
+}
+
+void PoolStats::accountShare(bool _accepted, bool _stale)
+{
+    if (!_accepted)
+        m_rejected.fetch_add(1, memory_order_relaxed);
+    else if (_stale)
+        m_stale.fetch_add(1, memory_order_relaxed);
+    else
+        m_accepted.fetch_add(1, memory_order_relaxed);
+}
+
+void PoolStats::recordHandshake(chrono::steady_clock::duration _time, bool _resumed)
+{
+    auto us = chrono::duration_cast<chrono::microseconds>(_time).count();
+    m_handshakes.record(us > 0 ? uint64_t(us) : 0);
+    (_resumed ? m_resumed : m_full).fetch_add(1, memory_order_relaxed);
+}
+
+void PoolStats::accountSession(bool _resumed)
+{
+    (_resumed ? m_resumedSessions : m_freshSessions).fetch_add(1, memory_order_relaxed);
+}
+
+void PoolStats::accountFailure()
+{
+    m_lastFailure.store(chrono::steady_clock::now().time_since_epoch().count(), memory_order_relaxed);
+    m_consecutiveFailures.fetch_add(1, memory_order_relaxed);
+    m_failures.fetch_add(1, memory_order_relaxed);
+}
+
+void PoolStats::accountSuccess()
+{
+    m_consecutiveFailures.store(0, memory_order_relaxed);
+}
+
+chrono::steady_clock::duration PoolStats::backoff() const
+{
+    static const chrono::steady_clock::duration c_min = chrono::seconds(5);
+    static const chrono::steady_clock::duration c_max = chrono::minutes(5);
+
+    unsigned n = consecutiveFailures();
+    if (!n)
+        return chrono::steady_clock::duration::zero();
+
+    auto wait = std::min(c_min * (1 << std::min(n - 1, 6u)), c_max);
+    chrono::steady_clock::time_point until(
+        chrono::steady_clock::duration(m_lastFailure.load(memory_order_relaxed)) + wait);
+    auto now = chrono::steady_clock::now();
+    return until > now ? until - now : chrono::steady_clock::duration::zero();
+}
+
+double PoolStats::staleRate() const
+{
+    uint64_t bad = stale() + rejected();
+    uint64_t total = accepted() + bad;
+    return total ? double(bad) / double(total) : 0.0;
+}
+
+double PoolStats::score() const
+{
+    static const PoolRequest order[] = {PoolRequest::Submit, PoolRequest::Authorize, PoolRequest::Subscribe};
+
+    for (PoolRequest r : order)
+    {
+        HistogramSnapshot h = rtt(r);
+        if (h.count)
+            return double(h.percentile(50)) / 1000.0 + staleRate() * 10000.0 + consecutiveFailures() * 1000.0;
+    }
+    return -1.0;
+}
@@ -0,0 +1,148 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file PoolStats.h
+ * Round trip times and share outcomes of pool connections.
+ *
+ * Clients stamp each request with its send time under its Json id and take
+ * the stamp back when the response with that id arrives, so overlapping
+ * requests are timed each on its own. Round trips feed per connection
+ * histograms which outlive the client instances and drive the latency
+ * aware failover policy. TLS handshakes are timed the same way.
+ *
+ * Failed connections and sessions lost unexpectedly put the connection in
+ * a back-off doubling on each consecutive failure, during which failover
+ * prefers the other connections.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include <libdevcore/Guards.h>
+#include <libdevcore/Histogram.h>
+
+namespace dev
+{
+enum class PoolRequest : unsigned
+{
+    Subscribe = 0,  // First message of the session (subscribe, hello or login)
+    Authorize,
+    Submit,
+    Hashrate
+};
+
+// Requests waiting for a response. Ids may be reused while in flight (eg.
+// submissions are identified by miner) : responses are matched to the
+// oldest request with the same id
+class PendingRequests
+{
+public:
+    PendingRequests() { m_pending.reserve(64); }
+
+    // _timed requests count for the response timeout
+    void push(unsigned _id, bool _timed = true);
+
+    // Gets the time elapsed since the oldest request with _id was sent and
+    // removes it. False if no request with _id is pending
+    bool pop(unsigned _id, std::chrono::steady_clock::duration& _elapsed);
+
+    // Send time of the oldest timed request. False if none
+    bool oldest(std::chrono::steady_clock::time_point& _sent) const;
+
+    bool empty() const;
+    void clear();
+
+private:
+    struct Request
+    {
+        unsigned id;
+        bool timed;
+        std::chrono::steady_clock::time_point sent;
+    };
+
+    mutable Mutex x_pending;
+    std::vector<Request> m_pending;  // Oldest first
+};
+
+class PoolStats
+{
+public:
+    // Records the round trip time of a request (in microseconds)
+    void recordRtt(PoolRequest _request, std::chrono::steady_clock::duration _rtt);
+    HistogramSnapshot rtt(PoolRequest _request) const;
+
+    void accountShare(bool _accepted, bool _stale);
+    uint64_t accepted() const { return m_accepted.load(std::memory_order_relaxed); }
+    uint64_t rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+    uint64_t stale() const { return m_stale.load(std::memory_order_relaxed); }
+
+    // Fraction of answered shares which were rejected or accepted as stale
+    double staleRate() const;
+
+    // Records the duration of a TLS handshake (in microseconds)
+    void recordHandshake(std::chrono::steady_clock::duration _time, bool _resumed);
+    HistogramSnapshot handshakes() const { return m_handshakes.snapshot(); }
+    uint64_t resumedHandshakes() const { return m_resumed.load(std::memory_order_relaxed); }
+    uint64_t fullHandshakes() const { return m_full.load(std::memory_order_relaxed); }
+
+    // Counts stratum sessions started, either fresh or resumed
+    void accountSession(bool _resumed);
+    uint64_t resumedSessions() const { return m_resumedSessions.load(std::memory_order_relaxed); }
+    uint64_t freshSessions() const { return m_freshSessions.load(std::memory_order_relaxed); }
+
+    // Counts connections which failed or were lost unexpectedly. Success
+    // (a job received) ends the back-off
+    void accountFailure();
+    void accountSuccess();
+    uint64_t failures() const { return m_failures.load(std::memory_order_relaxed); }
+    unsigned consecutiveFailures() const { return m_consecutiveFailures.load(std::memory_order_relaxed); }
+
+    // Time left before the connection is worth trying again after
+    // consecutive failures : 5 seconds doubling on each, up to 5 minutes.
+    // Zero if not backing off
+    std::chrono::steady_clock::duration backoff() const;
+
+    // Cost for the latency failover policy in milliseconds (lower is
+    // better). The median submit round trip (or authorize or subscribe if
+    // nothing submitted yet) plus 100 ms per percent of stale rate and
+    // 1 second per consecutive failure.
+    // Negative if nothing is known about the connection
+    double score() const;
+
+private:
+    static const unsigned c_requests = 4;
+
+    LatencyHistogram m_rtt[c_requests];
+    std::atomic<uint64_t> m_accepted = {0};
+    std::atomic<uint64_t> m_rejected = {0};
+    std::atomic<uint64_t> m_stale = {0};
+
+    LatencyHistogram m_handshakes;
+    std::atomic<uint64_t> m_resumed = {0};
+    std::atomic<uint64_t> m_full = {0};
+
+    std::atomic<uint64_t> m_resumedSessions = {0};
+    std::atomic<uint64_t> m_freshSessions = {0};
+
+    std::atomic<uint64_t> m_failures = {0};
+    std::atomic<unsigned> m_consecutiveFailures = {0};
+    std::atomic<std::chrono::steady_clock::rep> m_lastFailure = {0};  // steady_clock ticks
+};
+
+}  // namespace dev
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <memory>
 #include <regex>
 #include <string>
 
@@ -24,6 +25,8 @@
 #include <boost/asio.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "PoolStats.h"
+
 // A simple URI parser specifically for mining pool endpoints
 namespace dev
 {
@@ -90,6 +93,9 @@ public:
     void addDuration(unsigned long _minutes) { m_totalDuration += _minutes; }
     unsigned long getDuration() { return m_totalDuration; }
 
+    // Round trips and shares of all the sessions on this connection
+    PoolStats& Stats() { return *m_stats; }
+
 private:
     std::string m_scheme;
     std::string m_authority;  // Contains all text after scheme
@@ -117,5 +123,7 @@ private:
     bool m_isLoopBack;
 
     unsigned long m_totalDuration;  // Total duration on this connection in minutes
+
+    std::shared_ptr<PoolStats> m_stats = std::make_shared<PoolStats>();
 };
 }  // namespace dev
@@ -0,0 +1,297 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <libpoolprotocols/StratumParser.h>
+
+using namespace dev;
+
+namespace
+{
+// Cursor over the line. Every method returns false as soon as the
+// input leaves the subset of JSON the fast path deals with
+class Scanner
+{
+public:
+    Scanner(char const* _begin, char const* _end) : m_p(_begin), m_end(_end) {}
+
+    bool done()
+    {
+        skipBlanks();
+        return m_p == m_end;
+    }
+
+    bool consume(char _c)
+    {
+        skipBlanks();
+        if (m_p == m_end || *m_p != _c)
+            return false;
+        m_p++;
+        return true;
+    }
+
+    bool peek(char _c)
+    {
+        skipBlanks();
+        return m_p != m_end && *m_p == _c;
+    }
+
+    // Strings with escapes are left to jsoncpp
+    bool string(JsonRef& _ref)
+    {
+        if (!consume('"'))
+            return false;
+        char const* first = m_p;
+        while (m_p != m_end && *m_p != '"')
+        {
+            if (*m_p == '\\')
+                return false;
+            m_p++;
+        }
+        if (m_p == m_end)
+            return false;
+        _ref = JsonRef(first, size_t(m_p - first));
+        m_p++;
+        return true;
+    }
+
+    bool scalar(JsonRef& _ref, JsonScalar& _type)
+    {
+        skipBlanks();
+        if (m_p == m_end)
+            return false;
+
+        char c = *m_p;
+        if (c == '"')
+        {
+            _type = JsonScalar::String;
+            return string(_ref);
+        }
+        if (c == 'n')
+        {
+            _type = JsonScalar::Null;
+            return literal("null", _ref);
+        }
+        if (c == 't')
+        {
+            _type = JsonScalar::True;
+            return literal("true", _ref);
+        }
+        if (c == 'f')
+        {
+            _type = JsonScalar::False;
+            return literal("false", _ref);
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            char const* first = m_p;
+            while (m_p != m_end && isNumberChar(*m_p))
+                m_p++;
+            _type = JsonScalar::Number;
+            _ref = JsonRef(first, size_t(m_p - first));
+            return true;
+        }
+
+        // Arrays and objects
+        return false;
+    }
+
+    // Array or object of scalars into _msg params
+    bool params(StratumMessage& _msg, bool _object)
+    {
+        if (!consume(_object ? '{' : '['))
+            return false;
+        char close = _object ? '}' : ']';
+
+        _msg.paramsObject = _object;
+        _msg.paramsCount = 0;
+        if (consume(close))
+            return true;
+
+        do
+        {
+            if (_msg.paramsCount == StratumMessage::c_maxParams)
+                return false;
+            unsigned i = _msg.paramsCount++;
+            if (_object && (!string(_msg.keys[i]) || !consume(':')))
+                return false;
+            if (!scalar(_msg.params[i], _msg.types[i]))
+                return false;
+        } while (consume(','));
+
+        return consume(close);
+    }
+
+private:
+    void skipBlanks()
+    {
+        while (m_p != m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n'))
+            m_p++;
+    }
+
+    bool literal(char const* _word, JsonRef& _ref)
+    {
+        size_t len = std::strlen(_word);
+        if (size_t(m_end - m_p) < len || std::memcmp(m_p, _word, len))
+            return false;
+        _ref = JsonRef(m_p, len);
+        m_p += len;
+        return true;
+    }
+
+    static bool isNumberChar(char _c)
+    {
+        return (_c >= '0' && _c <= '9') || _c == '-' || _c == '+' || _c == '.' || _c == 'e' || _c == 'E';
+    }
+
+    char const* m_p;
+    char const* m_end;
+};
+
+int hexValue(char _c)
+{
+    if (_c >= '0' && _c <= '9')
+        return _c - '0';
+    if (_c >= 'a' && _c <= 'f')
+        return _c - 'a' + 10;
+    if (_c >= 'A' && _c <= 'F')
+        return _c - 'A' + 10;
+    return -1;
+}
+
+}  // namespace
+
+namespace dev
+{
+bool parseStratumMessage(char const* _begin, char const* _end, StratumMessage& _msg)
+{
+    Scanner s(_begin, _end);
+    _msg = StratumMessage();
+
+    if (!s.consume('{'))
+        return false;
+
+    if (!s.consume('}'))
+    {
+        do
+        {
+            JsonRef key;
+            if (!s.string(key) || !s.consume(':'))
+                return false;
+
+            if (StratumMessage::equals(key, "params"))
+            {
+                if (!s.params(_msg, s.peek('{')))
+                    return false;
+                _msg.paramsFromResult = false;
+                continue;
+            }
+
+            if (StratumMessage::equals(key, "result") && s.peek('['))
+            {
+                // A message can't carry both
+                if (_msg.paramsCount || !s.params(_msg, false) || _msg.paramsObject)
+                    return false;
+                _msg.paramsFromResult = true;
+                _msg.result = JsonScalar::Array;
+                continue;
+            }
+
+            JsonRef value;
+            JsonScalar type;
+            if (!s.scalar(value, type))
+                return false;
+
+            if (StratumMessage::equals(key, "id"))
+            {
+                _msg.idType = type;
+                if (type == JsonScalar::Number)
+                {
+                    uint64_t id;
+                    if (!parseUnsigned(value, false, id) || id > 0xffffffffULL)
+                        return false;
+                    _msg.id = unsigned(id);
+                }
+                else if (type != JsonScalar::Null)
+                    return false;
+            }
+            else if (StratumMessage::equals(key, "jsonrpc"))
+            {
+                // Must be the string "2.0" : other types never match
+                _msg.rpc2 = true;
+                _msg.jsonrpc = (type == JsonScalar::String) ? value : JsonRef();
+            }
+            else if (StratumMessage::equals(key, "method"))
+            {
+                if (type != JsonScalar::String)
+                    return false;
+                _msg.method = value;
+            }
+            else if (StratumMessage::equals(key, "result"))
+            {
+                if (type == JsonScalar::Number || type == JsonScalar::String)
+                    return false;
+                _msg.result = type;
+            }
+            else if (StratumMessage::equals(key, "error"))
+            {
+                // Errors have their own handling
+                if (type != JsonScalar::Null)
+                    return false;
+            }
+
+            // Any other scalar member is ignored as jsoncpp path does
+
+        } while (s.consume(','));
+
+        if (!s.consume('}'))
+            return false;
+    }
+
+    return s.done();
+}
+
+bool hexToHash(JsonRef _hex, h256& _hash)
+{
+    return dev::hexToHash(_hex.data(), _hex.size(), _hash);
+}
+
+bool parseUnsigned(JsonRef _text, bool _hex, uint64_t& _value)
+{
+    char const* p = _text.data();
+    size_t len = _text.size();
+    if (len >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+        _hex = true;
+        p += 2;
+        len -= 2;
+    }
+    if (!len || len > (_hex ? 16U : 19U))
+        return false;
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        int d = hexValue(p[i]);
+        if (d < 0 || (!_hex && d > 9))
+            return false;
+        v = v * (_hex ? 16 : 10) + unsigned(d);
+    }
+    _value = v;
+    return true;
+}
+
+}  // namespace dev
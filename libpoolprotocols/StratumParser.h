@@ -0,0 +1,102 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StratumParser.h
+ * Allocation free parser for the frequent pool messages.
+ *
+ * Jobs, difficulty changes and share responses are flat objects whose
+ * params (or result) are an array or an object of scalars. Such messages
+ * are scanned in place into a StratumMessage holding references into the
+ * received line, so no DOM is built and nothing is copied. Anything else
+ * (nested values, escaped strings, errors, too many params) is rejected
+ * and left to jsoncpp.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/vector_ref.h>
+
+namespace dev
+{
+// Text of a JSON scalar within the received line. Strings without quotes
+using JsonRef = vector_ref<char const>;
+
+enum class JsonScalar
+{
+    None,  // Member missing
+    Null,
+    False,
+    True,
+    Number,
+    String,
+    Array  // Only for "result" : an array of scalars held in params
+};
+
+struct StratumMessage
+{
+    static const unsigned c_maxParams = 8;
+
+    bool rpc2 = false;  // "jsonrpc" member present
+    JsonRef jsonrpc;
+    JsonScalar idType = JsonScalar::None;
+    unsigned id = 0;
+    JsonRef method;
+    JsonScalar result = JsonScalar::None;
+
+    // Elements of "params" (or of "result" when it's an array). For
+    // object params keys[] holds the member names
+    bool paramsObject = false;
+    bool paramsFromResult = false;
+    unsigned paramsCount = 0;
+    JsonRef keys[c_maxParams];
+    JsonRef params[c_maxParams];
+    JsonScalar types[c_maxParams];
+
+    // Value of an object param or an empty ref
+    JsonRef param(char const* _key) const
+    {
+        size_t len = std::strlen(_key);
+        for (unsigned i = 0; i < paramsCount; i++)
+            if (keys[i].size() == len && !std::memcmp(keys[i].data(), _key, len))
+                return params[i];
+        return JsonRef();
+    }
+
+    bool isMethod(char const* _method) const { return equals(method, _method); }
+
+    static bool equals(JsonRef _ref, char const* _s)
+    {
+        size_t len = std::strlen(_s);
+        return _ref.size() == len && !std::memcmp(_ref.data(), _s, len);
+    }
+};
+
+// Returns false if the line is not a message of a shape known to the
+// fast path (or not valid JSON). _msg is undefined in that case
+bool parseStratumMessage(char const* _begin, char const* _end, StratumMessage& _msg);
+
+// Decodes up to 64 hex digits (optionally 0x prefixed) into _hash
+// padding on the left with zeroes. Returns false on invalid digits
+bool hexToHash(JsonRef _hex, h256& _hash);
+
+// Parses a decimal or (0x prefixed or _hex) hexadecimal unsigned
+bool parseUnsigned(JsonRef _text, bool _hex, uint64_t& _value);
+
+}  // namespace dev
@@ -0,0 +1,165 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include <libdevcore/CommonData.h>
+#include <libpoolprotocols/SubmitTemplate.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+TxBufferPool::TxBufferPool(unsigned _count, size_t _capacity) : m_capacity(_capacity), m_free(_count)
+{
+    for (unsigned i = 0; i < _count; i++)
+    {
+        TxBuffer* buffer = new TxBuffer;
+        buffer->data.reserve(m_capacity);
+        m_free.bounded_push(buffer);
+    }
+}
+
+TxBufferPool::~TxBufferPool()
+{
+    m_free.consume_all([](TxBuffer* b) { delete b; });
+}
+
+TxBuffer* TxBufferPool::get()
+{
+    TxBuffer* buffer;
+    if (m_free.pop(buffer))
+        return buffer;
+    buffer = new TxBuffer;
+    buffer->data.reserve(m_capacity);
+    return buffer;
+}
+
+void TxBufferPool::put(TxBuffer* _buffer)
+{
+    _buffer->id = 0;
+    _buffer->data.clear();
+    if (!m_free.bounded_push(_buffer))
+        delete _buffer;
+}
+
+void SubmitTemplate::clear()
+{
+    m_text.clear();
+    m_slots.clear();
+    m_nonceSkip = 0;
+}
+
+SubmitTemplate& SubmitTemplate::text(std::string const& _text)
+{
+    m_text += _text;
+    return *this;
+}
+
+SubmitTemplate& SubmitTemplate::slot(SubmitSlot _slot)
+{
+    size_t width = 0;
+    if (_slot == SubmitSlot::Header || _slot == SubmitSlot::Mix)
+        width = 2 + h256::size * 2;
+    m_slots.push_back({_slot, m_text.size(), width});
+    m_text.append(width, '0');
+    return *this;
+}
+
+SubmitTemplate& SubmitTemplate::nonce(unsigned _skip, bool _prefix)
+{
+    m_nonceSkip = min(_skip, unsigned(sizeof(uint64_t) * 2));
+    if (_prefix)
+        m_text += "0x";
+    size_t width = sizeof(uint64_t) * 2 - m_nonceSkip;
+    m_slots.push_back({SubmitSlot::Nonce, m_text.size(), width});
+    m_text.append(width, '0');
+    return *this;
+}
+
+void SubmitTemplate::render(unsigned _id, Solution const& _solution, std::vector<char>& _out) const
+{
+    // Worst case every char of job id is escaped as \u00XX
+    _out.resize(m_text.size() + _solution.work.job.size() * 6 + 10);
+    char* out = _out.data();
+    size_t from = 0;
+
+    for (auto const& s : m_slots)
+    {
+        memcpy(out, m_text.data() + from, s.offset - from);
+        out += s.offset - from;
+        from = s.offset + s.width;
+
+        switch (s.slot)
+        {
+        case SubmitSlot::Id:
+        {
+            char digits[10];
+            unsigned n = 0, id = _id;
+            do
+            {
+                digits[n++] = char('0' + id % 10);
+                id /= 10;
+            } while (id);
+            while (n)
+                *out++ = digits[--n];
+            break;
+        }
+        case SubmitSlot::Job:
+            for (char c : _solution.work.job)
+            {
+                byte b = static_cast<byte>(c);
+                if (b < 0x20)
+                {
+                    memcpy(out, "\\u00", 4);
+                    out = hexEncode(&b, 1, out + 4);
+                    continue;
+                }
+                if (c == '"' || c == '\\')
+                    *out++ = '\\';
+                *out++ = c;
+            }
+            break;
+        case SubmitSlot::Nonce:
+        {
+            byte nonce[sizeof(uint64_t)];
+            for (unsigned i = 0; i < sizeof(uint64_t); i++)
+                nonce[i] = byte(_solution.nonce >> (8 * (sizeof(uint64_t) - 1 - i)));
+
+            // Odd skips start in the middle of a byte
+            char digits[sizeof(uint64_t) * 2];
+            hexEncode(nonce, sizeof(nonce), digits);
+            memcpy(out, digits + m_nonceSkip, s.width);
+            out += s.width;
+            break;
+        }
+        case SubmitSlot::Header:
+        case SubmitSlot::Mix:
+        {
+            h256 const& hash = (s.slot == SubmitSlot::Header) ? _solution.work.header : _solution.mixHash;
+            *out++ = '0';
+            *out++ = 'x';
+            out = hexEncode(hash.data(), h256::size, out);
+            break;
+        }
+        }
+    }
+
+    memcpy(out, m_text.data() + from, m_text.size() - from);
+    out += m_text.size() - from;
+    _out.resize(size_t(out - _out.data()));
+}
@@ -0,0 +1,108 @@
+/*
+    This file is part of axisminer.
+
+    axisminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    axisminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with axisminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SubmitTemplate.h
+ * Pre-rendered solution submissions and recycled transmit buffers.
+ *
+ * A SubmitTemplate holds the text of a submit request as rendered for the
+ * current session with room left for the values of each solution. Nonce,
+ * header and mix have fixed widths and are hex encoded in place; request
+ * id and job id are spliced in. Requests are rendered into TxBuffers
+ * taken from a TxBufferPool, so that once the pool is warm submitting a
+ * solution neither allocates nor builds a Json document.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/lockfree/queue.hpp>
+
+#include <libethcore/EthashAux.h>
+
+namespace dev
+{
+// A request queued for transmission
+struct TxBuffer
+{
+    unsigned id = 0;         // Json id of the request
+    std::vector<char> data;  // Rendered request. Capacity is kept while pooled
+};
+
+// Lock free recycler of TxBuffers. Buffers are taken by the threads
+// submitting requests and given back by the io thread once written
+class TxBufferPool
+{
+public:
+    TxBufferPool(unsigned _count, size_t _capacity);
+    ~TxBufferPool();
+
+    TxBufferPool(TxBufferPool const&) = delete;
+    TxBufferPool& operator=(TxBufferPool const&) = delete;
+
+    // Never fails : allocates a new buffer if pool is empty
+    TxBuffer* get();
+
+    // Returns a buffer to the pool (or frees it if pool is full)
+    void put(TxBuffer* _buffer);
+
+private:
+    size_t m_capacity;
+    boost::lockfree::queue<TxBuffer*> m_free;
+};
+
+enum class SubmitSlot
+{
+    Id,      // Decimal request id
+    Job,     // Job id as received (escaped if needed)
+    Nonce,   // Hex nonce (after skipping the extranonce digits)
+    Header,  // 0x prefixed hex header hash
+    Mix      // 0x prefixed hex mix hash
+};
+
+class SubmitTemplate
+{
+public:
+    // Template building. Literal text must already be valid Json
+    void clear();
+    SubmitTemplate& text(std::string const& _text);
+    SubmitTemplate& slot(SubmitSlot _slot);
+
+    // Nonce digits are rendered after skipping the first _skip (the
+    // extranonce part for EthereumStratum). _prefix adds 0x
+    SubmitTemplate& nonce(unsigned _skip, bool _prefix);
+
+    bool empty() const { return m_text.empty(); }
+    unsigned nonceSkip() const { return m_nonceSkip; }
+
+    // Renders the request for _solution into _out (overwritten)
+    void render(unsigned _id, eth::Solution const& _solution, std::vector<char>& _out) const;
+
+private:
+    struct Slot
+    {
+        SubmitSlot slot;
+        size_t offset;  // Position in m_text
+        size_t width;   // Digits reserved in m_text. Zero for spliced values
+    };
+
+    std::string m_text;
+    std::vector<Slot> m_slots;
+    unsigned m_nonceSkip = 0;
+};
+
+}  // namespace dev
@@ -1,6 +1,7 @@
 #include "EthGetworkClient.h"
 
 #include <chrono>
+#include <cstdio>
 
 #include <ethash/ethash.hpp>
 
@@ -13,9 +14,10 @@ using boost::asio::ip::tcp;
 EthGetworkClient::EthGetworkClient(int worktimeout, unsigned farmRecheckPeriod)
   : PoolClient(),
     m_farmRecheckPeriod(farmRecheckPeriod),
+    m_txPool(32, 512),
     m_io_strand(g_io_service),
-    m_socket(g_io_service),
-    m_txQueue(1024),
+    m_work("work"),
+    m_submit("submit"),
     m_resolver(g_io_service),
     m_endpoints(),
     m_getwork_timer(g_io_service),
@@ -29,6 +31,17 @@ EthGetworkClient::EthGetworkClient(int worktimeout, unsigned farmRecheckPeriod)
     jGetWork["method"] = "axis_getWork";
     jGetWork["params"] = Json::Value(Json::arrayValue);
     m_jsonGetWork = std::string(Json::writeString(m_jSwBuilder, jGetWork));
+
+    // Same members, in the same order, jsoncpp would write
+    m_submitTemplate.text("{\"id\":")
+        .slot(SubmitSlot::Id)
+        .text(",\"method\":\"axis_submitWork\",\"params\":[\"")
+        .nonce(0, true)
+        .text("\",\"")
+        .slot(SubmitSlot::Header)
+        .text("\",\"")
+        .slot(SubmitSlot::Mix)
+        .text("\"]}");
 }
 
 EthGetworkClient::~EthGetworkClient()
@@ -46,6 +59,12 @@ void EthGetworkClient::connect()
 
     // Reset status flags
     m_getwork_timer.cancel();
+    m_longPoll = false;
+    m_longPollPending = false;
+
+    // Make sure path begins with "/"
+    m_work.head = httpHead(m_conn->Path().empty() ? "/" : m_conn->Path());
+    m_submit.head = m_work.head;
 
     // Initialize a new queue of end points
     m_endpoints = std::queue<boost::asio::ip::basic_endpoint<boost::asio::ip::tcp>>();
@@ -68,7 +87,7 @@ void EthGetworkClient::connect()
         // No need to use the resolver if host is already an IP address
         m_endpoints.push(
             boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(m_conn->Host()), m_conn->Port()));
-        send(m_jsonGetWork);
+        request_getwork();
     }
 }
 
@@ -82,253 +101,480 @@ void EthGetworkClient::disconnect()
     }
 
     m_connecting.store(false, std::memory_order_relaxed);
-    m_txPending.store(false, std::memory_order_relaxed);
     m_getwork_timer.cancel();
+    m_longPollPending = false;
 
-    m_txQueue.consume_all([](std::string* l) { delete l; });
-    m_request.consume(m_request.capacity());
-    m_response.consume(m_response.capacity());
+    for (Channel* ch : {&m_work, &m_submit})
+    {
+        channel_close(ch, false);
+        ch->txQueue.consume_all([this](TxBuffer* b) { m_txPool.put(b); });
+        ch->txPending.store(false, std::memory_order_relaxed);
+    }
 
     if (m_onDisconnected)
         m_onDisconnected();
 }
 
-void EthGetworkClient::begin_connect()
+// Request line and headers up to Content-Length value
+std::string EthGetworkClient::httpHead(std::string const& _path)
+{
+    return "POST " + _path + " HTTP/1.1\r\nHost: " + m_conn->Host() +
+           "\r\nContent-Type: application/json\r\nContent-Length: ";
+}
+
+/*
+ * Writes the requests queued on a channel, connecting it first if needed.
+ * Runs on the strand : posted by send() and called again once connected
+ * or once a write completes.
+ */
+void EthGetworkClient::channel_flush(Channel* _ch)
 {
-    if (!m_endpoints.empty())
+    // Nothing more to send once disconnected
+    if (!m_connected.load(std::memory_order_relaxed) && !m_connecting.load(std::memory_order_relaxed))
     {
-        // Pick the first endpoint in list.
-        // Eventually endpoints get discarded on connection errors
-        m_endpoint = m_endpoints.front();
-        m_socket.async_connect(m_endpoint, m_io_strand.wrap(boost::bind(&EthGetworkClient::handle_connect, this, _1)));
+        _ch->txQueue.consume_all([this](TxBuffer* b) { m_txPool.put(b); });
+        _ch->txPending.store(false, std::memory_order_relaxed);
+        return;
     }
+
+    // Flushed again when done
+    if (_ch->connecting || _ch->writing)
+        return;
+
+    TxBuffer* buffer;
+    while (true)
+    {
+        while (_ch->txQueue.pop(buffer))
+            _ch->txWaiting.push_back(buffer);
+        if (!_ch->txWaiting.empty())
+            break;
+
+        // A request queued meanwhile saw the flag still set
+        _ch->txPending.store(false, std::memory_order_relaxed);
+        bool ex = false;
+        if (_ch->txQueue.empty() || !_ch->txPending.compare_exchange_strong(ex, true, std::memory_order_relaxed))
+            return;
+    }
+
+    if (_ch->socket.is_open())
+        channel_write(_ch);
     else
+        channel_connect(_ch);
+}
+
+void EthGetworkClient::channel_connect(Channel* _ch)
+{
+    if (m_endpoints.empty())
     {
         cwarn << "No more IP addresses to try for host: " << m_conn->Host();
         disconnect();
+        return;
     }
+
+    // Pick the first endpoint in list.
+    // Eventually endpoints get discarded on connection errors
+    _ch->endpoint = m_endpoints.front();
+    m_endpoint = _ch->endpoint;
+    _ch->connecting = true;
+    _ch->socket.async_connect(_ch->endpoint, m_io_strand.wrap(boost::bind(&EthGetworkClient::handle_connect, this, _ch,
+                                              boost::asio::placeholders::error)));
+}
+
+// Discards a failed endpoint. Both channels connect to the first one in
+// list : it's gone already if the other channel failed on it meanwhile
+void EthGetworkClient::pop_endpoint(boost::asio::ip::tcp::endpoint const& _endpoint)
+{
+    if (!m_endpoints.empty() && m_endpoints.front() == _endpoint)
+        m_endpoints.pop();
 }
 
-void EthGetworkClient::handle_connect(const boost::system::error_code& ec)
+void EthGetworkClient::channel_write(Channel* _ch)
 {
-    if (!ec && m_socket.is_open())
+    // All requests waiting in one gather write. Headers are pre-rendered
+    // but the length of the payload. Double line feed marks the
+    // beginning of body
+    _ch->writing = true;
+    _ch->txHead = _ch->head;
+    _ch->txTails.resize(_ch->txWaiting.size());
+    _ch->txGather.clear();
+
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < _ch->txWaiting.size(); i++)
     {
-        // If in "connecting" phase raise the proper event
-        if (m_connecting.load(std::memory_order_relaxed))
-        {
-            // Initialize new session
-            m_connected.store(true, memory_order_relaxed);
-            m_session = unique_ptr<Session>(new Session);
-            m_session->subscribed.store(true, memory_order_relaxed);
-            m_session->authorized.store(true, memory_order_relaxed);
+        TxBuffer* b = _ch->txWaiting[i];
+        int len = snprintf(_ch->txTails[i].data(), _ch->txTails[i].size(), "%u\r\n\r\n", unsigned(b->data.size()));
 
-            m_connecting.store(false, std::memory_order_relaxed);
+        // Out received message only for debug purpouses
+        if (g_logOptions & LOG_JSON)
+            cnote << " >> " << std::string(b->data.data(), b->data.size());
 
-            if (m_onConnected)
-                m_onConnected();
-            m_current_tstamp = std::chrono::steady_clock::now();
-        }
+        _ch->txGather.push_back(boost::asio::buffer(_ch->txHead));
+        _ch->txGather.push_back(boost::asio::buffer(_ch->txTails[i].data(), size_t(len)));
+        _ch->txGather.push_back(boost::asio::buffer(b->data));
+        _ch->inFlight.push_back({b, now});
+    }
+    _ch->txWaiting.clear();
 
-        // Retrieve 1st line waiting in the queue and submit
-        // if other lines waiting they will be processed
-        // at the end of the processed request
-        Json::Reader jRdr;
-        std::string* line;
-        std::ostream os(&m_request);
-        if (!m_txQueue.empty())
-        {
-            while (m_txQueue.pop(line))
-            {
-                if (line->size())
-                {
-                    jRdr.parse(*line, m_pendingJReq);
-                    m_pending_tstamp = std::chrono::steady_clock::now();
-
-                    // Make sure path begins with "/"
-                    string _path = (m_conn->Path().empty() ? "/" : m_conn->Path());
-
-                    os << "POST " << _path << " HTTP/1.0\r\n";
-                    os << "Host: " << m_conn->Host() << "\r\n";
-                    os << "Content-Type: application/json"
-                       << "\r\n";
-                    os << "Content-Length: " << line->length() << "\r\n";
-                    os << "Connection: close\r\n\r\n";  // Double line feed to mark the
-                                                        // beginning of body
-                    // The payload
-                    os << *line;
-
-                    // Out received message only for debug purpouses
-                    if (g_logOptions & LOG_JSON)
-                        cnote << " >> " << *line;
-
-                    delete line;
-
-                    async_write(m_socket, m_request,
-                        m_io_strand.wrap(
-                            boost::bind(&EthGetworkClient::handle_write, this, boost::asio::placeholders::error)));
-                    break;
-                }
-                delete line;
-            }
-        }
+    async_write(_ch->socket, _ch->txGather,
+        m_io_strand.wrap(boost::bind(&EthGetworkClient::handle_write, this, _ch, boost::asio::placeholders::error)));
+}
+
+void EthGetworkClient::channel_read(Channel* _ch)
+{
+    async_read(_ch->socket, _ch->response, boost::asio::transfer_at_least(1),
+        m_io_strand.wrap(boost::bind(&EthGetworkClient::handle_read, this, _ch, boost::asio::placeholders::error,
+            boost::asio::placeholders::bytes_transferred)));
+}
+
+// Closes the connection of a channel. Requests not answered are kept
+// to be written again if _retry, else dropped
+void EthGetworkClient::channel_close(Channel* _ch, bool _retry)
+{
+    if (_ch->socket.is_open())
+    {
+        // Manage error code if layer is already shut down
+        boost::system::error_code ec;
+        _ch->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+        _ch->socket.close(ec);
+    }
+    _ch->connecting = false;
+    _ch->writing = false;
+    _ch->served = 0;
+    _ch->response.consume(_ch->response.size());
+
+    while (!_ch->inFlight.empty())
+    {
+        TxBuffer* b = _ch->inFlight.back().buffer;
+        _ch->inFlight.pop_back();
+        if (_retry)
+            _ch->txWaiting.push_front(b);
         else
-        {
-            m_txPending.store(false, std::memory_order_relaxed);
-        }
+            m_txPool.put(b);
     }
-    else
+    if (!_retry)
     {
-        if (ec != boost::asio::error::operation_aborted)
-        {
-            // This endpoint does not respond
-            // Pop it and retry
-            cwarn << "Error connecting to " << m_conn->Host() << ":" << toString(m_conn->Port()) ;//<< " : " << ec.message();
-            m_endpoints.pop();
-            begin_connect();
-        }
+        for (TxBuffer* b : _ch->txWaiting)
+            m_txPool.put(b);
+        _ch->txWaiting.clear();
     }
 }
 
-void EthGetworkClient::handle_write(const boost::system::error_code& ec)
+/*
+ * The node closed the connection of a channel or it failed. Requests not
+ * answered yet are written again on a new connection, unless this one
+ * did not answer any at all.
+ */
+void EthGetworkClient::channel_lost(Channel* _ch)
 {
-    if (!ec)
+    bool answered = _ch->served > 0;
+    bool pending = !_ch->inFlight.empty();
+    channel_close(_ch, true);
+
+    if (pending && !answered)
     {
-        // Transmission succesfully sent.
-        // Read the response async.
-        async_read(m_socket, m_response, boost::asio::transfer_at_least(1),
-            m_io_strand.wrap(boost::bind(&EthGetworkClient::handle_read, this, boost::asio::placeholders::error,
-                boost::asio::placeholders::bytes_transferred)));
+        cwarn << "Error reading from :" << m_conn->Host() << ":" << toString(m_conn->Port());
+        disconnect();
+        return;
     }
-    else
+    channel_flush(_ch);
+}
+
+void EthGetworkClient::handle_connect(Channel* _ch, const boost::system::error_code& ec)
+{
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+    _ch->connecting = false;
+
+    if (ec)
     {
-        if (ec != boost::asio::error::operation_aborted)
-        {
-            cwarn << "Error writing to " << m_conn->Host() << ":" << toString(m_conn->Port()) ;//<< " : " << ec.message();
-            m_endpoints.pop();
-            begin_connect();
-        }
+        // This endpoint does not respond
+        // Pop it and retry
+        cwarn << "Error connecting to " << m_conn->Host() << ":" << toString(m_conn->Port()) ;//<< " : " << ec.message();
+        boost::system::error_code ignored;
+        _ch->socket.close(ignored);
+        pop_endpoint(_ch->endpoint);
+        channel_connect(_ch);
+        return;
     }
+
+    // If in "connecting" phase raise the proper event
+    if (m_connecting.load(std::memory_order_relaxed))
+    {
+        // Initialize new session
+        m_connected.store(true, memory_order_relaxed);
+        m_session = unique_ptr<Session>(new Session);
+        m_session->subscribed.store(true, memory_order_relaxed);
+        m_session->authorized.store(true, memory_order_relaxed);
+
+        m_connecting.store(false, std::memory_order_relaxed);
+
+        if (m_onConnected)
+            m_onConnected();
+        m_current_tstamp = std::chrono::steady_clock::now();
+    }
+
+#ifdef _DEVELOPER
+    if (g_logOptions & LOG_CONNECT)
+        cnote << "Connected " << _ch->name << " channel to " << _ch->endpoint;
+#endif
+
+    // Requests are small : don't wait to fill segments
+    boost::system::error_code ignored;
+    _ch->socket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+
+    // Keep reading to know as soon as the node closes the connection
+    channel_read(_ch);
+    channel_flush(_ch);
 }
 
-void EthGetworkClient::handle_read(const boost::system::error_code& ec, std::size_t bytes_transferred)
+void EthGetworkClient::handle_write(Channel* _ch, const boost::system::error_code& ec)
 {
-    if (!ec)
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+    _ch->writing = false;
+
+    if (ec)
     {
-        // Close socket
-        // No more data can be read so no need to check any max message size
-        if (m_socket.is_open())
-            m_socket.close();
+        channel_lost(_ch);
+        return;
+    }
 
-        // Get the whole message
-        std::string rx_message(boost::asio::buffer_cast<const char*>(m_response.data()), bytes_transferred);
-        m_response.consume(bytes_transferred);
+    // Anything queued meanwhile
+    channel_flush(_ch);
+}
+
+void EthGetworkClient::handle_read(Channel* _ch, const boost::system::error_code& ec, std::size_t bytes_transferred)
+{
+    (void)bytes_transferred;
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    bool eof = (ec == boost::asio::error::eof);
+    if (ec && !eof)
+    {
+        channel_lost(_ch);
+        return;
+    }
 
-        // Empty response ?
-        if (!rx_message.size())
+    // Responses received so far. The last one may be incomplete
+    std::string rx_message(boost::asio::buffer_cast<const char*>(_ch->response.data()), _ch->response.size());
+    size_t offset = 0;
+    bool close = false;
+    while (offset < rx_message.size() && !close)
+    {
+        HttpResponse response;
+        size_t end = parseHttpResponse(rx_message, offset, eof, response);
+        if (!end)
+            break;
+        if (end == std::string::npos || _ch->inFlight.empty())
         {
             cwarn << "Invalid response from " << m_conn->Host() << ":" << toString(m_conn->Port());
             disconnect();
             return;
         }
 
-        // Read message by lines.
-        // First line is http status
-        // Other lines are headers
-        // A double "\r\n" identifies begin of body
-        // The rest is body
-        std::string line;
-        std::string linedelimiter = "\r\n";
-        std::size_t delimiteroffset = rx_message.find(linedelimiter);
-
-        unsigned int linenum = 0;
-        bool isHeader = true;
-        while (rx_message.length() && delimiteroffset != std::string::npos)
-        {
-            linenum++;
-            line = rx_message.substr(0, delimiteroffset);
-            rx_message.erase(0, delimiteroffset + 2);
+        offset = end;
+        close = response.close;
+        _ch->served++;
+        if (!processHttpResponse(_ch, response))
+            return;
+    }
+    _ch->response.consume(offset);
 
-            // This identifies the beginning of body
-            if (line.empty())
-            {
-                isHeader = false;
-                delimiteroffset = rx_message.find(linedelimiter);
-                if (delimiteroffset != std::string::npos)
-                    continue;
-                boost::replace_all(rx_message, "\n", "");
-                line = rx_message;
-            }
+    if (eof || close)
+        channel_lost(_ch);
+    else
+        channel_read(_ch);
+}
 
-            // Http status
-            if (isHeader && linenum == 1)
-            {
-                if (line.substr(0, 7) != "HTTP/1.")
-                {
-                    cwarn << "Invalid response from " << m_conn->Host() << ":" << toString(m_conn->Port());
-                    disconnect();
-                    return;
-                }
-                std::size_t spaceoffset = line.find(' ');
-                if (spaceoffset == std::string::npos)
-                {
-                    cwarn << "Invalid response from " << m_conn->Host() << ":" << toString(m_conn->Port());
-                    disconnect();
-                    return;
-                }
-                std::string status = line.substr(spaceoffset + 1);
-                if (status.substr(0, 3) != "200")
-                {
-                    cwarn << m_conn->Host() << ":" << toString(m_conn->Port()) << " reported status " << status;
-                    disconnect();
-                    return;
-                }
-            }
+/*
+ * Frames the response beginning at _offset of _rx. Returns the offset
+ * of its end, 0 if not complete yet or npos if malformed. Bodies are
+ * delimited by Content-Length, chunked encoding or the end of the
+ * connection (_eof).
+ */
+size_t EthGetworkClient::parseHttpResponse(std::string const& _rx, size_t _offset, bool _eof, HttpResponse& _response)
+{
+    size_t headEnd = _rx.find("\r\n\r\n", _offset);
+    if (headEnd == std::string::npos)
+        return 0;
+
+    // Http status
+    size_t eol = _rx.find("\r\n", _offset);
+    std::string line = _rx.substr(_offset, eol - _offset);
+    if (line.size() < 12 || line.compare(0, 7, "HTTP/1.") || line[8] != ' ')
+        return std::string::npos;
+    _response.status = line.substr(9);
+    _response.close = (line[7] == '0');  // HTTP/1.0 closes unless told otherwise
+
+    // Headers
+    int64_t length = -1;
+    bool chunked = false;
+    for (size_t pos = eol + 2; pos < headEnd + 2; pos = eol + 2)
+    {
+        eol = _rx.find("\r\n", pos);
+        line = _rx.substr(pos, eol - pos);
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        std::string name = boost::algorithm::to_lower_copy(line.substr(0, colon));
+        std::string value = boost::algorithm::trim_copy(line.substr(colon + 1));
+
+        if (name == "content-length")
+        {
+            uint64_t v;
+            if (!parseUnsigned(JsonRef(value.data(), value.size()), false, v))
+                return std::string::npos;
+            length = int64_t(v);
+        }
+        else if (name == "transfer-encoding")
+            chunked = boost::algorithm::iends_with(value, "chunked");
+        else if (name == "connection")
+            _response.close = boost::algorithm::iequals(value, "close") ||
+                               (_response.close && !boost::algorithm::iequals(value, "keep-alive"));
+        else if (name == "x-long-polling")
+            _response.longPoll = value;
+    }
 
-            // Body
-            if (!isHeader)
+    // Body
+    size_t pos = headEnd + 4;
+    if (chunked)
+    {
+        while (true)
+        {
+            eol = _rx.find("\r\n", pos);
+            if (eol == std::string::npos)
+                return 0;
+
+            // Chunk size may be followed by extensions
+            line = _rx.substr(pos, eol - pos);
+            line = line.substr(0, line.find(';'));
+            uint64_t size;
+            if (!parseUnsigned(JsonRef(line.data(), line.size()), true, size) || size > _rx.max_size())
+                return std::string::npos;
+            pos = eol + 2;
+
+            if (!size)
             {
-                // Out received message only for debug purpouses
-                if (g_logOptions & LOG_JSON)
-                    cnote << " << " << line;
-
-                // Test validity of chunk and process
-                Json::Value jRes;
-                Json::Reader jRdr;
-                if (jRdr.parse(line, jRes))
+                // Trailers up to an empty line
+                while (true)
                 {
-                    // Run in sync so no 2 different async reads may overlap
-                    processResponse(jRes);
-                }
-                else
-                {
-                    string what = jRdr.getFormattedErrorMessages();
-                    boost::replace_all(what, "\n", " ");
-                    cwarn << "Got invalid Json message : " << what;
+                    eol = _rx.find("\r\n", pos);
+                    if (eol == std::string::npos)
+                        return 0;
+                    bool empty = (eol == pos);
+                    pos = eol + 2;
+                    if (empty)
+                        return pos;
                 }
             }
 
-            delimiteroffset = rx_message.find(linedelimiter);
+            if (_rx.size() - pos < size + 2)
+                return 0;
+            _response.body.append(_rx, pos, size_t(size));
+            pos += size_t(size);
+            if (_rx.compare(pos, 2, "\r\n"))
+                return std::string::npos;
+            pos += 2;
         }
+    }
 
-        // Is there anything else in the queue
-        if (!m_txQueue.empty())
-        {
-            begin_connect();
-        }
-        else
+    if (length >= 0)
+    {
+        if (uint64_t(_rx.size() - pos) < uint64_t(length))
+            return 0;
+        _response.body = _rx.substr(pos, size_t(length));
+        return pos + size_t(length);
+    }
+
+    // Body ends with the connection
+    if (!_eof)
+        return 0;
+    _response.close = true;
+    _response.body = _rx.substr(pos);
+    return _rx.size();
+}
+
+/*
+ * Handles a response framed on a channel. Returns false if it got the
+ * client disconnected.
+ */
+bool EthGetworkClient::processHttpResponse(Channel* _ch, HttpResponse& _response)
+{
+    // Responses come in the same order as requests
+    InFlight answered = _ch->inFlight.front();
+    _ch->inFlight.pop_front();
+    m_pendingId = answered.buffer->id;
+    m_pending_tstamp = answered.sent;
+    m_txPool.put(answered.buffer);
+
+    if (_response.status.substr(0, 3) != "200")
+    {
+        cwarn << m_conn->Host() << ":" << toString(m_conn->Port()) << " reported status " << _response.status;
+        disconnect();
+        return false;
+    }
+
+    if (_ch == &m_work && m_pendingId == 1)
+    {
+        m_longPollPending = false;
+
+        // Switch to long polling if the node offers it on itself
+        if (!m_longPoll && !_response.longPoll.empty())
         {
-            // Signal end of async send/receive operations
-            m_txPending.store(false, std::memory_order_relaxed);
+            std::string path = _response.longPoll;
+            if (boost::algorithm::istarts_with(path, "http://"))
+            {
+                size_t slash = path.find('/', 7);
+                std::string authority = path.substr(7, slash == std::string::npos ? slash : slash - 7);
+                bool same = boost::algorithm::iequals(authority, m_conn->Host()) ||
+                            boost::algorithm::iequals(authority, m_conn->Host() + ":" + toString(m_conn->Port()));
+                path = !same ? "" : (slash == std::string::npos ? "/" : path.substr(slash));
+            }
+            if (!path.empty() && path[0] == '/')
+            {
+                cnote << "Long polling " << m_conn->Host() << path;
+                m_longPoll = true;
+                m_work.head = httpHead(path);
+            }
         }
     }
+
+    std::string& line = _response.body;
+    boost::replace_all(line, "\r", "");
+    boost::replace_all(line, "\n", "");
+
+    // Empty response ?
+    if (line.empty())
+    {
+        cwarn << "Invalid response from " << m_conn->Host() << ":" << toString(m_conn->Port());
+        disconnect();
+        return false;
+    }
+
+    // Out received message only for debug purpouses
+    if (g_logOptions & LOG_JSON)
+        cnote << " << " << line;
+
+    // Work and share responses are handled in place
+    StratumMessage msg;
+    if (parseStratumMessage(line.data(), line.data() + line.size(), msg) && processFastResponse(msg))
+        return true;
+
+    // Test validity of chunk and process
+    Json::Value jRes;
+    Json::Reader jRdr;
+    if (jRdr.parse(line, jRes))
+    {
+        processResponse(jRes);
+    }
     else
     {
-        if (ec != boost::asio::error::operation_aborted)
-        {
-            cwarn << "Error reading from :" << m_conn->Host() << ":" << toString(m_conn->Port()) ;//<< " : " << ec.message();
-            disconnect();
-        }
+        string what = jRdr.getFormattedErrorMessages();
+        boost::replace_all(what, "\n", " ");
+        cwarn << "Got invalid Json message : " << what;
     }
+    return true;
 }
 
 void EthGetworkClient::handle_resolve(const boost::system::error_code& ec, tcp::resolver::iterator i)
@@ -343,7 +589,7 @@ void EthGetworkClient::handle_resolve(const boost::system::error_code& ec, tcp::
         m_resolver.cancel();
 
         // Resolver has finished so invoke connection asynchronously
-        send(m_jsonGetWork);
+        request_getwork();
     }
     else
     {
@@ -352,6 +598,75 @@ void EthGetworkClient::handle_resolve(const boost::system::error_code& ec, tcp::
     }
 }
 
+bool EthGetworkClient::processFastResponse(StratumMessage const& _msg)
+{
+    if (_msg.idType == JsonScalar::None)
+        return false;
+
+    // Same as processResponse() : id is the one of the pending request
+    unsigned _id = m_pendingId;
+
+    if (_id == 0 || _id == 1)
+    {
+        if (_msg.result != JsonScalar::Array || _msg.paramsCount < 4)
+            return false;
+
+        WorkPackage newWp;
+        uint64_t block;
+        if (_msg.types[0] != JsonScalar::String || _msg.types[1] != JsonScalar::String ||
+            _msg.types[2] != JsonScalar::String || _msg.types[3] != JsonScalar::String ||
+            !hexToHash(_msg.params[0], newWp.header) || !hexToHash(_msg.params[1], newWp.seed) ||
+            !hexToHash(_msg.params[2], newWp.boundary) || !parseUnsigned(_msg.params[3], false, block))
+            return false;
+
+        // Unchanged work is the common case. Don't build a package for it
+        if (m_current.header != newWp.header)
+        {
+            newWp.job = newWp.header.hex();
+            newWp.block = (block > 0x9660180) ? -1 : int(block);
+            m_current = newWp;
+            m_current_tstamp = std::chrono::steady_clock::now();
+
+            if (m_onWorkReceived)
+                m_onWorkReceived(m_current);
+        }
+        next_getwork();
+        return true;
+    }
+
+    if (_id == 9)
+    {
+        accountPendingRtt(PoolRequest::Hashrate);
+        return true;
+    }
+
+    if (_id >= 40 && _id <= m_solution_submitted_max_id)
+    {
+        if (_msg.result == JsonScalar::Array)
+            return false;
+
+        // A null result is not a success either
+        bool _isSuccess = (_msg.result == JsonScalar::True);
+
+        std::chrono::milliseconds _delay = accountPendingRtt(PoolRequest::Submit);
+
+        const unsigned miner_index = _id - 40;
+        if (_isSuccess)
+        {
+            if (m_onSolutionAccepted)
+                m_onSolutionAccepted(_delay, miner_index, false);
+        }
+        else
+        {
+            if (m_onSolutionRejected)
+                m_onSolutionRejected(_delay, miner_index);
+        }
+        return true;
+    }
+
+    return false;
+}
+
 void EthGetworkClient::processResponse(Json::Value& JRes)
 {
     unsigned _id = 0;         // This SHOULD be the same id as the request it is responding to
@@ -366,7 +681,7 @@ void EthGetworkClient::processResponse(Json::Value& JRes)
     // We get the id from pending jrequest
     // It's not guaranteed we get response labelled with same id
     // For instance Dwarfpool always responds with "id":0
-    _id = m_pendingJReq.get("id", unsigned(0)).asUInt();
+    _id = m_pendingId;
     _isSuccess = JRes.get("error", Json::Value::null).empty();
     _errReason = (_isSuccess ? "" : processError(JRes));
 
@@ -385,9 +700,7 @@ void EthGetworkClient::processResponse(Json::Value& JRes)
         if (!_isSuccess)
         {
             cwarn << "Got " << _errReason << " from " << m_conn->Host() << ":" << toString(m_conn->Port());
-            m_getwork_timer.expires_from_now(boost::posix_time::seconds(30));
-            m_getwork_timer.async_wait(m_io_strand.wrap(
-                boost::bind(&EthGetworkClient::getwork_timer_elapsed, this, boost::asio::placeholders::error)));
+            schedule_getwork(boost::posix_time::seconds(30));
         }
         else
         {
@@ -439,24 +752,22 @@ void EthGetworkClient::processResponse(Json::Value& JRes)
                     if (m_onWorkReceived)
                         m_onWorkReceived(m_current);
                 }
-                m_getwork_timer.expires_from_now(boost::posix_time::milliseconds(m_farmRecheckPeriod));
-                m_getwork_timer.async_wait(m_io_strand.wrap(
-                    boost::bind(&EthGetworkClient::getwork_timer_elapsed, this, boost::asio::placeholders::error)));
+                next_getwork();
             }
         }
     }
     else if (_id == 9)
     {
         // Response to hashrate submission
-        // Actually don't do anything
+        // Actually don't do anything but timing
+        accountPendingRtt(PoolRequest::Hashrate);
     }
     else if (_id >= 40 && _id <= m_solution_submitted_max_id)
     {
         if (_isSuccess && JRes["result"].isConvertibleTo(Json::ValueType::booleanValue))
             _isSuccess = JRes["result"].asBool();
 
-        std::chrono::milliseconds _delay =
-            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_pending_tstamp);
+        std::chrono::milliseconds _delay = accountPendingRtt(PoolRequest::Submit);
 
         const unsigned miner_index = _id - 40;
         if (_isSuccess)
@@ -472,6 +783,15 @@ void EthGetworkClient::processResponse(Json::Value& JRes)
     }
 }
 
+std::chrono::milliseconds EthGetworkClient::accountPendingRtt(PoolRequest _request)
+{
+    // Responses come in request order : the pending one is the one answered
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_pending_tstamp;
+    if (m_conn)
+        m_conn->Stats().recordRtt(_request, elapsed);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+}
+
 std::string EthGetworkClient::processError(Json::Value& JRes)
 {
     std::string retVar;
@@ -507,19 +827,30 @@ std::string EthGetworkClient::processError(Json::Value& JRes)
     return retVar;
 }
 
-void EthGetworkClient::send(Json::Value const& jReq)
+void EthGetworkClient::send(Channel* _ch, Json::Value const& jReq)
+{
+    std::string line = Json::writeString(m_jSwBuilder, jReq);
+    TxBuffer* buffer = m_txPool.get();
+    buffer->id = jReq.get("id", unsigned(0)).asUInt();
+    buffer->data.assign(line.begin(), line.end());
+    send(_ch, buffer);
+}
+
+void EthGetworkClient::send(Channel* _ch, std::string const& sReq, unsigned _id)
 {
-    send(std::string(Json::writeString(m_jSwBuilder, jReq)));
+    TxBuffer* buffer = m_txPool.get();
+    buffer->id = _id;
+    buffer->data.assign(sReq.begin(), sReq.end());
+    send(_ch, buffer);
 }
 
-void EthGetworkClient::send(std::string const& sReq)
+void EthGetworkClient::send(Channel* _ch, TxBuffer* _buffer)
 {
-    std::string* line = new std::string(sReq);
-    m_txQueue.push(line);
+    _ch->txQueue.push(_buffer);
 
     bool ex = false;
-    if (m_txPending.compare_exchange_strong(ex, true, std::memory_order_relaxed))
-        begin_connect();
+    if (_ch->txPending.compare_exchange_strong(ex, true, std::memory_order_relaxed))
+        m_io_strand.post(boost::bind(&EthGetworkClient::channel_flush, this, _ch));
 }
 
 void EthGetworkClient::submitHashrate(uint64_t const& rate, string const& id)
@@ -534,7 +865,7 @@ void EthGetworkClient::submitHashrate(uint64_t const& rate, string const& id)
         jReq["params"] = Json::Value(Json::arrayValue);
         jReq["params"].append(toHex(rate, HexPrefix::Add));  // Already expressed as hex
         jReq["params"].append(id);                           // Already prefixed by 0x
-        send(jReq);
+        send(&m_submit, jReq);
     }
 }
 
@@ -542,21 +873,46 @@ void EthGetworkClient::submitSolution(const Solution& solution)
 {
     if (m_session)
     {
-        Json::Value jReq;
-        string nonceHex = toHex(solution.nonce);
-
         unsigned id = 40 + solution.midx;
-        jReq["id"] = id;
         m_solution_submitted_max_id = max(m_solution_submitted_max_id, id);
-        jReq["method"] = "axis_submitWork";
-        jReq["params"] = Json::Value(Json::arrayValue);
-        jReq["params"].append("0x" + nonceHex);
-        jReq["params"].append("0x" + solution.work.header.hex());
-        jReq["params"].append("0x" + solution.mixHash.hex());
-        send(jReq);
+
+        TxBuffer* buffer = m_txPool.get();
+        buffer->id = id;
+        m_submitTemplate.render(id, solution, buffer->data);
+        send(&m_submit, buffer);
+    }
+}
+
+void EthGetworkClient::request_getwork()
+{
+    send(&m_work, m_jsonGetWork, 1);
+
+    // Long polls are answered when work changes. If it takes longer
+    // than the work timeout the node is stuck
+    if (m_longPoll)
+    {
+        m_longPollPending = true;
+        schedule_getwork(boost::posix_time::seconds(m_worktimeout));
     }
 }
 
+// Polls again after m_farmRecheckPeriod ms. Long polls are issued again
+// right away
+void EthGetworkClient::next_getwork()
+{
+    if (m_longPoll)
+        request_getwork();
+    else
+        schedule_getwork(boost::posix_time::milliseconds(m_farmRecheckPeriod));
+}
+
+void EthGetworkClient::schedule_getwork(boost::posix_time::time_duration _delay)
+{
+    m_getwork_timer.expires_from_now(_delay);
+    m_getwork_timer.async_wait(m_io_strand.wrap(
+        boost::bind(&EthGetworkClient::getwork_timer_elapsed, this, boost::asio::placeholders::error)));
+}
+
 void EthGetworkClient::getwork_timer_elapsed(const boost::system::error_code& ec)
 {
     // Triggers the resubmission of a getWork request
@@ -565,15 +921,15 @@ void EthGetworkClient::getwork_timer_elapsed(const boost::system::error_code& ec
         // Check if last work is older than timeout
         std::chrono::seconds _delay =
             std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - m_current_tstamp);
-        if (_delay.count() > m_worktimeout)
+        if (_delay.count() > m_worktimeout || m_longPollPending)
         {
             cwarn << "No new work received in " << m_worktimeout << " seconds.";
-            m_endpoints.pop();
+            pop_endpoint(m_work.endpoint);
             disconnect();
         }
         else
         {
-            send(m_jsonGetWork);
+            request_getwork();
         }
     }
 }
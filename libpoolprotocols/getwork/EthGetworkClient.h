@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <deque>
 #include <iostream>
 #include <string>
 
@@ -11,6 +13,8 @@
 #include <json/json.h>
 
 #include "../PoolClient.h"
+#include "../StratumParser.h"
+#include "../SubmitTemplate.h"
 
 using namespace std;
 using namespace dev;
@@ -31,36 +35,103 @@ public:
 private:
     unsigned m_farmRecheckPeriod = 500;  // In milliseconds
 
-    void begin_connect();
+    // A request written and waiting for its response
+    struct InFlight
+    {
+        TxBuffer* buffer;
+        std::chrono::steady_clock::time_point sent;
+    };
+
+    // A keep-alive HTTP/1.1 connection to the node. Queued requests are
+    // pipelined : all written at once, responses come back in the same
+    // order. Connects on first request and reconnects when the node
+    // closes it
+    struct Channel
+    {
+        Channel(char const* _name) : name(_name), socket(g_io_service), txQueue(1024) {}
+
+        char const* name;  // For logging
+        boost::asio::ip::tcp::socket socket;
+        std::string head;  // Request line and headers up to Content-Length value
+
+        std::atomic<bool> txPending = {false};  // Whether or not a flush is due
+        boost::lockfree::queue<TxBuffer*> txQueue;
+        std::deque<TxBuffer*> txWaiting;  // Taken off the queue (or to be written again) and not written yet
+        std::deque<InFlight> inFlight;    // Oldest first
+
+        // Gather write in progress
+        std::string txHead;
+        std::vector<std::array<char, 64>> txTails;  // Content-Length value and end of headers
+        std::vector<boost::asio::const_buffer> txGather;
+
+        boost::asio::ip::tcp::endpoint endpoint;  // Last one connected or tried
+        bool connecting = false;
+        bool writing = false;
+        unsigned served = 0;  // Responses received on current connection
+        boost::asio::streambuf response;
+    };
+
+    // A response framed in the receive buffer
+    struct HttpResponse
+    {
+        std::string status;    // Status code and reason
+        bool close = false;    // Whether or not the node closes the connection after it
+        std::string body;      // Decoded from chunks if needed
+        std::string longPoll;  // X-Long-Polling header
+    };
+    static size_t parseHttpResponse(std::string const& _rx, size_t _offset, bool _eof, HttpResponse& _response);
+
+    std::string httpHead(std::string const& _path);
     void handle_resolve(const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::iterator i);
-    void handle_connect(const boost::system::error_code& ec);
-    void handle_write(const boost::system::error_code& ec);
-    void handle_read(const boost::system::error_code& ec, std::size_t bytes_transferred);
+    void channel_flush(Channel* _ch);
+    void channel_connect(Channel* _ch);
+    void pop_endpoint(boost::asio::ip::tcp::endpoint const& _endpoint);
+    void channel_write(Channel* _ch);
+    void channel_read(Channel* _ch);
+    void channel_close(Channel* _ch, bool _retry);
+    void channel_lost(Channel* _ch);
+    void handle_connect(Channel* _ch, const boost::system::error_code& ec);
+    void handle_write(Channel* _ch, const boost::system::error_code& ec);
+    void handle_read(Channel* _ch, const boost::system::error_code& ec, std::size_t bytes_transferred);
+    bool processHttpResponse(Channel* _ch, HttpResponse& _response);
     std::string processError(Json::Value& JRes);
     void processResponse(Json::Value& JRes);
-    void send(Json::Value const& jReq);
-    void send(std::string const& sReq);
+    bool processFastResponse(StratumMessage const& _msg);
+    std::chrono::milliseconds accountPendingRtt(PoolRequest _request);
+    void send(Channel* _ch, Json::Value const& jReq);
+    void send(Channel* _ch, std::string const& sReq, unsigned _id);
+    void send(Channel* _ch, TxBuffer* _buffer);
+    void request_getwork();
+    void next_getwork();
+    void schedule_getwork(boost::posix_time::time_duration _delay);
     void getwork_timer_elapsed(const boost::system::error_code& ec);
 
     WorkPackage m_current;
 
     std::atomic<bool> m_connecting = {false};  // Whether or not socket is on first try connect
-    std::atomic<bool> m_txPending = {false};   // Whether or not an async socket operation is pending
-    boost::lockfree::queue<std::string*> m_txQueue;
+    TxBufferPool m_txPool;
 
     boost::asio::io_service::strand m_io_strand;
 
-    boost::asio::ip::tcp::socket m_socket;
+    // getWork requests on their own connection so that solutions and
+    // hashrates never wait behind a poll
+    Channel m_work;
+    Channel m_submit;
+
     boost::asio::ip::tcp::resolver m_resolver;
     std::queue<boost::asio::ip::basic_endpoint<boost::asio::ip::tcp>> m_endpoints;
 
-    boost::asio::streambuf m_request;
-    boost::asio::streambuf m_response;
     Json::StreamWriterBuilder m_jSwBuilder;
     std::string m_jsonGetWork;
-    Json::Value m_pendingJReq;
+    SubmitTemplate m_submitTemplate;  // axis_submitWork request
+    unsigned m_pendingId = 0;         // Json id of the request being answered
     std::chrono::time_point<std::chrono::steady_clock> m_pending_tstamp;
 
+    // Nodes sending an X-Long-Polling header answer getWork requests to
+    // that path only when work changes (or on their own timeout)
+    bool m_longPoll = false;
+    bool m_longPollPending = false;  // Whether or not a long poll waits for its response
+
     boost::asio::deadline_timer m_getwork_timer;  // The timer which triggers getWork requests
 
     // seconds to trigger a work_timeout (overwritten in constructor)
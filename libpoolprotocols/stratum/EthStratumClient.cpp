@@ -1,5 +1,6 @@
 #include <axisminer/buildinfo.h>
 #include <libdevcore/Log.h>
+#include <libdevcore/Target.h>
 #include <ethash/ethash.hpp>
 
 #include "EthStratumClient.h"
@@ -11,6 +12,13 @@
 
 using boost::asio::ip::tcp;
 
+Mutex EthStratumClient::x_resolved;
+Mutex EthStratumClient::x_tls;
+Mutex EthStratumClient::x_resumable;
+std::map<std::string, std::shared_ptr<EthStratumClient::TlsContext>> EthStratumClient::s_tls;
+std::map<std::string, EthStratumClient::ResolvedHost> EthStratumClient::s_resolved;
+std::map<std::string, EthStratumClient::ResumableSession> EthStratumClient::s_resumable;
+
 EthStratumClient::EthStratumClient(int worktimeout, int responsetimeout)
   : PoolClient(),
     m_worktimeout(worktimeout),
@@ -18,11 +26,13 @@ EthStratumClient::EthStratumClient(int worktimeout, int responsetimeout)
     m_io_service(g_io_service),
     m_io_strand(g_io_service),
     m_socket(nullptr),
+    m_recvBuffer(POOLCLIENT_MAX_MESSAGE_LENGTH),
     m_workloop_timer(g_io_service),
-    m_response_plea_times(64),
     m_txQueue(64),
+    m_txPool(64, 512),
     m_resolver(g_io_service),
-    m_endpoints()
+    m_endpoints(),
+    m_connect_timer(g_io_service)
 {
     m_jSwBuilder.settings_["indentation"] = "";
 
@@ -34,17 +44,91 @@ EthStratumClient::EthStratumClient(int worktimeout, int responsetimeout)
 }
 
 
+std::shared_ptr<EthStratumClient::TlsContext> EthStratumClient::tls_context()
+{
+    Guard l(x_tls);
+    std::shared_ptr<TlsContext>& tls = s_tls[m_conn->str()];
+    if (tls)
+        return tls;
+
+    boost::asio::ssl::context::method method = boost::asio::ssl::context::tls_client;
+    if (m_conn->SecLevel() == SecureLevel::TLS12)
+        method = boost::asio::ssl::context::tlsv12;
+
+    tls = std::make_shared<TlsContext>(method);
+    boost::asio::ssl::context& ctx = tls->context;
+
+    // Sessions negotiated are handed to tls_new_session() which keeps the
+    // last one. TLS 1.3 tickets may come after the handshake
+    SSL_CTX_set_app_data(ctx.native_handle(), tls.get());
+    SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx.native_handle(), &EthStratumClient::tls_new_session);
+
+#ifdef _WIN32
+    HCERTSTORE hStore = CertOpenSystemStore(0, "ROOT");
+    if (hStore == nullptr)
+    {
+        return tls;
+    }
+
+    X509_STORE* store = X509_STORE_new();
+    PCCERT_CONTEXT pContext = nullptr;
+    while ((pContext = CertEnumCertificatesInStore(hStore, pContext)) != nullptr)
+    {
+        X509* x509 = d2i_X509(nullptr, (const unsigned char**)&pContext->pbCertEncoded, pContext->cbCertEncoded);
+        if (x509 != nullptr)
+        {
+            X509_STORE_add_cert(store, x509);
+            X509_free(x509);
+        }
+    }
+
+    CertFreeCertificateContext(pContext);
+    CertCloseStore(hStore, 0);
+
+    SSL_CTX_set_cert_store(ctx.native_handle(), store);
+#else
+    char* certPath = getenv("SSL_CERT_FILE");
+    try
+    {
+        ctx.load_verify_file(certPath ? certPath : "/etc/ssl/certs/ca-certificates.crt");
+    }
+    catch (...)
+    {
+        cwarn << "Failed to load ca certificates. Either the file "
+                 "'/etc/ssl/certs/ca-certificates.crt' does not exist";
+        cwarn << "or the environment variable SSL_CERT_FILE is set to an invalid or "
+                 "inaccessible file.";
+        cwarn << "It is possible that certificate verification can fail.";
+    }
+#endif
+
+    return tls;
+}
+
+int EthStratumClient::tls_new_session(SSL* _ssl, SSL_SESSION* _session)
+{
+    TlsContext* tls = static_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(_ssl)));
+    if (!tls)
+        return 0;
+
+    Guard l(tls->x_session);
+    if (tls->session)
+        SSL_SESSION_free(tls->session);
+    tls->session = _session;
+
+    // We keep the reference
+    return 1;
+}
+
 void EthStratumClient::init_socket()
 {
     // Prepare Socket
     if (m_conn->SecLevel() != SecureLevel::NONE)
     {
-        boost::asio::ssl::context::method method = boost::asio::ssl::context::tls_client;
-        if (m_conn->SecLevel() == SecureLevel::TLS12)
-            method = boost::asio::ssl::context::tlsv12;
-
-        boost::asio::ssl::context ctx(method);
-        m_securesocket = std::make_shared<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(m_io_service, ctx);
+        m_tls = tls_context();
+        m_securesocket =
+            std::make_shared<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(m_io_service, m_tls->context);
         m_socket = &m_securesocket->next_layer();
 
         if (getenv("SSL_NOVERIFY"))
@@ -57,44 +141,6 @@ void EthStratumClient::init_socket()
             m_securesocket->set_verify_callback(
                 make_verbose_verification(boost::asio::ssl::rfc2818_verification(m_conn->Host())));
         }
-#ifdef _WIN32
-        HCERTSTORE hStore = CertOpenSystemStore(0, "ROOT");
-        if (hStore == nullptr)
-        {
-            return;
-        }
-
-        X509_STORE* store = X509_STORE_new();
-        PCCERT_CONTEXT pContext = nullptr;
-        while ((pContext = CertEnumCertificatesInStore(hStore, pContext)) != nullptr)
-        {
-            X509* x509 = d2i_X509(nullptr, (const unsigned char**)&pContext->pbCertEncoded, pContext->cbCertEncoded);
-            if (x509 != nullptr)
-            {
-                X509_STORE_add_cert(store, x509);
-                X509_free(x509);
-            }
-        }
-
-        CertFreeCertificateContext(pContext);
-        CertCloseStore(hStore, 0);
-
-        SSL_CTX_set_cert_store(ctx.native_handle(), store);
-#else
-        char* certPath = getenv("SSL_CERT_FILE");
-        try
-        {
-            ctx.load_verify_file(certPath ? certPath : "/etc/ssl/certs/ca-certificates.crt");
-        }
-        catch (...)
-        {
-            cwarn << "Failed to load ca certificates. Either the file "
-                     "'/etc/ssl/certs/ca-certificates.crt' does not exist";
-            cwarn << "or the environment variable SSL_CERT_FILE is set to an invalid or "
-                     "inaccessible file.";
-            cwarn << "It is possible that certificate verification can fail.";
-        }
-#endif
     }
     else
     {
@@ -129,17 +175,30 @@ void EthStratumClient::connect()
 
     // Reset status flags
     m_authpending.store(false, std::memory_order_relaxed);
+    m_resumable = false;
 
     // Initializes socket and eventually secure stream
     if (!m_socket)
         init_socket();
 
     // Initialize a new queue of end points
-    m_endpoints = std::queue<boost::asio::ip::basic_endpoint<boost::asio::ip::tcp>>();
+    m_endpoints.clear();
     m_endpoint = boost::asio::ip::basic_endpoint<boost::asio::ip::tcp>();
 
     if (m_conn->HostNameType() == dev::UriHostNameType::Dns || m_conn->HostNameType() == dev::UriHostNameType::Basic)
     {
+        // Reuse addresses recently resolved
+        {
+            Guard l(x_resolved);
+            auto it = s_resolved.find(m_conn->Host() + ":" + toString(m_conn->Port()));
+            if (it != s_resolved.end() && it->second.expiry > std::chrono::steady_clock::now())
+            {
+                set_endpoints(it->second.endpoints);
+                m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::start_connect, this)));
+                return;
+            }
+        }
+
         // Begin resolve all ips associated to hostname
         // calling the resolver each time is useful as most
         // load balancer will give Ips in different order
@@ -153,7 +212,7 @@ void EthStratumClient::connect()
     else
     {
         // No need to use the resolver if host is already an IP address
-        m_endpoints.push(
+        m_endpoints.push_back(
             boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(m_conn->Host()), m_conn->Port()));
         m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::start_connect, this)));
     }
@@ -168,6 +227,10 @@ void EthStratumClient::disconnect()
 
     m_connected.store(false, memory_order_relaxed);
 
+    // Drop connection attempts still racing
+    if (m_connecting.load(memory_order_relaxed))
+        m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::abort_connect, this)));
+
     // Cancel any outstanding async operation
     if (m_socket)
         m_socket->cancel();
@@ -185,7 +248,7 @@ void EthStratumClient::disconnect()
                 // As there may be a connection issue we also endorse a timeout
                 m_securesocket->async_shutdown(m_io_strand.wrap(
                     boost::bind(&EthStratumClient::onSSLShutdownCompleted, this, boost::asio::placeholders::error)));
-                enqueue_response_plea();
+                enqueue_response_plea(0);
 
 
                 // Rest of disconnection is performed asynchronously
@@ -226,7 +289,10 @@ void EthStratumClient::disconnect_finalize()
 
     // Release session if exits
     if (m_session)
+    {
         m_conn->addDuration(m_session->duration());
+        save_session();
+    }
     m_session = nullptr;
 
     m_authpending.store(false, std::memory_order_relaxed);
@@ -275,13 +341,22 @@ void EthStratumClient::resolve_handler(const boost::system::error_code& ec, tcp:
 {
     if (!ec)
     {
+        std::vector<tcp::endpoint> endpoints;
         while (i != tcp::resolver::iterator())
         {
-            m_endpoints.push(i->endpoint());
+            endpoints.push_back(i->endpoint());
             i++;
         }
         m_resolver.cancel();
 
+        {
+            Guard l(x_resolved);
+            ResolvedHost& host = s_resolved[m_conn->Host() + ":" + toString(m_conn->Port())];
+            host.endpoints = endpoints;
+            host.expiry = std::chrono::steady_clock::now() + std::chrono::seconds(c_resolvedTtl);
+        }
+        set_endpoints(endpoints);
+
         // Resolver has finished so invoke connection asynchronously
         m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::start_connect, this)));
     }
@@ -297,6 +372,30 @@ void EthStratumClient::resolve_handler(const boost::system::error_code& ec, tcp:
     }
 }
 
+void EthStratumClient::set_endpoints(std::vector<tcp::endpoint> const& _endpoints)
+{
+    // Alternate address families starting with the one of the first
+    // address, so that a broken family costs one attempt delay only
+    std::deque<tcp::endpoint> first, other;
+    for (auto const& ep : _endpoints)
+        (ep.address().is_v6() == _endpoints.front().address().is_v6() ? first : other).push_back(ep);
+
+    m_endpoints.clear();
+    while (!first.empty() || !other.empty())
+    {
+        if (!first.empty())
+        {
+            m_endpoints.push_back(first.front());
+            first.pop_front();
+        }
+        if (!other.empty())
+        {
+            m_endpoints.push_back(other.front());
+            other.pop_front();
+        }
+    }
+}
+
 void EthStratumClient::start_connect()
 {
     if (m_connecting.load(std::memory_order_relaxed))
@@ -305,44 +404,149 @@ void EthStratumClient::start_connect()
 
     if (!m_endpoints.empty())
     {
-        // Pick the first endpoint in list.
-        // Eventually endpoints get discarded on connection errors
-        m_endpoint = m_endpoints.front();
-
         // Re-init socket if we need to
         if (m_socket == nullptr)
             init_socket();
 
+        clear_response_pleas();
+        m_solution_submitted_max_id = 0;
+
+        // Start racing. Connected socket is moved in the one of the stream
+        m_attempts.clear();
+        start_attempt();
+    }
+    else
+    {
+        m_connecting.store(false, std::memory_order_relaxed);
+        cwarn << "No more IP addresses to try for host: " << m_conn->Host();
+
+        // We "simulate" a disconnect, to ensure a fully shutdown state
+        disconnect_finalize();
+    }
+}
+
+void EthStratumClient::start_attempt()
+{
+    ConnectAttempt attempt;
+    attempt.socket = std::make_shared<tcp::socket>(m_io_service);
+    attempt.endpoint = m_endpoints.front();
+    attempt.start = std::chrono::steady_clock::now();
+    m_endpoints.pop_front();
+
 #ifdef _DEVELOPER
-        if (g_logOptions & LOG_CONNECT)
-            cnote << ("Trying " + toString(m_endpoint) + " ...");
+    if (g_logOptions & LOG_CONNECT)
+        cnote << ("Trying " + toString(attempt.endpoint) + " ...");
 #endif
 
-        clear_response_pleas();
-        m_connecting.store(true, std::memory_order::memory_order_relaxed);
-        enqueue_response_plea();
-        m_solution_submitted_max_id = 0;
+    attempt.socket->async_connect(attempt.endpoint, m_io_strand.wrap(boost::bind(&EthStratumClient::attempt_handler,
+                                                        this, attempt.socket, boost::asio::placeholders::error)));
+    m_attempts.push_back(attempt);
 
-        // Start connecting async
-        if (m_conn->SecLevel() != SecureLevel::NONE)
-        {
-            m_securesocket->lowest_layer().async_connect(
-                m_endpoint, m_io_strand.wrap(boost::bind(&EthStratumClient::connect_handler, this, _1)));
-        }
-        else
+    m_connect_timer.expires_from_now(boost::posix_time::milliseconds(c_attemptDelay));
+    m_connect_timer.async_wait(m_io_strand.wrap(
+        boost::bind(&EthStratumClient::connect_timer_elapsed, this, boost::asio::placeholders::error)));
+}
+
+void EthStratumClient::connect_timer_elapsed(const boost::system::error_code& ec)
+{
+    if (ec || m_attempts.empty())
+        return;
+
+    // Attempts running for longer than response timeout are cancelled.
+    // Their handlers account them as failed
+    auto now = std::chrono::steady_clock::now();
+    for (auto const& attempt : m_attempts)
+        if (now - attempt.start >= std::chrono::seconds(m_responsetimeout))
         {
-            m_socket->async_connect(
-                m_endpoint, m_io_strand.wrap(boost::bind(&EthStratumClient::connect_handler, this, _1)));
+            boost::system::error_code sec;
+            attempt.socket->close(sec);
         }
+
+    if (!m_endpoints.empty())
+    {
+        start_attempt();
     }
     else
     {
+        m_connect_timer.expires_from_now(boost::posix_time::milliseconds(c_attemptDelay));
+        m_connect_timer.async_wait(m_io_strand.wrap(
+            boost::bind(&EthStratumClient::connect_timer_elapsed, this, boost::asio::placeholders::error)));
+    }
+}
+
+void EthStratumClient::attempt_handler(std::shared_ptr<tcp::socket> _socket, const boost::system::error_code& ec)
+{
+    auto it = m_attempts.begin();
+    while (it != m_attempts.end() && it->socket != _socket)
+        it++;
+
+    // Race already settled
+    if (it == m_attempts.end())
+        return;
+
+    if (ec || !_socket->is_open())
+    {
+        cwarn << ("Error  " + toString(it->endpoint) + " [ " + (ec ? ec.message() : "Timeout") + " ]");
+
+        boost::system::error_code sec;
+        _socket->close(sec);
+        m_attempts.erase(it);
+
+        // Don't wait for the attempt delay to try next
+        if (!m_endpoints.empty())
+        {
+            start_attempt();
+            return;
+        }
+        if (!m_attempts.empty())
+            return;
+
+        // All addresses failed. Next connect resolves again
+        m_connect_timer.cancel();
+        {
+            Guard l(x_resolved);
+            s_resolved.erase(m_conn->Host() + ":" + toString(m_conn->Port()));
+        }
         m_connecting.store(false, std::memory_order_relaxed);
         cwarn << "No more IP addresses to try for host: " << m_conn->Host();
 
         // We "simulate" a disconnect, to ensure a fully shutdown state
         disconnect_finalize();
+        return;
     }
+
+    // Winner. Losers are given back to the list after it, so that
+    // reconnections (eg. stratum autodetection) start from it
+    m_connect_timer.cancel();
+    m_endpoint = it->endpoint;
+    for (auto const& attempt : m_attempts)
+    {
+        if (attempt.socket == _socket)
+            continue;
+        boost::system::error_code sec;
+        attempt.socket->close(sec);
+        m_endpoints.push_front(attempt.endpoint);
+    }
+    m_endpoints.push_front(m_endpoint);
+    m_attempts.clear();
+
+    *m_socket = std::move(*_socket);
+    connect_handler();
+}
+
+void EthStratumClient::abort_connect()
+{
+    if (m_attempts.empty())
+        return;
+
+    m_connect_timer.cancel();
+    for (auto const& attempt : m_attempts)
+    {
+        boost::system::error_code sec;
+        attempt.socket->close(sec);
+    }
+    m_attempts.clear();
+    m_connecting.store(false, std::memory_order_relaxed);
 }
 
 void EthStratumClient::workloop_timer_elapsed(const boost::system::error_code& ec)
@@ -370,26 +574,19 @@ void EthStratumClient::workloop_timer_elapsed(const boost::system::error_code& e
     }
 
 
-    if (m_response_pleas_count.load(std::memory_order_relaxed))
+    steady_clock::time_point response_plea_time;
+    if (m_response_pleas.oldest(response_plea_time))
     {
         milliseconds response_delay_ms(0);
-        steady_clock::time_point response_plea_time(m_response_plea_older.load(std::memory_order_relaxed));
 
         // Check responses while in connection/disconnection phase
         if (isPendingState())
         {
             response_delay_ms = duration_cast<milliseconds>(steady_clock::now() - response_plea_time);
 
+            // Connection attempts have their own timeouts (see connect_timer_elapsed)
             if ((m_responsetimeout * 1000) >= response_delay_ms.count())
             {
-                if (m_connecting.load(std::memory_order_relaxed))
-                {
-                    // The socket is closed so that any outstanding
-                    // asynchronous connection operations are cancelled.
-                    m_socket->close();
-                    return;
-                }
-
                 // This is set for SSL disconnection
                 if (m_disconnecting.load(std::memory_order_relaxed) && (m_conn->SecLevel() != SecureLevel::NONE))
                 {
@@ -425,7 +622,7 @@ void EthStratumClient::workloop_timer_elapsed(const boost::system::error_code& e
                 {
                     // Waiting for a response to solution submission
                     cwarn << "No response received in " << m_responsetimeout << " seconds.";
-                    m_endpoints.pop();
+                    m_endpoints.pop_front();
                     clear_response_pleas();
                     m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::disconnect, this)));
                 }
@@ -435,7 +632,7 @@ void EthStratumClient::workloop_timer_elapsed(const boost::system::error_code& e
                      (duration_cast<seconds>(steady_clock::now() - m_current_timestamp).count() > m_worktimeout))
             {
                 cwarn << "No new work received in " << m_worktimeout << " seconds.";
-                m_endpoints.pop();
+                m_endpoints.pop_front();
                 clear_response_pleas();
                 m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::disconnect, this)));
             }
@@ -448,41 +645,19 @@ void EthStratumClient::workloop_timer_elapsed(const boost::system::error_code& e
         boost::bind(&EthStratumClient::workloop_timer_elapsed, this, boost::asio::placeholders::error)));
 }
 
-void EthStratumClient::connect_handler(const boost::system::error_code& ec)
+void EthStratumClient::connect_handler()
 {
     // Set status completion
     m_connecting.store(false, std::memory_order_relaxed);
 
-
-    // Timeout has run before or we got error
-    if (ec || !m_socket->is_open())
-    {
-        cwarn << ("Error  " + toString(m_endpoint) + " [ " + (ec ? ec.message() : "Timeout") + " ]");
-
-        // We need to close the socket used in the previous connection attempt
-        // before starting a new one.
-        // In case of error, in fact, boost does not close the socket
-        // If socket is not opened it means we got timed out
-        if (m_socket->is_open())
-            m_socket->close();
-
-        // Discard this endpoint and try the next available.
-        // Eventually is start_connect which will check for an
-        // empty list.
-        m_endpoints.pop();
-        m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::start_connect, this)));
-
-        return;
-    }
-
     // We got a socket connection established
     m_conn->Responds(true);
     m_connected.store(true, memory_order_relaxed);
 
-    m_message.clear();
+    m_recvBuffer.clear();
 
     // Clear txqueue
-    m_txQueue.consume_all([](std::string* l) { delete l; });
+    m_txQueue.consume_all([this](TxBuffer* b) { m_txPool.put(b); });
 
 #ifdef _DEVELOPER
     if (g_logOptions & LOG_CONNECT)
@@ -495,8 +670,41 @@ void EthStratumClient::connect_handler(const boost::system::error_code& ec)
         m_securesocket->lowest_layer().set_option(boost::asio::socket_base::keep_alive(true));
         m_securesocket->lowest_layer().set_option(tcp::no_delay(true));
 
+        // Offer the last session negotiated with the pool for resumption.
+        // Server name is needed by most servers to find it
+        SSL* ssl = m_securesocket->native_handle();
+        if (m_conn->HostNameType() == dev::UriHostNameType::Dns ||
+            m_conn->HostNameType() == dev::UriHostNameType::Basic)
+            SSL_set_tlsext_host_name(ssl, m_conn->Host().c_str());
+        {
+            Guard l(m_tls->x_session);
+            if (m_tls->session)
+                SSL_set_session(ssl, m_tls->session);
+        }
+
+        auto handshakeStart = std::chrono::steady_clock::now();
         m_securesocket->handshake(boost::asio::ssl::stream_base::client, hec);
 
+        if (!hec)
+        {
+            auto handshakeTime = std::chrono::steady_clock::now() - handshakeStart;
+            bool resumed = SSL_session_reused(ssl);
+            m_conn->Stats().recordHandshake(handshakeTime, resumed);
+#ifdef _DEVELOPER
+            if (g_logOptions & LOG_CONNECT)
+                cnote << "TLS handshake " << (resumed ? "(resumed) " : "")
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(handshakeTime).count() << " ms.";
+#endif
+        }
+        else
+        {
+            // Don't offer again a session the server may have choked on
+            Guard l(m_tls->x_session);
+            if (m_tls->session)
+                SSL_SESSION_free(m_tls->session);
+            m_tls->session = nullptr;
+        }
+
         if (hec)
         {
             cwarn << "SSL/TLS Handshake failed: " << hec.message();
@@ -539,8 +747,6 @@ void EthStratumClient::connect_handler(const boost::system::error_code& ec)
         m_nonsecuresocket->set_option(tcp::no_delay(true));
     }
 
-    // Clean buffer from any previous stale data
-    m_sendBuffer.consume(4096);
     clear_response_pleas();
 
     /*
@@ -626,7 +832,7 @@ void EthStratumClient::connect_handler(const boost::system::error_code& ec)
     if no response within that time consider the tentative login failed
     and switch to next stratum mode test
     */
-    enqueue_response_plea();
+    enqueue_response_plea(1);
     send(jReq);
 }
 
@@ -636,11 +842,91 @@ void EthStratumClient::startSession()
     m_session = unique_ptr<Session>(new Session());
     m_current_timestamp = std::chrono::steady_clock::now();
 
+    // EthereumStratum/2.0.0 sessions are accounted once subscribed
+    if (m_conn->StratumMode() != ETHEREUMSTRATUM2)
+        m_conn->Stats().accountSession(false);
+
     // Invoke higher level handlers
     if (m_onConnected)
         m_onConnected();
 }
 
+/*
+ * Leaves the session of an EthereumStratum/2.0.0 connection lost for the
+ * next client to resume. Only sessions the active client lost unexpectedly
+ * are kept : not the ones of standby clients, disconnected on purpose,
+ * which the server said it can't resume or closed with mining.bye.
+ */
+void EthStratumClient::save_session()
+{
+    m_resumable = false;
+    if (isStandby() || isDeliberateDisconnect())
+        return;
+    if (m_conn->StratumMode() != ETHEREUMSTRATUM2 || !m_session->resume || !isAuthorized() ||
+        !m_session->firstMiningSet || m_conn->IsUnrecoverable())
+        return;
+
+    ResumableSession r;
+    r.sessionId = m_session->sessionId;
+    r.workerId = m_session->workerId;
+    r.extraNonce = m_session->extraNonce;
+    r.extraNonceSizeBytes = m_session->extraNonceSizeBytes;
+    r.nextWorkBoundary = m_session->nextWorkBoundary;
+    r.epoch = m_session->epoch;
+    r.timeout = m_session->timeout;
+    r.expiry = std::chrono::steady_clock::now() + std::chrono::seconds(m_session->timeout);
+
+    Guard l(x_resumable);
+    s_resumable[m_conn->str()] = r;
+    m_resumable = true;
+}
+
+// Gets the id of the session left on this connection if still in time
+std::string EthStratumClient::resumable_session()
+{
+    Guard l(x_resumable);
+    auto it = s_resumable.find(m_conn->str());
+    if (it == s_resumable.end())
+        return std::string();
+    if (it->second.expiry <= std::chrono::steady_clock::now())
+    {
+        s_resumable.erase(it);
+        return std::string();
+    }
+    return it->second.sessionId;
+}
+
+/*
+ * Restores the session asked for on subscription if the server gave the
+ * same id back. Either way it can't be resumed again.
+ */
+bool EthStratumClient::resume_session()
+{
+    std::string id;
+    id.swap(m_resumeId);
+    if (id.empty())
+        return false;
+
+    Guard l(x_resumable);
+    auto it = s_resumable.find(m_conn->str());
+    if (it == s_resumable.end())
+        return false;
+    ResumableSession r = it->second;
+    s_resumable.erase(it);
+    if (r.sessionId != id || m_session->sessionId != id)
+        return false;
+
+    m_session->workerId = r.workerId;
+    m_session->extraNonce = r.extraNonce;
+    m_session->extraNonceSizeBytes = r.extraNonceSizeBytes;
+    m_session->nextWorkBoundary = r.nextWorkBoundary;
+    m_session->epoch = r.epoch;
+    m_session->timeout = r.timeout;
+    m_session->firstMiningSet = true;
+    m_session->authorized.store(true, memory_order_relaxed);
+    return true;
+}
+
 std::string EthStratumClient::processError(Json::Value& responseObject)
 {
     std::string retVar;
@@ -684,6 +970,207 @@ void EthStratumClient::processExtranonce(std::string& enonce)
     m_session->extraNonce = std::stoul(enonce, nullptr, 16);
 }
 
+/*
+    Handles the frequent messages (jobs, difficulty and share responses)
+    straight from the scanned line. Anything not matching exactly the
+    shape processResponse() would handle the same way returns false
+    before any state is touched and is handed to jsoncpp
+*/
+bool EthStratumClient::processFastResponse(StratumMessage const& _msg)
+{
+    if (_msg.rpc2 && !StratumMessage::equals(_msg.jsonrpc, "2.0"))
+        return false;
+
+    unsigned mode = m_conn->StratumMode();
+
+    // Responses to mining.submit
+    if (_msg.method.empty() && _msg.idType == JsonScalar::Number && _msg.id >= 40 &&
+        _msg.id <= m_solution_submitted_max_id)
+    {
+        if (_msg.result == JsonScalar::Array)
+            return false;
+
+        std::chrono::milliseconds response_delay_ms = dequeue_response_plea(_msg.id, PoolRequest::Submit);
+
+        // EthereumStratum/2.0.0 signals rejects with errors only
+        bool isSuccess = (mode == ETHEREUMSTRATUM2 || _msg.result != JsonScalar::False);
+
+        const unsigned miner_index = _msg.id - 40;
+        if (isSuccess)
+        {
+            if (m_onSolutionAccepted)
+                m_onSolutionAccepted(response_delay_ms, miner_index, false);
+        }
+        else
+        {
+            if (m_onSolutionRejected)
+            {
+                cwarn << "Reject reason : Unspecified";
+                m_onSolutionRejected(response_delay_ms, miner_index);
+            }
+        }
+        return true;
+    }
+
+    // Eth-proxy jobs may come as result of a get_work
+    bool isProxyJob = (_msg.method.empty() && mode == ETHPROXY && _msg.result == JsonScalar::Array &&
+                       (_msg.id == 0 || _msg.id == 5));
+    bool isNotification = (!_msg.method.empty() || isProxyJob);
+
+    if (!isNotification || !_msg.paramsCount || !m_session || !m_conn->StratumModeConfirmed())
+        return false;
+
+    if ((_msg.isMethod("mining.notify") || isProxyJob) && mode != ETHEREUMSTRATUM2)
+    {
+        if (_msg.paramsObject)
+            return false;
+
+        // Discard jobs if not properly subscribed
+        // or if a job for this transmission has already
+        // been processed
+        if (!isSubscribed() || m_newjobprocessed)
+            return true;
+
+        h256 seed, header, boundary;
+
+        if (mode == ETHEREUMSTRATUM)
+        {
+            if (_msg.paramsCount < 3 || _msg.types[0] != JsonScalar::String ||
+                _msg.types[1] != JsonScalar::String || _msg.types[2] != JsonScalar::String ||
+                !hexToHash(_msg.params[1], seed) || !hexToHash(_msg.params[2], header))
+                return false;
+
+            m_current.job.assign(_msg.params[0].data(), _msg.params[0].size());
+            m_current.seed = seed;
+            m_current.header = header;
+            m_current.boundary = m_session->nextWorkBoundary;
+            m_current.startNonce = m_session->extraNonce;
+            m_current.exSizeBytes = m_session->extraNonceSizeBytes;
+            m_current.cleanJobs = (_msg.paramsCount > 3 && _msg.types[3] == JsonScalar::True);
+            m_current.block = -1;
+        }
+        else
+        {
+            // Nanopool sends eth-proxy jobs as result (see issue # 1348)
+            unsigned prmIdx = (mode == ETHPROXY && _msg.paramsFromResult) ? 0 : 1;
+            if (_msg.paramsCount < prmIdx + 3 || _msg.types[prmIdx] != JsonScalar::String ||
+                _msg.types[prmIdx + 1] != JsonScalar::String || _msg.types[prmIdx + 2] != JsonScalar::String ||
+                !hexToHash(_msg.params[prmIdx], header) || !hexToHash(_msg.params[prmIdx + 1], seed) ||
+                !hexToHash(_msg.params[prmIdx + 2], boundary))
+                return false;
+            prmIdx += 3;
+
+            // Only some eth-proxy compatible implementations carry the block number
+            // namely ethermine.org. Anything beyond 50 years of 10s blocks is junk
+            uint64_t block = uint64_t(-1);
+            if (mode == ETHPROXY && _msg.paramsCount > prmIdx)
+            {
+                if (_msg.types[prmIdx] != JsonScalar::String && _msg.types[prmIdx] != JsonScalar::Number)
+                    return false;
+                if (!parseUnsigned(_msg.params[prmIdx], false, block))
+                    return false;
+                if (block > 0x9660180)
+                    block = uint64_t(-1);
+            }
+
+            m_current.job.assign(_msg.params[0].data(), _msg.params[0].size());
+            m_current.block = int(block);
+            m_current.seed = seed;
+            m_current.header = header;
+            m_current.boundary = boundary;
+            m_current.cleanJobs = false;  // No such flag : PoolManager checks block changes
+        }
+
+        m_current_timestamp = std::chrono::steady_clock::now();
+
+        // This will signal to dispatch the job
+        // at the end of the transmission.
+        m_newjobprocessed = true;
+        return true;
+    }
+
+    if (_msg.isMethod("mining.notify") && mode == ETHEREUMSTRATUM2)
+    {
+        // Out of order or malformed jobs have their warnings in processResponse()
+        if (!m_session->firstMiningSet || _msg.paramsObject || _msg.paramsCount != 4)
+            return false;
+
+        uint64_t block;
+        h256 header;
+        if (_msg.types[0] != JsonScalar::String || _msg.types[1] != JsonScalar::String ||
+            _msg.types[2] != JsonScalar::String || !parseUnsigned(_msg.params[1], true, block) ||
+            !hexToHash(_msg.params[2], header))
+            return false;
+
+        JsonScalar clean = _msg.types[3];
+
+        m_current.job.assign(_msg.params[0].data(), _msg.params[0].size());
+        m_current.block = int(block);
+        m_current.header = header;
+        m_current.boundary = m_session->nextWorkBoundary;
+        m_current.epoch = m_session->epoch;
+        m_current.startNonce = m_session->extraNonce;
+        m_current.exSizeBytes = m_session->extraNonceSizeBytes;
+        m_current.cleanJobs =
+            (clean == JsonScalar::True || (clean != JsonScalar::False && !StratumMessage::equals(_msg.params[3], "0")));
+        m_current_timestamp = std::chrono::steady_clock::now();
+
+        // This will signal to dispatch the job
+        // at the end of the transmission.
+        m_newjobprocessed = true;
+        return true;
+    }
+
+    if (_msg.isMethod("mining.set_difficulty") && mode == ETHEREUMSTRATUM)
+    {
+        if (_msg.paramsObject || _msg.types[0] != JsonScalar::Number)
+            return false;
+
+        // The number is followed by a delimiter within the line
+        double nextWorkDifficulty = max(std::strtod(_msg.params[0].data(), nullptr), 0.0001);
+        m_session->nextWorkBoundary = dev::diffToTarget(nextWorkDifficulty);
+        return true;
+    }
+
+    if (_msg.isMethod("mining.set") && mode == ETHEREUMSTRATUM2)
+    {
+        if (!_msg.paramsObject)
+            return false;
+        for (unsigned i = 0; i < _msg.paramsCount; i++)
+            if (_msg.types[i] != JsonScalar::String)
+                return false;
+
+        JsonRef timeout = _msg.param("timeout");
+        JsonRef epoch = _msg.param("epoch");
+        JsonRef target = _msg.param("target");
+        JsonRef enonce = _msg.param("extranonce");
+
+        uint64_t timeoutValue = 0, epochValue = 0, enonceValue;
+        h256 boundary;
+        if ((!timeout.empty() && !parseUnsigned(timeout, true, timeoutValue)) ||
+            (!epoch.empty() && !parseUnsigned(epoch, true, epochValue)) ||
+            (!target.empty() && !hexToHash(target, boundary)) ||
+            (!enonce.empty() && !parseUnsigned(enonce, true, enonceValue)))
+            return false;
+
+        m_session->firstMiningSet = true;
+        if (!timeout.empty())
+            m_session->timeout = unsigned(timeoutValue);
+        if (!epoch.empty())
+            m_session->epoch = unsigned(epochValue);
+        if (!target.empty())
+            m_session->nextWorkBoundary = boundary;
+        if (!enonce.empty())
+        {
+            string s(enonce.data(), enonce.size());
+            processExtranonce(s);
+        }
+        return true;
+    }
+
+    return false;
+}
+
 void EthStratumClient::processResponse(Json::Value& responseObject)
 {
     // Store jsonrpc version to test against
@@ -739,7 +1226,8 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
 
         if (_id == 1)
         {
-            response_delay_ms = dequeue_response_plea();
+            response_delay_ms = dequeue_response_plea(
+                1, m_conn->StratumMode() == ETHPROXY ? PoolRequest::Authorize : PoolRequest::Subscribe);
 
             /*
             This is the response to very first message after connection.
@@ -804,10 +1292,22 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                     cnote << "Stratum mode : EthereumStratum/2.0.0";
                     startSession();
 
-                    // Send request for subscription
+                    // "resume" is "1" if server can resume sessions
+                    Json::Value jResume = jResult["resume"];
+                    m_session->resume = jResume.isString() ? (jResume.asString() == "1") :
+                                                             (jResume.isBool() && jResume.asBool());
+
+                    // Send request for subscription. Ask to resume the
+                    // session lost if any
                     jReq["id"] = unsigned(2);
                     jReq["method"] = "mining.subscribe";
-                    enqueue_response_plea();
+                    m_resumeId = m_session->resume ? resumable_session() : std::string();
+                    if (!m_resumeId.empty())
+                    {
+                        jReq["params"] = Json::Value(Json::arrayValue);
+                        jReq["params"].append(m_resumeId);
+                    }
+                    enqueue_response_plea(2);
                 }
                 else
                 {
@@ -855,7 +1355,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                     jReq["method"] = "mining.authorize";
                     jReq["params"].append(m_conn->UserDotWorker() + m_conn->Path());
                     jReq["params"].append(m_conn->Pass());
-                    enqueue_response_plea();
+                    enqueue_response_plea(3);
                 }
                 else
                 {
@@ -937,7 +1437,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                     jReq["params"] = Json::Value(Json::arrayValue);
                     jReq["params"].append(m_conn->UserDotWorker() + m_conn->Path());
                     jReq["params"].append(m_conn->Pass());
-                    enqueue_response_plea();
+                    enqueue_response_plea(3);
                 }
                 else
                 {
@@ -987,7 +1487,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
             // https://github.com/AndreaLanfranchi/EthereumStratum-2.0.0#session-handling---response-to-subscription
             if (m_conn->StratumMode() == 3)
             {
-                response_delay_ms = dequeue_response_plea();
+                response_delay_ms = dequeue_response_plea(2, PoolRequest::Subscribe);
 
                 if (!jResult.isString() || !jResult.asString().size())
                 {
@@ -1001,21 +1501,31 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                 m_session->sessionId = jResult.asString();
                 m_session->subscribed.store(true, memory_order_relaxed);
 
-                // Request authorization
-                m_authpending.store(true, std::memory_order_relaxed);
-                jReq["id"] = unsigned(3);
-                jReq["method"] = "mining.authorize";
-                jReq["params"] = Json::Value(Json::arrayValue);
-                jReq["params"].append(m_conn->UserDotWorker() + m_conn->Path());
-                jReq["params"].append(m_conn->Pass());
-                enqueue_response_plea();
-                send(jReq);
+                // Worker stays authorized on a resumed session
+                bool resumed = resume_session();
+                m_conn->Stats().accountSession(resumed);
+                if (resumed)
+                {
+                    cnote << "Resumed session " << m_session->sessionId;
+                }
+                else
+                {
+                    // Request authorization
+                    m_authpending.store(true, std::memory_order_relaxed);
+                    jReq["id"] = unsigned(3);
+                    jReq["method"] = "mining.authorize";
+                    jReq["params"] = Json::Value(Json::arrayValue);
+                    jReq["params"].append(m_conn->UserDotWorker() + m_conn->Path());
+                    jReq["params"].append(m_conn->Pass());
+                    enqueue_response_plea(3);
+                    send(jReq);
+                }
             }
         }
 
         else if (_id == 3 && m_conn->StratumMode() != ETHEREUMSTRATUM2)
         {
-            response_delay_ms = dequeue_response_plea();
+            response_delay_ms = dequeue_response_plea(3, PoolRequest::Authorize);
 
             // Response to "mining.authorize"
             // (https://en.bitcoin.it/wiki/Stratum_mining_protocol#mining.authorize) Result should
@@ -1044,7 +1554,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
 
         else if (_id == 3 && m_conn->StratumMode() == ETHEREUMSTRATUM2)
         {
-            response_delay_ms = dequeue_response_plea();
+            response_delay_ms = dequeue_response_plea(3, PoolRequest::Authorize);
 
             if (!_isSuccess || (!jResult.isString() || !jResult.asString().size()))
             {
@@ -1065,7 +1575,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
 
         else if ((_id >= 40 && _id <= m_solution_submitted_max_id) && m_conn->StratumMode() != ETHEREUMSTRATUM2)
         {
-            response_delay_ms = dequeue_response_plea();
+            response_delay_ms = dequeue_response_plea(_id, PoolRequest::Submit);
 
             // Response to solution submission mining.submit
             // (https://en.bitcoin.it/wiki/Stratum_mining_protocol#mining.submit) Result should be
@@ -1093,7 +1603,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
 
         else if ((_id >= 40 && _id <= m_solution_submitted_max_id) && m_conn->StratumMode() == ETHEREUMSTRATUM2)
         {
-            response_delay_ms = dequeue_response_plea();
+            response_delay_ms = dequeue_response_plea(_id, PoolRequest::Submit);
 
             // In EthereumStratum/2.0.0 we can evaluate the severity of the
             // error. An 2xx error means the solution have been accepted but is
@@ -1140,6 +1650,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
             // Response to hashrate submit
             // Shall we do anything ?
             // Hashrate submit is actually out of stratum spec
+            response_delay_ms = dequeue_response_plea(9, PoolRequest::Hashrate);
             if (!_isSuccess)
             {
                 cwarn << "Submit hashRate failed : " << (_errReason.empty() ? "Unspecified error" : _errReason);
@@ -1264,6 +1775,8 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                         m_current.boundary = m_session->nextWorkBoundary;
                         m_current.startNonce = m_session->extraNonce;
                         m_current.exSizeBytes = m_session->extraNonceSizeBytes;
+                        Json::Value jClean = jPrm.get(Json::Value::ArrayIndex(3), false);
+                        m_current.cleanJobs = (jClean.isBool() && jClean.asBool());
                         m_current_timestamp = std::chrono::steady_clock::now();
                         m_current.block = -1;
 
@@ -1319,6 +1832,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                     m_current.seed = h256(sSeedHash);
                     m_current.header = h256(sHeaderHash);
                     m_current.boundary = h256(sShareTarget);
+                    m_current.cleanJobs = false;  // No such flag : PoolManager checks block changes
                     m_current_timestamp = std::chrono::steady_clock::now();
 
                     // This will signal to dispatch the job
@@ -1364,6 +1878,8 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
             m_current.epoch = m_session->epoch;
             m_current.startNonce = m_session->extraNonce;
             m_current.exSizeBytes = m_session->extraNonceSizeBytes;
+            Json::Value jClean = jPrm.get(Json::Value::ArrayIndex(3), "0");
+            m_current.cleanJobs = jClean.isBool() ? jClean.asBool() : (jClean.asString() != "0");
             m_current_timestamp = std::chrono::steady_clock::now();
 
             // This will signal to dispatch the job
@@ -1379,7 +1895,7 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
                 {
                     double nextWorkDifficulty = max(jPrm.get(Json::Value::ArrayIndex(0), 1).asDouble(), 0.0001);
 
-                    m_session->nextWorkBoundary = h256(dev::getTargetFromDiff(nextWorkDifficulty));
+                    m_session->nextWorkBoundary = dev::diffToTarget(nextWorkDifficulty);
                 }
             }
             else
@@ -1446,6 +1962,8 @@ void EthStratumClient::processResponse(Json::Value& responseObject)
         else if (_method == "mining.bye" && m_conn->StratumMode() == ETHEREUMSTRATUM2)
         {
             cnote << m_conn->Host() << " requested connection close. Disconnecting ...";
+            if (m_session)
+                m_session->resume = false;
             m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::disconnect, this)));
         }
         else if (_method == "client.get_version")
@@ -1521,6 +2039,11 @@ void EthStratumClient::submitHashrate(uint64_t const& rate, string const& id)
         jReq["params"].append(m_session->workerId);
     }
 
+    // Not all pools answer : a previous submission still unanswered is
+    // forgotten. Nor does the response timeout apply
+    std::chrono::steady_clock::duration elapsed;
+    m_response_pleas.pop(9, elapsed);
+    enqueue_response_plea(9, false);
     send(jReq);
 }
 
@@ -1532,70 +2055,104 @@ void EthStratumClient::submitSolution(const Solution& solution)
         return;
     }
 
-    Json::Value jReq;
-
     unsigned id = 40 + solution.midx;
-    jReq["id"] = id;
     m_solution_submitted_max_id = max(m_solution_submitted_max_id, id);
-    jReq["method"] = "mining.submit";
-    jReq["params"] = Json::Value(Json::arrayValue);
+
+    // The request is pre-rendered once per session (and again if the
+    // extranonce size changes). Only solution values are filled in
+    unsigned nonceSkip = 0;
+    if (m_conn->StratumMode() == ETHEREUMSTRATUM || m_conn->StratumMode() == ETHEREUMSTRATUM2)
+        nonceSkip = solution.work.exSizeBytes;
+    if (m_submitTemplate.empty() || m_submitTemplate.nonceSkip() != nonceSkip ||
+        m_submitTemplateStamp != m_session->start)
+        buildSubmitTemplate(nonceSkip);
+
+    TxBuffer* buffer = m_txPool.get();
+    buffer->id = id;
+    m_submitTemplate.render(id, solution, buffer->data);
+
+    enqueue_response_plea(id);
+    send(buffer);
+}
+
+void EthStratumClient::buildSubmitTemplate(unsigned _nonceSkip)
+{
+    // Same members, in the same order, jsoncpp would write
+    m_submitTemplate.clear();
+    m_submitTemplate.text("{\"id\":").slot(SubmitSlot::Id);
+
+    string worker;
+    if (!m_conn->Workername().empty())
+        worker = ",\"worker\":" + Json::valueToQuotedString(m_conn->Workername().c_str());
 
     switch (m_conn->StratumMode())
     {
     case EthStratumClient::STRATUM:
 
-        jReq["jsonrpc"] = "2.0";
-        jReq["params"].append(m_conn->User());
-        jReq["params"].append(solution.work.job);
-        jReq["params"].append(toHex(solution.nonce, HexPrefix::Add));
-        jReq["params"].append(solution.work.header.hex(HexPrefix::Add));
-        jReq["params"].append(solution.mixHash.hex(HexPrefix::Add));
-        if (!m_conn->Workername().empty())
-            jReq["worker"] = m_conn->Workername();
-
+        m_submitTemplate.text(",\"jsonrpc\":\"2.0\",\"method\":\"mining.submit\",\"params\":[")
+            .text(Json::valueToQuotedString(m_conn->User().c_str()))
+            .text(",\"")
+            .slot(SubmitSlot::Job)
+            .text("\",\"")
+            .nonce(0, true)
+            .text("\",\"")
+            .slot(SubmitSlot::Header)
+            .text("\",\"")
+            .slot(SubmitSlot::Mix)
+            .text("\"]" + worker);
         break;
 
     case EthStratumClient::ETHPROXY:
 
-        jReq["method"] = "axis_submitWork";
-        jReq["params"].append(toHex(solution.nonce, HexPrefix::Add));
-        jReq["params"].append(solution.work.header.hex(HexPrefix::Add));
-        jReq["params"].append(solution.mixHash.hex(HexPrefix::Add));
-        if (!m_conn->Workername().empty())
-            jReq["worker"] = m_conn->Workername();
-
+        m_submitTemplate.text(",\"method\":\"axis_submitWork\",\"params\":[\"")
+            .nonce(0, true)
+            .text("\",\"")
+            .slot(SubmitSlot::Header)
+            .text("\",\"")
+            .slot(SubmitSlot::Mix)
+            .text("\"]" + worker);
         break;
 
     case EthStratumClient::ETHEREUMSTRATUM:
 
-        jReq["params"].append(m_conn->UserDotWorker());
-        jReq["params"].append(solution.work.job);
-        jReq["params"].append(toHex(solution.nonce, HexPrefix::DontAdd).substr(solution.work.exSizeBytes));
+        m_submitTemplate.text(",\"method\":\"mining.submit\",\"params\":[")
+            .text(Json::valueToQuotedString(m_conn->UserDotWorker().c_str()))
+            .text(",\"")
+            .slot(SubmitSlot::Job)
+            .text("\",\"")
+            .nonce(_nonceSkip, false)
+            .text("\"]");
         break;
 
     case EthStratumClient::ETHEREUMSTRATUM2:
 
-        jReq["params"].append(solution.work.job);
-        jReq["params"].append(toHex(solution.nonce, HexPrefix::DontAdd).substr(solution.work.exSizeBytes));
-        jReq["params"].append(m_session->workerId);
+        m_submitTemplate.text(",\"method\":\"mining.submit\",\"params\":[\"")
+            .slot(SubmitSlot::Job)
+            .text("\",\"")
+            .nonce(_nonceSkip, false)
+            .text("\",")
+            .text(Json::valueToQuotedString(m_session->workerId.c_str()))
+            .text("]");
         break;
     }
 
-    enqueue_response_plea();
-    send(jReq);
+    m_submitTemplate.text("}\n");
+    m_submitTemplateStamp = m_session->start;
 }
 
 void EthStratumClient::recvSocketData()
 {
+    // Read straight into the free room of the line buffer
+    auto buffer = boost::asio::buffer(m_recvBuffer.tail(), m_recvBuffer.space());
     if (m_conn->SecLevel() != SecureLevel::NONE)
     {
-        async_read(*m_securesocket, m_recvBuffer, boost::asio::transfer_at_least(1),
+        m_securesocket->async_read_some(buffer,
             m_io_strand.wrap(boost::bind(&EthStratumClient::onRecvSocketDataCompleted, this,
                 boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
     }
     else
     {
-        async_read(*m_nonsecuresocket, m_recvBuffer, boost::asio::transfer_at_least(1),
+        m_nonsecuresocket->async_read_some(buffer,
             m_io_strand.wrap(boost::bind(&EthStratumClient::onRecvSocketDataCompleted, this,
                 boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
     }
@@ -1610,84 +2167,59 @@ void EthStratumClient::onRecvSocketDataCompleted(const boost::system::error_code
 
     if (!ec)
     {
-        // DO NOT DO THIS !!!!!
-        // std::istream is(&m_recvBuffer);
-        // std::string message;
-        // getline(is, message)
-        /*
-        There are three reasons :
-        1 - Previous async_read_until calls this handler (aside from error codes)
-            with the number of bytes in the buffer's get area up to and including
-            the delimiter. So we know where to split the line
-        2 - Boost's documentation clearly states that after a succesfull
-            async_read_until operation the stream buffer MAY contain additional
-            data which HAVE to be left in the buffer for subsequent read operations.
-            If another delimiter exists in the buffer then it will get caught
-            by the next async_read_until()
-        3 - std::istream is(&m_recvBuffer) will CONSUME ALL data in the buffer
-            thus invalidating the previous point 2
-        */
+        m_recvBuffer.commit(bytes_transferred);
 
-        // Extract received message and free the buffer
-        std::string rx_message(boost::asio::buffer_cast<const char*>(m_recvBuffer.data()), bytes_transferred);
-        m_recvBuffer.consume(bytes_transferred);
-        m_message.append(rx_message);
-
-        // Process each line in the transmission
+        // Process each line in the transmission. Lines are parsed
+        // in place : nothing is copied out of the receive buffer
         // NOTE : as multiple jobs may come in with
         // a single transmission only the last will be dispatched
         m_newjobprocessed = false;
-        std::string line;
-        size_t offset = m_message.find("\n");
-        while (offset != string::npos)
+        vector_ref<char const> line;
+        while (m_recvBuffer.nextLine(line))
         {
-            if (offset > 0)
-            {
-                line = m_message.substr(0, offset);
-                boost::trim(line);
+            // Out received message only for debug purpouses
+            if (g_logOptions & LOG_JSON)
+                cnote << " << " << line.toString();
 
-                if (!line.empty())
+            try
+            {
+                // Jobs, difficulty and share responses are handled in place.
+                // Anything else goes through jsoncpp
+                // Run in sync so no 2 different async reads may overlap
+                StratumMessage msg;
+                if (parseStratumMessage(line.data(), line.data() + line.size(), msg) && processFastResponse(msg))
+                    continue;
+
+                // Test validity of chunk and process
+                Json::Value jMsg;
+                Json::Reader jRdr;
+                if (jRdr.parse(line.data(), line.data() + line.size(), jMsg))
                 {
-                    // Out received message only for debug purpouses
-                    if (g_logOptions & LOG_JSON)
-                        cnote << " << " << line;
-
-                    // Test validity of chunk and process
-                    Json::Value jMsg;
-                    Json::Reader jRdr;
-                    if (jRdr.parse(line, jMsg))
-                    {
-                        try
-                        {
-                            // Run in sync so no 2 different async reads may overlap
-                            processResponse(jMsg);
-                        }
-                        catch (const std::exception& _ex)
-                        {
-                            cwarn << "Stratum got invalid Json message : " << _ex.what();
-                        }
-                    }
-                    else
-                    {
-                        string what = jRdr.getFormattedErrorMessages();
-                        boost::replace_all(what, "\n", " ");
-                        cwarn << "Stratum got invalid Json message : " << what;
-                    }
+                    processResponse(jMsg);
+                }
+                else
+                {
+                    string what = jRdr.getFormattedErrorMessages();
+                    boost::replace_all(what, "\n", " ");
+                    cwarn << "Stratum got invalid Json message : " << what;
                 }
             }
-
-            m_message.erase(0, offset + 1);
-            offset = m_message.find("\n");
+            catch (const std::exception& _ex)
+            {
+                cwarn << "Stratum got invalid Json message : " << _ex.what();
+            }
         }
+        m_recvBuffer.compact();
 
         // There is a new job - dispatch it
         if (m_newjobprocessed)
             if (m_onWorkReceived)
                 m_onWorkReceived(m_current);
 
-        if (m_message.size() > POOLCLIENT_MAX_MESSAGE_LENGTH)
+        // A message filling the whole buffer is not from a pool
+        if (!m_recvBuffer.space())
         {
-            m_message.clear();
+            m_recvBuffer.clear();
             cerr << "Disconnecting due invalid data from pool";
             m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::disconnect, this)));
             return;
@@ -1728,8 +2260,16 @@ void EthStratumClient::onRecvSocketDataCompleted(const boost::system::error_code
 
 void EthStratumClient::send(Json::Value const& jReq)
 {
-    std::string* line = new std::string(Json::writeString(m_jSwBuilder, jReq));
-    m_txQueue.push(line);
+    std::string line = Json::writeString(m_jSwBuilder, jReq);
+    TxBuffer* buffer = m_txPool.get();
+    buffer->data.assign(line.begin(), line.end());
+    buffer->data.push_back('\n');
+    send(buffer);
+}
+
+void EthStratumClient::send(TxBuffer* _buffer)
+{
+    m_txQueue.push(_buffer);
 
     bool ex = false;
     if (m_txPending.compare_exchange_strong(ex, true, std::memory_order_relaxed))
@@ -1740,44 +2280,51 @@ void EthStratumClient::sendSocketData()
 {
     if (!isConnected() || m_txQueue.empty())
     {
-        m_sendBuffer.consume(m_sendBuffer.capacity());
-        m_txQueue.consume_all([](std::string* l) { delete l; });
+        releaseTxBuffers();
         m_txPending.store(false, std::memory_order_relaxed);
         return;
     }
 
-    std::string* line;
-    std::ostream os(&m_sendBuffer);
-    while (m_txQueue.pop(line))
+    // Gather queued requests into one write. Unused slots stay empty
+    TxBuffer* buffer;
+    m_txGather.fill(boost::asio::const_buffer());
+    while (m_txInFlightCount < c_txGather && m_txQueue.pop(buffer))
     {
-        os << *line << std::endl;
         // Out received message only for debug purpouses
         if (g_logOptions & LOG_JSON)
-            cnote << " >> " << *line;
+            cnote << " >> " << std::string(buffer->data.data(), buffer->data.size() - 1);
 
-        delete line;
+        m_txGather[m_txInFlightCount] = boost::asio::buffer(buffer->data);
+        m_txInFlight[m_txInFlightCount++] = buffer;
     }
 
     if (m_conn->SecLevel() != SecureLevel::NONE)
     {
-        async_write(*m_securesocket, m_sendBuffer,
+        async_write(*m_securesocket, m_txGather,
             m_io_strand.wrap(
                 boost::bind(&EthStratumClient::onSendSocketDataCompleted, this, boost::asio::placeholders::error)));
     }
     else
     {
-        async_write(*m_nonsecuresocket, m_sendBuffer,
+        async_write(*m_nonsecuresocket, m_txGather,
             m_io_strand.wrap(
                 boost::bind(&EthStratumClient::onSendSocketDataCompleted, this, boost::asio::placeholders::error)));
     }
 }
 
+void EthStratumClient::releaseTxBuffers()
+{
+    for (unsigned i = 0; i < m_txInFlightCount; i++)
+        m_txPool.put(m_txInFlight[i]);
+    m_txInFlightCount = 0;
+    m_txQueue.consume_all([this](TxBuffer* b) { m_txPool.put(b); });
+}
+
 void EthStratumClient::onSendSocketDataCompleted(const boost::system::error_code& ec)
 {
     if (ec)
     {
-        m_sendBuffer.consume(m_sendBuffer.capacity());
-        m_txQueue.consume_all([](std::string* l) { delete l; });
+        releaseTxBuffers();
         m_txPending.store(false, std::memory_order_relaxed);
 
         if ((ec.category() == boost::asio::error::get_ssl_category()) &&
@@ -1795,6 +2342,10 @@ void EthStratumClient::onSendSocketDataCompleted(const boost::system::error_code
     }
     else
     {
+        for (unsigned i = 0; i < m_txInFlightCount; i++)
+            m_txPool.put(m_txInFlight[i]);
+        m_txInFlightCount = 0;
+
         // Register last transmission tstamp to prevent timeout
         // in EthereumStratum/2.0.0
         if (m_session && m_conn->StratumMode() == 3)
@@ -1814,47 +2365,25 @@ void EthStratumClient::onSSLShutdownCompleted(const boost::system::error_code& e
     m_io_service.post(m_io_strand.wrap(boost::bind(&EthStratumClient::disconnect_finalize, this)));
 }
 
-void EthStratumClient::enqueue_response_plea()
+void EthStratumClient::enqueue_response_plea(unsigned _id, bool _timed)
 {
-    using namespace std::chrono;
-    steady_clock::time_point response_plea_time = steady_clock::now();
-    if (m_response_pleas_count++ == 0)
-    {
-        m_response_plea_older.store(response_plea_time.time_since_epoch(), std::memory_order_relaxed);
-    }
-    m_response_plea_times.push(response_plea_time);
+    m_response_pleas.push(_id, _timed);
 }
 
-std::chrono::milliseconds EthStratumClient::dequeue_response_plea()
+std::chrono::milliseconds EthStratumClient::dequeue_response_plea(unsigned _id, PoolRequest _request)
 {
     using namespace std::chrono;
 
-    steady_clock::time_point response_plea_time(m_response_plea_older.load(std::memory_order_relaxed));
-    milliseconds response_delay_ms = duration_cast<milliseconds>(steady_clock::now() - response_plea_time);
-
-    if (m_response_plea_times.pop(response_plea_time))
-    {
-        m_response_plea_older.store(response_plea_time.time_since_epoch(), std::memory_order_relaxed);
-    }
-    if (m_response_pleas_count.load(std::memory_order_relaxed) > 0)
-    {
-        m_response_pleas_count--;
-        return response_delay_ms;
-    }
-    else
-    {
+    steady_clock::duration elapsed;
+    if (!m_response_pleas.pop(_id, elapsed))
         return milliseconds(0);
-    }
+
+    if (m_conn)
+        m_conn->Stats().recordRtt(_request, elapsed);
+    return duration_cast<milliseconds>(elapsed);
 }
 
 void EthStratumClient::clear_response_pleas()
 {
-    using namespace std::chrono;
-    steady_clock::time_point response_plea_time;
-    m_response_pleas_count.store(0, std::memory_order_relaxed);
-    while (m_response_plea_times.pop(response_plea_time))
-    {
-    };
-    m_response_plea_older.store(
-        ((steady_clock::time_point)steady_clock::now()).time_since_epoch(), std::memory_order_relaxed);
+    m_response_pleas.clear();
 }
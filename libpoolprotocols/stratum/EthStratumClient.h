@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
+#include <deque>
 #include <iostream>
+#include <map>
 
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
@@ -11,12 +14,16 @@
 #include <json/json.h>
 
 #include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/LineBuffer.h>
 #include <libdevcore/Log.h>
 #include <libethcore/EthashAux.h>
 #include <libethcore/Farm.h>
 #include <libethcore/Miner.h>
 
 #include "../PoolClient.h"
+#include "../StratumParser.h"
+#include "../SubmitTemplate.h"
 
 using namespace std;
 using namespace dev;
@@ -75,6 +82,7 @@ public:
     {
         return (m_connecting.load(std::memory_order_relaxed) || m_disconnecting.load(std::memory_order_relaxed));
     }
+    bool isResumable() override { return m_resumable; }
 
     void submitHashrate(uint64_t const& rate, string const& id) override;
     void submitSolution(const Solution& solution) override;
@@ -83,24 +91,55 @@ public:
     bool current() { return static_cast<bool>(m_current); }
 
 private:
+    // TLS context shared by the clients of a connection. Keeps the last
+    // session negotiated so that reconnections can resume it
+    struct TlsContext
+    {
+        TlsContext(boost::asio::ssl::context::method _method) : context(_method) {}
+        ~TlsContext()
+        {
+            if (session)
+                SSL_SESSION_free(session);
+        }
+
+        boost::asio::ssl::context context;
+        Mutex x_session;
+        SSL_SESSION* session = nullptr;
+    };
+
+    std::shared_ptr<TlsContext> tls_context();
+    static int tls_new_session(SSL* _ssl, SSL_SESSION* _session);
+
     void startSession();
+    void save_session();
+    std::string resumable_session();
+    bool resume_session();
     void disconnect_finalize();
-    void enqueue_response_plea();
-    std::chrono::milliseconds dequeue_response_plea();
+    void enqueue_response_plea(unsigned _id, bool _timed = true);
+    std::chrono::milliseconds dequeue_response_plea(unsigned _id, PoolRequest _request);
     void clear_response_pleas();
     void resolve_handler(const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::iterator i);
+    void set_endpoints(std::vector<boost::asio::ip::tcp::endpoint> const& _endpoints);
     void start_connect();
-    void connect_handler(const boost::system::error_code& ec);
+    void start_attempt();
+    void attempt_handler(std::shared_ptr<boost::asio::ip::tcp::socket> _socket, const boost::system::error_code& ec);
+    void connect_timer_elapsed(const boost::system::error_code& ec);
+    void abort_connect();
+    void connect_handler();
     void workloop_timer_elapsed(const boost::system::error_code& ec);
 
     void processResponse(Json::Value& responseObject);
+    bool processFastResponse(StratumMessage const& _msg);
     std::string processError(Json::Value& erroresponseObject);
     void processExtranonce(std::string& enonce);
 
     void recvSocketData();
     void onRecvSocketDataCompleted(const boost::system::error_code& ec, std::size_t bytes_transferred);
     void send(Json::Value const& jReq);
+    void send(TxBuffer* _buffer);
     void sendSocketData();
+    void releaseTxBuffers();
+    void buildSubmitTemplate(unsigned _nonceSkip);
     void onSendSocketDataCompleted(const boost::system::error_code& ec);
     void onSSLShutdownCompleted(const boost::system::error_code& ec);
 
@@ -123,30 +162,87 @@ private:
     boost::asio::io_service& m_io_service;  // The IO service reference passed in the constructor
     boost::asio::io_service::strand m_io_strand;
     boost::asio::ip::tcp::socket* m_socket;
-    std::string m_message;  // The internal message string buffer
     bool m_newjobprocessed = false;
 
+    std::shared_ptr<TlsContext> m_tls;  // Of current connection
+
     // Use shared ptrs to avoid crashes due to async_writes
     // see
     // https://stackoverflow.com/questions/41526553/can-async-write-cause-segmentation-fault-when-this-is-deleted
     std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> m_securesocket;
     std::shared_ptr<boost::asio::ip::tcp::socket> m_nonsecuresocket;
 
-    boost::asio::streambuf m_sendBuffer;
-    boost::asio::streambuf m_recvBuffer;
+    static Mutex x_tls;
+    static std::map<std::string, std::shared_ptr<TlsContext>> s_tls;  // By connection. Never released
+
+    LineBuffer m_recvBuffer;  // Socket reads straight into it. Holds at most one incomplete message
     Json::StreamWriterBuilder m_jSwBuilder;
 
     boost::asio::deadline_timer m_workloop_timer;
 
-    std::atomic<int> m_response_pleas_count = {0};
-    std::atomic<std::chrono::steady_clock::duration> m_response_plea_older;
-    boost::lockfree::queue<std::chrono::steady_clock::time_point> m_response_plea_times;
+    PendingRequests m_response_pleas;  // Id 0 times connection and disconnection phases
 
+    // Requests are rendered into pooled buffers and written with one
+    // gather write of up to c_txGather of them
+    static const unsigned c_txGather = 16;
     std::atomic<bool> m_txPending = {false};
-    boost::lockfree::queue<std::string*> m_txQueue;
+    boost::lockfree::queue<TxBuffer*> m_txQueue;
+    TxBufferPool m_txPool;
+    std::array<TxBuffer*, c_txGather> m_txInFlight;
+    std::array<boost::asio::const_buffer, c_txGather> m_txGather;
+    unsigned m_txInFlightCount = 0;
+
+    // mining.submit rendered for current session
+    SubmitTemplate m_submitTemplate;
+    std::chrono::steady_clock::time_point m_submitTemplateStamp;  // Start of the session it's rendered for
 
     boost::asio::ip::tcp::resolver m_resolver;
-    std::queue<boost::asio::ip::basic_endpoint<boost::asio::ip::tcp>> m_endpoints;
+    std::deque<boost::asio::ip::tcp::endpoint> m_endpoints;  // Not tried yet. IPv6 and IPv4 interleaved
+
+    // Connection attempts racing on different endpoints (Happy Eyeballs).
+    // A new one is started every c_attemptDelay ms or as soon as one
+    // fails. First connected socket wins
+    struct ConnectAttempt
+    {
+        std::shared_ptr<boost::asio::ip::tcp::socket> socket;
+        boost::asio::ip::tcp::endpoint endpoint;
+        std::chrono::steady_clock::time_point start;
+    };
+    static const unsigned c_attemptDelay = 250;
+    std::vector<ConnectAttempt> m_attempts;
+    boost::asio::deadline_timer m_connect_timer;
+
+    // Addresses resolved by any client, by host and port. getaddrinfo does
+    // not tell record TTLs : entries are kept c_resolvedTtl seconds, and
+    // dropped when none of their addresses could be connected
+    struct ResolvedHost
+    {
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+        std::chrono::steady_clock::time_point expiry;
+    };
+    static const unsigned c_resolvedTtl = 60;
+    static Mutex x_resolved;
+    static std::map<std::string, ResolvedHost> s_resolved;
+
+    // EthereumStratum/2.0.0 sessions left by any client, by connection.
+    // Next client subscribes with the session id and, if the server
+    // resumes it within the session timeout, carries on with the same
+    // extranonce, target and epoch without authorizing again
+    struct ResumableSession
+    {
+        std::string sessionId;
+        std::string workerId;
+        uint64_t extraNonce;
+        unsigned extraNonceSizeBytes;
+        h256 nextWorkBoundary;
+        unsigned epoch;
+        unsigned timeout;
+        std::chrono::steady_clock::time_point expiry;
+    };
+    static Mutex x_resumable;
+    static std::map<std::string, ResumableSession> s_resumable;
+    std::string m_resumeId;    // Session id the pending subscription asks to resume
+    bool m_resumable = false;  // Whether or not the session lost was left for resumption
 
     unsigned m_solution_submitted_max_id;  // maximum json id we used to send a solution
 
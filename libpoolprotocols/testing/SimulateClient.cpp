@@ -1,5 +1,7 @@
 #include <libdevcore/Log.h>
+#include <libdevcore/Target.h>
 #include <chrono>
+#include <iomanip>
 
 #include "SimulateClient.h"
 
@@ -39,6 +41,13 @@ void SimulateClient::disconnect()
           << dev::getFormattedHashes((double)hr_max, ScaleSuffix::Add, 6) << " Mean "
           << dev::getFormattedHashes((double)hr_mean, ScaleSuffix::Add, 6) << EthReset;
 
+    // Throughput of the submit path (most telling with synthetic devices)
+    uint64_t accepted = m_accepted.load(memory_order_relaxed);
+    uint64_t rejected = m_rejected.load(memory_order_relaxed);
+    double seconds = std::max(duration<double>(steady_clock::now() - m_session->start).count(), 1.0);
+    cnote << "Simulation results : " << EthWhiteBold << "Shares " << accepted << "A " << rejected << "R Submit "
+          << fixed << setprecision(2) << (accepted + rejected) / seconds << " sol/s" << EthReset;
+
     m_conn->addDuration(m_session->duration());
     m_session = nullptr;
     m_connected.store(false, memory_order_relaxed);
@@ -66,11 +75,13 @@ void SimulateClient::submitSolution(const Solution& _s)
 
     if (accepted)
     {
+        m_accepted.fetch_add(1, memory_order_relaxed);
         if (m_onSolutionAccepted)
             m_onSolutionAccepted(response_delay_ms, _s.midx, false);
     }
     else
     {
+        m_rejected.fetch_add(1, memory_order_relaxed);
         if (m_onSolutionRejected)
             m_onSolutionRejected(response_delay_ms, _s.midx);
     }
@@ -92,7 +103,7 @@ void SimulateClient::workLoop()
     current.seed = h256::random();
     current.block = m_block;
     current.epoch = m_block / 30000U;
-    current.boundary = h256(dev::getTargetFromDiff(m_diff));
+    current.boundary = dev::diffToTarget(m_diff);
     m_onWorkReceived(current);  // submit new fake job
 
     while (m_session)
@@ -127,7 +138,7 @@ void SimulateClient::workLoop()
                 // Randomize among -5% and +5%
                 double randDiff = double(rand() % 11 + (-5)) / 100.0;
                 m_diff += (m_diff * randDiff);
-                current.boundary = h256(dev::getTargetFromDiff(m_diff));
+                current.boundary = dev::diffToTarget(m_diff);
                 m_onWorkReceived(current);
             }
         }
@@ -37,6 +37,9 @@ private:
 
     std::chrono::steady_clock::time_point m_start_time;
 
+    std::atomic<uint64_t> m_accepted = {0};  // Solutions verified during the session
+    std::atomic<uint64_t> m_rejected = {0};  // Solutions which failed verification
+
     float hr_alpha = 0.45f;
     float hr_max = 0.0f;
     float hr_mean = 0.0f;